@@ -24,5 +24,9 @@
 
 #import "BBHTTPExecutor.h"
 #import "BBHTTPRequest+Convenience.h"
+#import "BBHTTPMultipartFormData.h"
+#import "BBHTTPUploadBody.h"
+#import "BBHTTPSegmentedDownload.h"
+#import "BBHTTPChunkedUpload.h"
 
 #endif
@@ -0,0 +1,188 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+@class BBHTTPExecutor;
+@class BBHTTPRequest;
+
+
+
+#pragma mark -
+
+/**
+ The `BBHTTPChunkedUpload` class uploads a single large file over several parallel connections, using the
+ [tus resumable upload protocol](http://tus.io/protocols/resumable-upload.html).
+
+ Sending a multi-gigabyte file in a single request means that a dropped connection near the end costs the whole upload;
+ splitting it into chunks that are acknowledged independently limits the damage to a single chunk &mdash; and only to
+ the part of it that the server hasn't stored yet.
+
+ ### How it works
+
+ The file is split into chunks of `<chunkSize>` bytes. Each chunk becomes its own tus upload (a *partial* upload, as
+ per the concatenation extension), created with a `POST` to the endpoint and then sent with `PATCH` requests, up to
+ `<maxParallelChunks>` of them at a time. Chunk bodies are read straight from the file (see `<BBHTTPUploadBody>`).
+
+ When a chunk fails, only that chunk is retried: its upload is queried with `HEAD` for the offset the server has
+ stored, and the next `PATCH` picks up from there. Chunks that fail more than `<maxRetriesPerChunk>` times fail the
+ whole upload.
+
+ Once every chunk is complete, a *final* upload that concatenates them all is created; its URL is the `<uploadURL>`.
+ Files that fit in a single chunk skip concatenation altogether, so servers without that extension can take them.
+
+ ### Resuming after a restart
+
+ The URL of each chunk's upload and the offset the server last acknowledged for it are kept in a small state file,
+ rewritten as the upload progresses. Creating a new `BBHTTPChunkedUpload` with the same file, endpoint and state file
+ and starting it continues where the previous one left off, provided that the file hasn't been modified in the
+ meantime. The state file is kept when the upload fails or is cancelled and deleted once it succeeds.
+
+ ### Parallelism
+
+ Chunks are regular requests, so the actual number of parallel connections is also bound by the executor's
+ `maxParallelRequests`.
+ */
+@interface BBHTTPChunkedUpload : NSObject
+
+
+#pragma mark Creating a chunked upload
+
+///--------------------------------
+/// @name Creating a chunked upload
+///--------------------------------
+
+/**
+ Creates a new chunked upload.
+
+ @param pathToFile Path to the file to upload.
+ @param url The tus endpoint where uploads are created.
+ @param pathToStateFile Path to the file where progress is kept, so that the upload can be resumed.
+
+ @return An initialized `BBHTTPChunkedUpload`.
+ */
+- (instancetype)initWithFile:(NSString*)pathToFile endpoint:(NSURL*)url stateFile:(NSString*)pathToStateFile;
+
+
+#pragma mark Configuring behavior
+
+///---------------------------
+/// @name Configuring behavior
+///---------------------------
+
+/** The executor where chunk requests are executed. Defaults to `<[BBHTTPExecutor sharedExecutor]>`. */
+@property(strong, nonatomic) BBHTTPExecutor* executor;
+
+/**
+ Size of each chunk, in bytes.
+
+ Only applies to new uploads; resumed uploads keep the chunks they were started with. Defaults to 8MB, minimum allowed
+ value is 64KB.
+ */
+@property(assign, nonatomic) NSUInteger chunkSize;
+
+/** Maximum number of chunks being uploaded at any given time. Defaults to 4, minimum allowed value is 1. */
+@property(assign, nonatomic) NSUInteger maxParallelChunks;
+
+/** Number of times a failed chunk is retried before the upload fails. Defaults to 3. */
+@property(assign, nonatomic) NSUInteger maxRetriesPerChunk;
+
+/**
+ Block that will be called to configure each of the requests issued by this upload.
+
+ Use it to add authentication headers, adjust timeouts, etc. It's called right before each request is executed, so it
+ will be called many times throughout the upload.
+ */
+@property(copy, nonatomic) void (^requestSetupBlock)(BBHTTPRequest* request);
+
+/**
+ The queue where events (progress, finish) will be dispatched to.
+
+ Defaults to `dispatch_get_main_queue()`
+ */
+#if OS_OBJECT_USE_OBJC
+@property(strong, nonatomic) dispatch_queue_t callbackQueue;
+#else
+@property(assign, nonatomic) dispatch_queue_t callbackQueue;
+#endif
+
+
+#pragma mark Handling upload events
+
+///-----------------------------
+/// @name Handling upload events
+///-----------------------------
+
+/**
+ Block that will be called as data is sent, by any of the chunks.
+
+ *current* counts the bytes stored by the server plus those in flight; it may go back if a chunk fails and the server
+ didn't keep everything that was sent.
+ */
+@property(copy, nonatomic) void (^uploadProgressBlock)(unsigned long long current, unsigned long long total);
+
+/** Block that will be called when the upload terminates, either normally or abnormally. */
+@property(copy, nonatomic) void (^finishBlock)(BBHTTPChunkedUpload* upload);
+
+
+#pragma mark Executing the upload
+
+///---------------------------
+/// @name Executing the upload
+///---------------------------
+
+/**
+ Starts (or resumes) the upload.
+
+ @return `YES` if the upload was started, `NO` if it was already started, the file can't be read or the first requests
+ were rejected by the executor.
+ */
+- (BOOL)start;
+
+/**
+ Cancels the upload, cancelling all chunk requests; the state file is kept, so the upload can be resumed later.
+
+ @return `YES` if the upload was cancelled, `NO` if it had already finished.
+ */
+- (BOOL)cancel;
+
+
+#pragma mark Querying upload information
+
+///----------------------------------
+/// @name Querying upload information
+///----------------------------------
+
+@property(copy, nonatomic, readonly) NSString* pathToFile;
+@property(copy, nonatomic, readonly) NSURL* url;
+@property(copy, nonatomic, readonly) NSString* pathToStateFile;
+/** The size of the file, in bytes; known once the upload starts. */
+@property(assign, nonatomic, readonly) unsigned long long fileSize;
+/** Bytes stored by the server plus bytes in flight, across all chunks. */
+@property(assign, nonatomic, readonly) unsigned long long uploadedBytes;
+/** The URL of the complete upload, once it finishes successfully. */
+@property(copy, nonatomic, readonly) NSURL* uploadURL;
+/** `YES` if the upload picked up from a previous state file. */
+@property(assign, nonatomic, readonly, getter = wasResumed) BOOL resumed;
+@property(assign, nonatomic, readonly, getter = hasStarted) BOOL started;
+@property(assign, nonatomic, readonly, getter = hasFinished) BOOL finished;
+@property(assign, nonatomic, readonly, getter = wasCancelled) BOOL cancelled;
+@property(strong, nonatomic, readonly) NSError* error;
+
+@end
@@ -0,0 +1,604 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPChunkedUpload.h"
+
+#import "BBHTTPExecutor.h"
+#import "BBHTTPRequest.h"
+#import "BBHTTPUploadBody.h"
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark - Constants
+
+#define kBBHTTPChunkedUploadTusVersion   @"1.0.0"
+#define kBBHTTPChunkedUploadStateVersion 1
+#define kBBHTTPChunkedUploadMinChunkSize (64 * 1024)
+
+
+
+#pragma mark - Upload chunk
+
+@interface BBHTTPUploadChunk : NSObject
+
+- (instancetype)initWithStart:(unsigned long long)start end:(unsigned long long)end;
+
+@property(assign, nonatomic, readonly) unsigned long long start;
+// Exclusive
+@property(assign, nonatomic, readonly) unsigned long long end;
+// The chunk's own tus upload, once created
+@property(copy, nonatomic) NSURL* url;
+// Bytes of the chunk the server acknowledged storing
+@property(assign, nonatomic) unsigned long long confirmed;
+// Bytes sent by the request in flight, if any
+@property(assign, nonatomic) NSUInteger sent;
+// Set after failures; the server may have stored more (or less) than was last acknowledged
+@property(assign, nonatomic) BOOL needsOffsetCheck;
+@property(assign, nonatomic) NSUInteger failures;
+@property(strong, nonatomic) BBHTTPRequest* request;
+
+- (unsigned long long)length;
+- (BOOL)isComplete;
+
+@end
+
+@implementation BBHTTPUploadChunk
+
+- (instancetype)initWithStart:(unsigned long long)start end:(unsigned long long)end
+{
+    self = [super init];
+    if (self != nil) {
+        _start = start;
+        _end = end;
+    }
+
+    return self;
+}
+
+- (unsigned long long)length
+{
+    return _end - _start;
+}
+
+- (BOOL)isComplete
+{
+    return _confirmed >= [self length];
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"Chunk{%llu-%llu, confirmed: %llu}", _start, _end, _confirmed];
+}
+
+@end
+
+
+
+#pragma mark -
+
+@implementation BBHTTPChunkedUpload
+{
+    dispatch_queue_t _synchronizationQueue;
+    NSMutableArray* _chunks;
+    NSMutableArray* _activeChunks;
+    NSMutableArray* _pendingChunks;
+    long long _modificationTime; // millis
+    BBHTTPRequest* _finalRequest;
+    NSUInteger _finalFailures;
+}
+
+
+#pragma mark Creation
+
+- (instancetype)initWithFile:(NSString*)pathToFile endpoint:(NSURL*)url stateFile:(NSString*)pathToStateFile
+{
+    BBHTTPEnsureNotNil(pathToFile);
+    BBHTTPEnsureNotNil(url);
+    BBHTTPEnsureNotNil(pathToStateFile);
+
+    self = [super init];
+    if (self != nil) {
+        _pathToFile = [pathToFile copy];
+        _url = [url copy];
+        _pathToStateFile = [pathToStateFile copy];
+        _executor = [BBHTTPExecutor sharedExecutor];
+        _chunkSize = 8 * 1024 * 1024;
+        _maxParallelChunks = 4;
+        _maxRetriesPerChunk = 3;
+        _callbackQueue = dispatch_get_main_queue();
+
+        _chunks = [NSMutableArray array];
+        _activeChunks = [NSMutableArray array];
+        _pendingChunks = [NSMutableArray array];
+
+        _synchronizationQueue = dispatch_queue_create("com.biasedbit.HTTPChunkedUploadSyncQueue",
+                                                      DISPATCH_QUEUE_SERIAL);
+    }
+
+    return self;
+}
+
+- (instancetype)init
+{
+    NSAssert(NO, @"please use initWithFile:endpoint:stateFile: instead");
+    return nil;
+}
+
+
+#pragma mark Destruction
+
+- (void)dealloc
+{
+#if !OS_OBJECT_USE_OBJC
+    dispatch_release(_synchronizationQueue);
+#endif
+}
+
+
+#pragma mark Configuring behavior
+
+- (void)setChunkSize:(NSUInteger)chunkSize
+{
+    NSParameterAssert(chunkSize >= kBBHTTPChunkedUploadMinChunkSize);
+    _chunkSize = chunkSize;
+}
+
+- (void)setMaxParallelChunks:(NSUInteger)maxParallelChunks
+{
+    NSParameterAssert(maxParallelChunks >= 1);
+    _maxParallelChunks = maxParallelChunks;
+}
+
+
+#pragma mark Executing the upload
+
+- (BOOL)start
+{
+    __block BOOL started = NO;
+    dispatch_sync(_synchronizationQueue, ^{
+        if (_started) return;
+
+        NSError* error = [self prepareChunks];
+        if (error != nil) {
+            BBHTTPLogError(@"[%@] Can't start upload: %@", self, [error localizedDescription]);
+            _error = error;
+            return;
+        }
+
+        _started = YES;
+        [self executePendingChunks];
+        started = !_finished; // Only finishes this early if the executor rejected everything
+    });
+
+    return started;
+}
+
+- (BOOL)cancel
+{
+    __block BOOL cancelled = NO;
+    dispatch_sync(_synchronizationQueue, ^{
+        if (_finished) return;
+
+        _cancelled = YES;
+        [self finishWithError:nil];
+        cancelled = YES;
+    });
+
+    return cancelled;
+}
+
+
+#pragma mark Chunk events (synchronization queue)
+
+- (void)chunk:(BBHTTPUploadChunk*)chunk finishedWithRequest:(BBHTTPRequest*)request
+{
+    if (_finished || ![_activeChunks containsObject:chunk]) return;
+
+    [_activeChunks removeObject:chunk];
+    chunk.request = nil;
+    chunk.sent = 0;
+
+    NSError* error = [self chunk:chunk acceptResponseForRequest:request];
+    if (error == nil) {
+        [self saveState];
+
+        // Next step for the same chunk (upload, or resume upload), ahead of chunks that haven't started yet
+        if (![chunk isComplete]) {
+            [_pendingChunks insertObject:chunk atIndex:0];
+        } else {
+            BBHTTPLogTrace(@"[%@] %@ completed.", self, chunk);
+        }
+    } else if (chunk.failures >= _maxRetriesPerChunk) {
+        [self finishWithError:error];
+        return;
+    } else {
+        chunk.failures++;
+        if (chunk.url != nil) chunk.needsOffsetCheck = YES;
+        BBHTTPLogDebug(@"[%@] %@ failed (%@), retrying (%lu/%lu).", self, chunk, [error localizedDescription],
+                       (unsigned long)chunk.failures, (unsigned long)_maxRetriesPerChunk);
+
+        [_pendingChunks insertObject:chunk atIndex:0];
+    }
+
+    [self notifyProgress];
+    [self executePendingChunks];
+}
+
+- (void)finalRequestFinished:(BBHTTPRequest*)request
+{
+    if (_finished || (request != _finalRequest)) return;
+
+    _finalRequest = nil;
+
+    NSURL* url = nil;
+    NSError* error = [self createdUploadURL:&url fromRequest:request];
+    if (error == nil) {
+        _uploadURL = url;
+        [self finishWithError:nil];
+    } else if (_finalFailures >= _maxRetriesPerChunk) {
+        [self finishWithError:error];
+    } else {
+        _finalFailures++;
+        BBHTTPLogDebug(@"[%@] Concatenation failed (%@), retrying (%lu/%lu).", self, [error localizedDescription],
+                       (unsigned long)_finalFailures, (unsigned long)_maxRetriesPerChunk);
+        [self concatenateChunks];
+    }
+}
+
+
+#pragma mark Private helpers
+
+- (NSError*)prepareChunks
+{
+    NSError* error = nil;
+    NSDictionary* attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:_pathToFile error:&error];
+    if (error != nil) return error;
+
+    _fileSize = [attributes fileSize];
+    if (_fileSize == 0) return BBHTTPError(BBHTTPErrorCodeChunkedUploadFailed, @"File is empty (0 bytes).");
+
+    _modificationTime = (long long)([[attributes fileModificationDate] timeIntervalSince1970] * 1000);
+
+    if (![self restoreState]) {
+        [_chunks removeAllObjects];
+        for (unsigned long long start = 0; start < _fileSize; start += _chunkSize) {
+            unsigned long long end = MIN(start + _chunkSize, _fileSize);
+            [_chunks addObject:[[BBHTTPUploadChunk alloc] initWithStart:start end:end]];
+        }
+    }
+
+    _uploadedBytes = 0;
+    for (BBHTTPUploadChunk* chunk in _chunks) {
+        _uploadedBytes += chunk.confirmed;
+        if (![chunk isComplete]) [_pendingChunks addObject:chunk];
+    }
+
+    BBHTTPLogDebug(@"[%@] %@ %llub in %lu chunk(s), %lu left.", self, _resumed ? @"Resuming" : @"Uploading", _fileSize,
+                   (unsigned long)[_chunks count], (unsigned long)[_pendingChunks count]);
+
+    return nil;
+}
+
+- (BOOL)restoreState
+{
+    NSDictionary* state = [NSDictionary dictionaryWithContentsOfFile:_pathToStateFile];
+    if (state == nil) return NO;
+
+    // Anything but the exact same upload of the exact same file means starting over
+    if (([state[@"version"] integerValue] != kBBHTTPChunkedUploadStateVersion) ||
+        ![state[@"endpoint"] isEqual:[_url absoluteString]] || ![state[@"file"] isEqual:_pathToFile] ||
+        ([state[@"fileSize"] unsignedLongLongValue] != _fileSize) ||
+        ([state[@"modificationTime"] longLongValue] != _modificationTime)) {
+        BBHTTPLogInfo(@"[%@] Ignoring state file, it belongs to another upload or the file has changed.", self);
+        return NO;
+    }
+
+    unsigned long long expectedStart = 0;
+    for (NSDictionary* chunkState in state[@"chunks"]) {
+        unsigned long long start = [chunkState[@"start"] unsignedLongLongValue];
+        unsigned long long end = [chunkState[@"end"] unsignedLongLongValue];
+        if ((start != expectedStart) || (end <= start)) break;
+
+        BBHTTPUploadChunk* chunk = [[BBHTTPUploadChunk alloc] initWithStart:start end:end];
+        NSString* url = chunkState[@"url"];
+        if (url != nil) {
+            chunk.url = [NSURL URLWithString:url];
+            chunk.confirmed = MIN([chunkState[@"confirmed"] unsignedLongLongValue], [chunk length]);
+            // The server may have stored more than it got to acknowledge before the process went away
+            chunk.needsOffsetCheck = ![chunk isComplete];
+        }
+
+        [_chunks addObject:chunk];
+        expectedStart = end;
+    }
+
+    if (expectedStart != _fileSize) {
+        BBHTTPLogWarn(@"[%@] Ignoring corrupt state file.", self);
+        [_chunks removeAllObjects];
+        return NO;
+    }
+
+    _resumed = YES;
+    return YES;
+}
+
+- (void)saveState
+{
+    NSMutableArray* chunks = [NSMutableArray arrayWithCapacity:[_chunks count]];
+    for (BBHTTPUploadChunk* chunk in _chunks) {
+        NSMutableDictionary* chunkState = [NSMutableDictionary dictionary];
+        chunkState[@"start"] = @(chunk.start);
+        chunkState[@"end"] = @(chunk.end);
+        if (chunk.url != nil) {
+            chunkState[@"url"] = [chunk.url absoluteString];
+            chunkState[@"confirmed"] = @(chunk.confirmed);
+        }
+        [chunks addObject:chunkState];
+    }
+
+    NSDictionary* state = @{
+        @"version": @(kBBHTTPChunkedUploadStateVersion),
+        @"endpoint": [_url absoluteString],
+        @"file": _pathToFile,
+        @"fileSize": @(_fileSize),
+        @"modificationTime": @(_modificationTime),
+        @"chunks": chunks
+    };
+
+    // Losing the state only costs the ability to resume, not the upload itself
+    if (![state writeToFile:_pathToStateFile atomically:YES]) {
+        BBHTTPLogWarn(@"[%@] Couldn't write state file '%@'.", self, _pathToStateFile);
+    }
+}
+
+- (void)executePendingChunks
+{
+    while (!_finished && ([_activeChunks count] < _maxParallelChunks) && ([_pendingChunks count] > 0)) {
+        // If the executor won't take it now, try again when the next chunk finishes
+        if (![self executeChunk:_pendingChunks[0]]) break;
+        [_pendingChunks removeObjectAtIndex:0];
+    }
+
+    if (_finished || ([_activeChunks count] > 0)) return;
+
+    if ([_pendingChunks count] > 0) {
+        [self finishWithError:BBHTTPError(BBHTTPErrorCodeChunkedUploadFailed,
+                                          @"Executor rejected the requests for the remaining chunks.")];
+    } else {
+        [self concatenateChunks];
+    }
+}
+
+- (BOOL)executeChunk:(BBHTTPUploadChunk*)chunk
+{
+    BBHTTPRequest* request = nil;
+    if (chunk.url == nil) {
+        request = [[BBHTTPRequest alloc] initWithURL:_url andVerb:@"POST"];
+        [request setValue:[NSString stringWithFormat:@"%llu", [chunk length]] forHeader:H(UploadLength)];
+        if ([_chunks count] > 1) [request setValue:@"partial" forHeader:H(UploadConcat)];
+        [request setValue:@"0" forHeader:H(ContentLength)];
+
+    } else if (chunk.needsOffsetCheck) {
+        request = [[BBHTTPRequest alloc] initWithURL:chunk.url andVerb:@"HEAD"];
+
+    } else {
+        // Chunks are small enough for a regular, NSUInteger sized, upload body
+        NSError* error = nil;
+        BBHTTPUploadBody* body = [[BBHTTPUploadBody alloc] init];
+        if (![body addFile:_pathToFile offset:(chunk.start + chunk.confirmed) length:([chunk length] - chunk.confirmed)
+                     error:&error]) {
+            [self finishWithError:error];
+            return NO;
+        }
+
+        request = [[BBHTTPRequest alloc] initWithURL:chunk.url andVerb:@"PATCH"];
+        [request setValue:[NSString stringWithFormat:@"%llu", chunk.confirmed] forHeader:H(UploadOffset)];
+        [request setUploadBody:body withContentType:@"application/offset+octet-stream"];
+        request.uploadProgressBlock = ^(NSUInteger current, NSUInteger total) {
+            chunk.sent = current;
+            [self notifyProgress];
+        };
+    }
+
+    [request setValue:kBBHTTPChunkedUploadTusVersion forHeader:H(TusResumable)];
+    request.callbackQueue = _synchronizationQueue;
+
+    if (_requestSetupBlock != nil) _requestSetupBlock(request);
+
+    request.finishBlock = ^(BBHTTPRequest* finishedRequest) {
+        [self chunk:chunk finishedWithRequest:finishedRequest];
+    };
+
+    chunk.request = request;
+    [_activeChunks addObject:chunk];
+    if ([_executor executeRequest:request]) return YES;
+
+    [_activeChunks removeObject:chunk];
+    chunk.request = nil;
+
+    return NO;
+}
+
+- (NSError*)chunk:(BBHTTPUploadChunk*)chunk acceptResponseForRequest:(BBHTTPRequest*)request
+{
+    if ([request.verb isEqualToString:@"POST"]) {
+        NSURL* url = nil;
+        NSError* error = [self createdUploadURL:&url fromRequest:request];
+        if (error != nil) return error;
+
+        chunk.url = url;
+        chunk.confirmed = 0;
+        chunk.needsOffsetCheck = NO;
+        return nil;
+    }
+
+    BBHTTPResponse* response = request.response;
+    if (response == nil) return [self errorForFailedRequest:request];
+
+    if ((response.code == 404) || (response.code == 410)) {
+        // The server discarded the chunk's upload (e.g. it expired); it has to be created all over again
+        chunk.url = nil;
+        chunk.confirmed = 0;
+        chunk.needsOffsetCheck = NO;
+        return BBHTTPErrorWithFormat(BBHTTPErrorCodeChunkedUploadFailed, @"Chunk upload is gone (%lu)",
+                                     (unsigned long)response.code);
+    }
+
+    if ((response.code < 200) || (response.code >= 300)) {
+        return BBHTTPErrorWithFormat(response.code, @"Unnacceptable response: %lu %@",
+                                     (unsigned long)response.code, response.message);
+    }
+
+    NSString* offsetHeader = response[H(UploadOffset)];
+    long long offset = [offsetHeader longLongValue];
+    if ((offsetHeader == nil) || (offset < 0) || ((unsigned long long)offset > [chunk length])) {
+        return BBHTTPErrorWithFormat(BBHTTPErrorCodeChunkedUploadFailed, @"Invalid Upload-Offset: %@", offsetHeader);
+    }
+
+    // A PATCH that made no progress at all counts as a failure, so that it isn't retried forever
+    BOOL check = [request.verb isEqualToString:@"HEAD"];
+    if (!check && ((unsigned long long)offset <= chunk.confirmed)) {
+        return BBHTTPErrorWithFormat(BBHTTPErrorCodeChunkedUploadFailed, @"Server didn't store any data (offset %lld)",
+                                     offset);
+    }
+
+    chunk.confirmed = (unsigned long long)offset;
+    chunk.needsOffsetCheck = NO;
+    return nil;
+}
+
+- (NSError*)createdUploadURL:(NSURL**)url fromRequest:(BBHTTPRequest*)request
+{
+    BBHTTPResponse* response = request.response;
+    if (response == nil) return [self errorForFailedRequest:request];
+
+    if (response.code != 201) {
+        return BBHTTPErrorWithFormat(response.code, @"Unnacceptable response: %lu %@",
+                                     (unsigned long)response.code, response.message);
+    }
+
+    NSString* location = response[H(Location)];
+    NSURL* created = (location == nil) ? nil : [NSURL URLWithString:location relativeToURL:_url];
+    if (created == nil) return BBHTTPError(BBHTTPErrorCodeChunkedUploadFailed, @"Upload created without a Location.");
+
+    *url = [created absoluteURL];
+    return nil;
+}
+
+- (NSError*)errorForFailedRequest:(BBHTTPRequest*)request
+{
+    if (request.error != nil) return request.error;
+
+    return BBHTTPError(BBHTTPErrorCodeChunkedUploadFailed, @"Request finished without a response.");
+}
+
+- (void)concatenateChunks
+{
+    // A single chunk is a regular upload, there's nothing to concatenate
+    if ([_chunks count] == 1) {
+        _uploadURL = [_chunks[0] url];
+        [self finishWithError:nil];
+        return;
+    }
+
+    NSMutableArray* urls = [NSMutableArray arrayWithCapacity:[_chunks count]];
+    for (BBHTTPUploadChunk* chunk in _chunks) [urls addObject:[chunk.url absoluteString]];
+
+    BBHTTPRequest* request = [[BBHTTPRequest alloc] initWithURL:_url andVerb:@"POST"];
+    [request setValue:kBBHTTPChunkedUploadTusVersion forHeader:H(TusResumable)];
+    [request setValue:[@"final;" stringByAppendingString:[urls componentsJoinedByString:@" "]]
+            forHeader:H(UploadConcat)];
+    [request setValue:@"0" forHeader:H(ContentLength)];
+    request.callbackQueue = _synchronizationQueue;
+
+    if (_requestSetupBlock != nil) _requestSetupBlock(request);
+
+    request.finishBlock = ^(BBHTTPRequest* finishedRequest) {
+        [self finalRequestFinished:finishedRequest];
+    };
+
+    _finalRequest = request;
+    if (![_executor executeRequest:request]) {
+        _finalRequest = nil;
+        [self finishWithError:BBHTTPError(BBHTTPErrorCodeChunkedUploadFailed,
+                                          @"Executor rejected the request to concatenate the chunks.")];
+    }
+}
+
+- (void)notifyProgress
+{
+    unsigned long long uploaded = 0;
+    for (BBHTTPUploadChunk* chunk in _chunks) uploaded += chunk.confirmed + chunk.sent;
+    _uploadedBytes = uploaded;
+
+    void (^progress)(unsigned long long, unsigned long long) = _uploadProgressBlock;
+    if (progress == nil) return;
+
+    unsigned long long total = _fileSize;
+    dispatch_async(_callbackQueue, ^{
+        progress(uploaded, total);
+    });
+}
+
+- (void)finishWithError:(NSError*)error
+{
+    if (_finished) return;
+
+    _finished = YES;
+    _error = error;
+
+    for (BBHTTPUploadChunk* chunk in _activeChunks) [chunk.request cancel];
+    [_activeChunks removeAllObjects];
+    [_pendingChunks removeAllObjects];
+    [_finalRequest cancel];
+    _finalRequest = nil;
+
+    if ((error != nil) || _cancelled) {
+        // The state file stays behind, so the upload can be resumed
+        BBHTTPLogInfo(@"[%@] Upload %@.", self, _cancelled ? @"cancelled" : [error localizedDescription]);
+    } else {
+        [[NSFileManager defaultManager] removeItemAtPath:_pathToStateFile error:nil];
+        BBHTTPLogInfo(@"[%@] Upload finished (%llub): %@", self, _fileSize, _uploadURL);
+    }
+
+    void (^finish)(BBHTTPChunkedUpload*) = _finishBlock;
+    _finishBlock = nil;
+    _uploadProgressBlock = nil;
+    _requestSetupBlock = nil;
+
+    if (finish != nil) {
+        dispatch_async(_callbackQueue, ^{
+            finish(self);
+        });
+    }
+}
+
+
+#pragma mark Debug
+
+- (NSString*)description
+{
+    NSString* file = [_pathToFile lastPathComponent];
+    return [NSString stringWithFormat:@"%@{%@}", NSStringFromClass([self class]), file];
+}
+
+@end
@@ -118,6 +118,55 @@
 /** Opens and closes a connection for each request. */
 @property(assign, nonatomic) BOOL dontReuseConnections;
 
+/**
+ Maximum size, in bytes, of the response body of requests that don't define their own `maxResponseBodySize`.
+
+ Defaults to `0` (no limit).
+ */
+@property(assign, nonatomic) unsigned long long maxResponseBodySize;
+
+/**
+ Maximum amount, in bytes, of response data that running requests can hold in memory at any given time.
+
+ Only bodies kept in memory by their content handler (see `<[BBHTTPContentHandler buffersResponseInMemory]>`, e.g.
+ `<BBHTTPAccumulator>`) count towards this budget; requests reserve the whole body upfront when its size is known and
+ grow their reservation as data arrives otherwise, releasing it when they finish.
+
+ When the budget runs out, transfers that need more of it are paused and queued requests are held back until running
+ requests finish. To guarantee progress, a single request at a time may go over budget.
+
+ Defaults to `0` (no limit).
+ */
+@property(assign, nonatomic) unsigned long long maxBufferedResponseBytes;
+
+/**
+ Maximum time, in milliseconds, that uploads wait for a `100-Continue` before sending their body anyway.
+
+ Uploads that send `Expect: 100-Continue` (see `<[BBHTTPRequest dontSendExpect100Continue]>`) hold their body until the
+ server answers. The executor learns, per host, how long the `100-Continue` takes and waits at least twice as long for
+ hosts known to be slower than this. Hosts that already accepted an upload, or that repeatedly didn't send a
+ `100-Continue` in time, are sent uploads without the handshake.
+
+ libcurl itself doesn't send the body before a second has gone by, so shorter waits are rounded up to that.
+
+ Defaults to 1000; `0` waits until the request times out.
+ */
+@property(assign, nonatomic) NSUInteger expect100ContinueTimeout;
+
+
+#pragma mark Querying usage
+
+///---------------------
+/// @name Querying usage
+///---------------------
+
+/**
+ Amount, in bytes, of response data currently reserved by running requests against `<maxBufferedResponseBytes>`.
+
+ Requests only reserve bytes while there is a limit, so this is always `0` for executors without one.
+ */
+@property(assign, nonatomic, readonly) unsigned long long bufferedResponseBytes;
+
 
 #pragma mark Executing requests
 
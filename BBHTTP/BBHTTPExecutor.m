@@ -23,6 +23,8 @@
 
 #import "BBHTTPRequestContext.h"
 #import "BBHTTPRequest+PrivateInterface.h"
+#import "BBHTTPContentDecoder.h"
+#import "BBHTTPExpectationTracker.h"
 #import "BBHTTPUtils.h"
 
 
@@ -95,6 +97,10 @@ static size_t BBHTTPExecutorReadHeader(uint8_t* buffer, size_t size, size_t leng
 
 static size_t BBHTTPExecutorAppendData(uint8_t* buffer, size_t size, size_t length, BBHTTPRequestContext* context)
 {
+    // Handler can't keep up (or there's no memory budget left); curl holds on to this data and hands it back once the
+    // transfer is unpaused, which happens in BBHTTPExecutorProgressCallback()
+    if ([context shouldPauseDownloadForBytes:length]) return CURL_WRITEFUNC_PAUSE;
+
     BBHTTPEnsureSuccessOrReturn0([context appendDataToCurrentResponse:buffer withLength:length]);
 
     return length;
@@ -127,6 +133,14 @@ static size_t BBHTTPExecutorSendCallback(uint8_t* buffer, size_t size, size_t le
     }
 }
 
+static int BBHTTPExecutorSeekCallback(BBHTTPRequestContext* context, curl_off_t offset, int origin)
+{
+    // Curl only ever rewinds to the start of the body (e.g. to resend it over a fresh connection)
+    if ((origin != SEEK_SET) || (offset != 0)) return CURL_SEEKFUNC_CANTSEEK;
+
+    return [context rewindUpload] ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_CANTSEEK;
+}
+
 static size_t BBHTTPExecutorReceiveCallback(uint8_t* buffer, size_t size, size_t length, BBHTTPRequestContext* context)
 {
     if ([context.request wasCancelled]) return 0;
@@ -148,6 +162,25 @@ static size_t BBHTTPExecutorReceiveCallback(uint8_t* buffer, size_t size, size_t
     }
 }
 
+static int BBHTTPExecutorProgressCallback(BBHTTPRequestContext* context, curl_off_t downloadTotal,
+                                          curl_off_t downloaded, curl_off_t uploadTotal, curl_off_t uploaded)
+{
+    // Keeps getting called while the transfer is paused, which makes it the place to resume (or cancel) it
+    if ([context.request wasCancelled]) return 1;
+
+    if ([context isDownloadPaused] && [context resumeDownloadIfReady]) {
+        curl_easy_pause(context.handle, CURLPAUSE_RECV_CONT);
+    }
+
+    // Waited long enough for a 100-Continue; see BBHTTPExecutorSendCallback()
+    if ([context stopWaitingFor100ContinueIfExpired] && [context isUploadPaused]) {
+        [context unpauseUpload];
+        curl_easy_pause(context.handle, CURLPAUSE_SEND_CONT);
+    }
+
+    return 0;
+}
+
 static int BBHTTPExecutorDebugCallback(CURL* handle, curl_infotype type, char* text, size_t length, void* context)
 {
     switch (type) {
@@ -194,6 +227,9 @@ static int BBHTTPExecutorDebugCallback(CURL* handle, curl_infotype type, char* t
 
     NSMutableArray* _availableCurlHandles;
     NSMutableArray* _allCurlHandles;
+
+    BBHTTPMemoryBudget* _memoryBudget;
+    BBHTTPExpectationTracker* _expectationTracker;
 }
 
 static BOOL BBHTTPExecutorInitialized = NO;
@@ -226,6 +262,7 @@ static BOOL BBHTTPExecutorInitialized = NO;
     if (self != nil) {
         _maxParallelRequests = 3;
         _maxQueueSize = 1024;
+        _expect100ContinueTimeout = 1000;
 
 #if defined(__IPHONE_OS_VERSION_MIN_REQUIRED)
         _manageNetworkActivityIndicator = YES;
@@ -237,6 +274,9 @@ static BOOL BBHTTPExecutorInitialized = NO;
         _availableCurlHandles = [NSMutableArray array];
         _allCurlHandles = [NSMutableArray array];
 
+        _memoryBudget = [[BBHTTPMemoryBudget alloc] init];
+        _expectationTracker = [[BBHTTPExpectationTracker alloc] init];
+
         NSString* syncQueueId = [NSString stringWithFormat:@"com.biasedbit.HTTPExecutorSyncQueue-%@", identifier];
         _synchronizationQueue = dispatch_queue_create([syncQueueId UTF8String], DISPATCH_QUEUE_SERIAL);
 
@@ -287,6 +327,24 @@ static BOOL BBHTTPExecutorInitialized = NO;
     _maxParallelRequests = maxParallelRequests;
 }
 
+- (void)setMaxBufferedResponseBytes:(unsigned long long)maxBufferedResponseBytes
+{
+    _memoryBudget.limit = maxBufferedResponseBytes;
+}
+
+- (unsigned long long)maxBufferedResponseBytes
+{
+    return _memoryBudget.limit;
+}
+
+
+#pragma mark Querying usage
+
+- (unsigned long long)bufferedResponseBytes
+{
+    return _memoryBudget.used;
+}
+
 
 #pragma mark Performing requests
 
@@ -299,7 +357,7 @@ static BOOL BBHTTPExecutorInitialized = NO;
         if (request.cancelled) return; // already cancelled
         if ([self isAlreadyRunningOrQueued:request]) return;
 
-        if ([_running count] >= _maxParallelRequests) {
+        if (![self canStartRequest]) {
             [self enqueueRequest:request];
         } else {
 #if defined(__IPHONE_OS_VERSION_MIN_REQUIRED)
@@ -351,21 +409,48 @@ static BOOL BBHTTPExecutorInitialized = NO;
 {
     BBHTTPRequest* request = context.request;
 
+    context.maxResponseBodySize = (request.maxResponseBodySize > 0) ?
+                                  request.maxResponseBodySize : _maxResponseBodySize;
+    // Without a limit there's nothing to hold back, so there's no point in paying for the accounting
+    context.memoryBudget = (_memoryBudget.limit > 0) ? _memoryBudget : nil;
+
+    if ([request.responseContentHandler respondsToSelector:@selector(willExecuteRequest:)]) {
+        [request.responseContentHandler willExecuteRequest:request];
+    }
+
     if ((request.version == BBHTTPProtocolVersion_1_1) &&
         !request.dontSendExpect100Continue &&
         [request isUpload] &&
         ([request uploadSize] > kBBHTTPExecutorTinyUpload) &&
         ![request hasHeader:H(Expect) withValue:HV(100Continue)]) {
 
-        BBHTTPLogDebug(@"%@ | Adding 'Expect: 100-Continue' header to request (upload size > %lu)",
-                       context, (long)kBBHTTPExecutorTinyUpload);
-        [request setValue:HV(100Continue) forHeader:H(Expect)];
+        if ([_expectationTracker shouldSkip100ContinueForURL:request.url]) {
+            BBHTTPLogDebug(@"%@ | Host accepts uploads or ignores 100-Continue, not adding 'Expect' header.", context);
+        } else {
+            BBHTTPLogDebug(@"%@ | Adding 'Expect: 100-Continue' header to request (upload size > %lu)",
+                           context, (long)kBBHTTPExecutorTinyUpload);
+            [request setValue:HV(100Continue) forHeader:H(Expect)];
+        }
     }
 
     if ([context is100ContinueRequired]) {
         // Whenever we send out the Expect: 100-Continue header, we first must receive confirmation before sending data.
         // This part is just the setup, check out BBHTTPExecutorSendCallback() for the logic.
         [context waitFor100ContinueBeforeUploading];
+        context.expect100ContinueTimeout = [_expectationTracker wait100ContinueForURL:request.url
+                                                                          withTimeout:_expect100ContinueTimeout];
+    }
+
+    if (!request.dontAcceptCompressedContent && ![request hasHeader:H(AcceptEncoding)]) {
+        // Compressed responses are decoded by the request context before reaching the response content handler
+        [request setValue:[BBHTTPContentDecoder acceptedEncodings] forHeader:H(AcceptEncoding)];
+    }
+
+    if ([request isUploadCompressed]) {
+        BBHTTPLogDebug(@"%@ | Upload will be compressed, replacing 'Content-Length' with 'Content-Encoding: gzip'.",
+                       context);
+        [request removeHeader:H(ContentLength)];
+        [request setValue:HV(Gzip) forHeader:H(ContentEncoding)];
     }
 
     if ([request isUpload] &&
@@ -396,7 +481,8 @@ static BOOL BBHTTPExecutorInitialized = NO;
 
 - (void)executeNextRequest
 {
-    while (true) {
+    // Requests held back by the memory budget may all be able to go at once
+    while ([self canStartRequest]) {
         BBHTTPRequest* nextRequest = [self popQueuedRequest];
 
         if (nextRequest == nil) { // No more requests queued, bail out
@@ -410,12 +496,20 @@ static BOOL BBHTTPExecutorInitialized = NO;
 
         if ([nextRequest wasCancelled]) continue; // Loop again to find an executable request
 
-        // Executable operation found, break the loop; next operation finishing will trigger this method again
+        // Executable operation found; next operation finishing will trigger this method again
         [self createContextAndExecuteRequest:nextRequest];
-        return;
     }
 }
 
+- (BOOL)canStartRequest
+{
+    if ([_running count] >= _maxParallelRequests) return NO;
+
+    // New requests are held back while the running ones have used up the memory budget; with nothing running, there's
+    // nothing to wait for
+    return ([_running count] == 0) || ![_memoryBudget isExhausted];
+}
+
 - (BOOL)isAlreadyRunningOrQueued:(BBHTTPRequest*)request
 {
     return [_running containsObject:request] || [_queued containsObject:request];
@@ -467,11 +561,15 @@ static BOOL BBHTTPExecutorInitialized = NO;
 
     const char* verb = [request.verb UTF8String];
     curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, verb);
+    // HEAD responses announce the size of a body that never comes; without NOBODY, curl would wait for it
+    if ([request.verb isEqualToString:@"HEAD"]) curl_easy_setopt(handle, CURLOPT_NOBODY, 1L);
 
     const char* url = [[request.url absoluteString] UTF8String];
     curl_easy_setopt(handle, CURLOPT_URL, url);
 
 
+    BOOL sendUploadWithRequest = [self canSendUploadDataWithRequest:context];
+
     // Setup - headers
     __block struct curl_slist* headers = NULL;
     [request.headers enumerateKeysAndObjectsUsingBlock:^(NSString* key, NSString* value, BOOL* stop) {
@@ -482,21 +580,40 @@ static BOOL BBHTTPExecutorInitialized = NO;
         // if Expect header wasn't set until now, make sure libcurl doesn't add it
         curl_slist_append(headers, "Expect: ");
     }
+    if (sendUploadWithRequest && ![request hasHeader:H(ContentType)]) {
+        // curl would otherwise send these as 'application/x-www-form-urlencoded'
+        headers = curl_slist_append(headers, "Content-Type:");
+    }
 
     curl_easy_setopt(handle, CURLOPT_HEADER, 1L);
     curl_easy_setopt(handle, CURLOPT_HTTPHEADER, headers);
 
     // Setup - prepare upload if required
-    if ([request isUpload]) {
+    if (sendUploadWithRequest) {
+        // Small in-memory bodies are handed to curl as a whole; no stream and no read callbacks (curl keeps the custom
+        // verb in the request line). The request holds on to the data until it finishes.
+        NSData* data = request.uploadData;
+        curl_easy_setopt(handle, CURLOPT_UPLOAD, 0L);
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)[data length]);
+        curl_easy_setopt(handle, CURLOPT_POSTFIELDS, [data bytes]);
+        [context sendUploadDataWithRequest];
+    } else if ([request isUpload]) {
         curl_easy_setopt(handle, CURLOPT_UPLOAD, 1L);
-        curl_easy_setopt(handle, CURLOPT_INFILESIZE, [request uploadSize]);
+        // When the upload size is unknown (chunked transfer), curl expects -1. The _LARGE option is used so that
+        // multi-gigabyte sizes don't overflow a 32-bit long.
+        curl_off_t uploadSize = [request isUploadSizeKnown] ? (curl_off_t)[request uploadSize] : -1;
+        curl_easy_setopt(handle, CURLOPT_INFILESIZE_LARGE, uploadSize);
         curl_easy_setopt(handle, CURLOPT_READFUNCTION, BBHTTPExecutorSendCallback);
         curl_easy_setopt(handle, CURLOPT_READDATA, context);
+        curl_easy_setopt(handle, CURLOPT_SEEKFUNCTION, BBHTTPExecutorSeekCallback);
+        curl_easy_setopt(handle, CURLOPT_SEEKDATA, context);
     } else {
         curl_easy_setopt(handle, CURLOPT_UPLOAD, 0L);
-        curl_easy_setopt(handle, CURLOPT_INFILESIZE, 0L);
+        curl_easy_setopt(handle, CURLOPT_INFILESIZE_LARGE, (curl_off_t)0);
         curl_easy_setopt(handle, CURLOPT_READFUNCTION, NULL);
         curl_easy_setopt(handle, CURLOPT_READDATA, NULL);
+        curl_easy_setopt(handle, CURLOPT_SEEKFUNCTION, NULL);
+        curl_easy_setopt(handle, CURLOPT_SEEKDATA, NULL);
     }
 
     // Setup - response handling callback
@@ -526,7 +643,15 @@ static BOOL BBHTTPExecutorInitialized = NO;
 //    }
 
     // Setup - misc configuration
-    curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 1L);
+    if ([context supportsDownloadBackpressure] || [context is100ContinueRequired]) {
+        // Only the progress callback gets called while the transfer is paused, so it's needed to resume it
+        curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(handle, CURLOPT_XFERINFOFUNCTION, BBHTTPExecutorProgressCallback);
+        curl_easy_setopt(handle, CURLOPT_XFERINFODATA, context);
+    } else {
+        curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 1L);
+    }
+    curl_easy_setopt(handle, CURLOPT_HTTP_CONTENT_DECODING, 0L); // Content decoding is performed by the context
     curl_easy_setopt(handle, CURLOPT_FAILONERROR, 0L); // Handle >= 400 codes as success at this layer
     curl_easy_setopt(handle, CURLOPT_SSL_VERIFYPEER, context.request.allowInvalidSSLCertificates ? 0L : 1L);
 
@@ -561,6 +686,34 @@ static BOOL BBHTTPExecutorInitialized = NO;
         [context requestFinished];
         BBHTTPLogInfo(@"%@ | Request finished.", context);
     }
+
+    if ([request isUpload] && ![request wasCancelled]) [self learnExpectationsFromContext:context];
+}
+
+- (BOOL)canSendUploadDataWithRequest:(BBHTTPRequestContext*)context
+{
+    BBHTTPRequest* request = context.request;
+
+    // Anything that needs the read callback state machine (encoding, chunking, waiting for 100-Continue) can't
+    return (request.uploadData != nil) &&
+           ([request.uploadData length] <= kBBHTTPExecutorTinyUpload) &&
+           ![request isUploadCompressed] &&
+           !request.chunkedTransfer &&
+           ![context is100ContinueRequired];
+}
+
+- (void)learnExpectationsFromContext:(BBHTTPRequestContext*)context
+{
+    NSURL* url = context.request.url;
+
+    if (context.expect100ContinueLatency != NSNotFound) {
+        [_expectationTracker record100ContinueForURL:url latency:context.expect100ContinueLatency];
+    } else if ([context hasExpect100ContinueTimedOut]) {
+        [_expectationTracker recordMissing100ContinueForURL:url];
+    }
+
+    BBHTTPResponse* response = [context lastResponse];
+    if (response != nil) [_expectationTracker recordUploadToURL:url withStatusCode:response.code];
 }
 
 - (void)returnHandle:(CURL*)handle
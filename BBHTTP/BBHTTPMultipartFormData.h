@@ -0,0 +1,165 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+@class BBHTTPUploadBody;
+
+
+
+#pragma mark -
+
+/**
+ The `BBHTTPMultipartFormData` class builds `multipart/form-data` request bodies out of plain fields, in-memory data,
+ files and streams.
+
+ Nothing is assembled in memory: parts are only recorded as they're added and the body is produced lazily, straight
+ into the transfer buffers, as the request is sent. Files are read in the same way as uploads set with
+ `<[BBHTTPRequest setUploadFile:error:]>`, so forms with multi-gigabyte files are fine.
+
+ When the size of every part is known &mdash; i.e. no stream part was added with an unknown size &mdash; so is the
+ exact `<contentLength>` of the body, and the request is sent with a `Content-Length` header rather than chunked
+ transfer encoding.
+
+ Use it with `<[BBHTTPRequest setUploadMultipartFormData:]>`:
+
+    BBHTTPMultipartFormData* form = [[BBHTTPMultipartFormData alloc] init];
+    [form addValue:@"Holiday pictures" forField:@"title"];
+    [form addFile:path forField:@"picture" error:nil];
+    [request setUploadMultipartFormData:form];
+
+ @warning Stream parts can only be read once.
+ */
+@interface BBHTTPMultipartFormData : NSObject
+
+
+#pragma mark Creating a form
+
+///----------------------
+/// @name Creating a form
+///----------------------
+
+/**
+ Creates a new, empty form with a random boundary.
+
+ @return An initialized `BBHTTPMultipartFormData`.
+ */
+- (instancetype)init;
+
+
+#pragma mark Adding parts
+
+///-------------------
+/// @name Adding parts
+///-------------------
+
+/**
+ Adds a plain field.
+
+ @param value The value of the field, sent as UTF-8.
+ @param name The name of the field.
+ */
+- (void)addValue:(NSString*)value forField:(NSString*)name;
+
+/**
+ Adds a part with in-memory content.
+
+ @param data The content of the part.
+ @param name The name of the field.
+ @param fileName The file name to report to the server; may be `nil`.
+ @param contentType The MIME type of the content; may be `nil`.
+ */
+- (void)addData:(NSData*)data forField:(NSString*)name fileName:(NSString*)fileName
+    contentType:(NSString*)contentType;
+
+/**
+ Adds a file part, named after the file and with the content type inferred from its extension.
+
+ @param path Path to the file.
+ @param name The name of the field.
+ @param error If the file can't be read, the cause.
+
+ @return `YES` if the file was added, `NO` if it can't be read.
+ */
+- (BOOL)addFile:(NSString*)path forField:(NSString*)name error:(NSError**)error;
+
+/**
+ Adds a file part.
+
+ @param path Path to the file.
+ @param name The name of the field.
+ @param fileName The file name to report to the server.
+ @param contentType The MIME type of the content.
+ @param error If the file can't be read, the cause.
+
+ @return `YES` if the file was added, `NO` if it can't be read.
+ */
+- (BOOL)addFile:(NSString*)path forField:(NSString*)name fileName:(NSString*)fileName
+    contentType:(NSString*)contentType error:(NSError**)error;
+
+/**
+ Adds a part whose content is read from a stream.
+
+ A stream that ends before providing *size* bytes fails the upload; any bytes past *size* are ignored.
+
+ @param stream The stream to read the content from; it's opened and closed as the body is sent.
+ @param size The number of bytes the stream will provide; pass `0` if unknown, in which case the body is sent with
+ chunked transfer encoding.
+ @param name The name of the field.
+ @param fileName The file name to report to the server; may be `nil`.
+ @param contentType The MIME type of the content; may be `nil`.
+ */
+- (void)addStream:(NSInputStream*)stream ofSize:(unsigned long long)size forField:(NSString*)name
+         fileName:(NSString*)fileName contentType:(NSString*)contentType;
+
+
+#pragma mark Querying the body
+
+///------------------------
+/// @name Querying the body
+///------------------------
+
+/** The boundary between parts. */
+@property(copy, nonatomic, readonly) NSString* boundary;
+
+/** The value for the `Content-Type` header of the request, boundary included. */
+@property(copy, nonatomic, readonly) NSString* contentType;
+
+/** Exact size of the body, in bytes, or `0` if there's a stream part of unknown size. */
+@property(assign, nonatomic, readonly) unsigned long long contentLength;
+
+/**
+ Creates a stream that produces the body, reading each part as it goes.
+
+ Every call returns a new stream, starting from the first part.
+
+ @return A new input stream over the body.
+ */
+- (NSInputStream*)bodyStream;
+
+/**
+ Creates an upload body with the parts added so far, closing delimiter included.
+
+ Parts added afterwards don't make it into the returned body.
+
+ @return A new upload body for the form.
+ */
+- (BBHTTPUploadBody*)uploadBody;
+
+@end
@@ -0,0 +1,168 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPMultipartFormData.h"
+
+#import "BBHTTPUploadBody.h"
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark - Utility functions
+
+// Field and file names are sent as quoted strings; escape what would break out of them, as browsers do
+static NSString* BBHTTPMultipartQuote(NSString* string)
+{
+    string = [string stringByReplacingOccurrencesOfString:@"\"" withString:@"%22"];
+    string = [string stringByReplacingOccurrencesOfString:@"\r" withString:@"%0D"];
+    return [string stringByReplacingOccurrencesOfString:@"\n" withString:@"%0A"];
+}
+
+
+
+#pragma mark -
+
+@implementation BBHTTPMultipartFormData
+{
+    BBHTTPUploadBody* _body;
+    NSUInteger _partCount;
+}
+
+
+#pragma mark Creating a form
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self != nil) {
+        _boundary = [NSString stringWithFormat:@"BBHTTPFormBoundary%08x%08x", arc4random(), arc4random()];
+        _contentType = [NSString stringWithFormat:@"multipart/form-data; boundary=%@", _boundary];
+        _body = [[BBHTTPUploadBody alloc] init];
+    }
+
+    return self;
+}
+
+
+#pragma mark Adding parts
+
+- (void)addValue:(NSString*)value forField:(NSString*)name
+{
+    BBHTTPEnsureNotNil(value);
+
+    [self addData:[value dataUsingEncoding:NSUTF8StringEncoding] forField:name fileName:nil contentType:nil];
+}
+
+- (void)addData:(NSData*)data forField:(NSString*)name fileName:(NSString*)fileName
+    contentType:(NSString*)contentType
+{
+    BBHTTPEnsureNotNil(data);
+
+    [self addPartHeadersForField:name fileName:fileName contentType:contentType];
+    [_body addData:data];
+}
+
+- (BOOL)addFile:(NSString*)path forField:(NSString*)name error:(NSError**)error
+{
+    BBHTTPEnsureNotNil(path);
+
+    return [self addFile:path forField:name fileName:[path lastPathComponent] contentType:BBHTTPMimeType(path)
+                   error:error];
+}
+
+- (BOOL)addFile:(NSString*)path forField:(NSString*)name fileName:(NSString*)fileName
+    contentType:(NSString*)contentType error:(NSError**)error
+{
+    BBHTTPEnsureNotNil(path);
+
+    // The part is built on a copy, so that a file that can't be read leaves no orphaned headers behind in the form
+    BBHTTPUploadBody* body = [_body copy];
+    [body addData:[self partHeadersForField:name fileName:fileName contentType:contentType]];
+    if (![body addFile:path error:error]) return NO;
+
+    _body = body;
+    _partCount++;
+
+    return YES;
+}
+
+- (void)addStream:(NSInputStream*)stream ofSize:(unsigned long long)size forField:(NSString*)name
+         fileName:(NSString*)fileName contentType:(NSString*)contentType
+{
+    BBHTTPEnsureNotNil(stream);
+
+    [self addPartHeadersForField:name fileName:fileName contentType:contentType];
+    [_body addStream:stream ofSize:size];
+}
+
+
+#pragma mark Querying the body
+
+- (unsigned long long)contentLength
+{
+    return [[self uploadBody] size];
+}
+
+- (NSInputStream*)bodyStream
+{
+    return [[self uploadBody] bodyStream];
+}
+
+- (BBHTTPUploadBody*)uploadBody
+{
+    // Parts can still be added after a body is created, so the closing delimiter goes on a copy
+    NSString* prefix = (_partCount > 0) ? @"\r\n" : @"";
+    NSString* closing = [NSString stringWithFormat:@"%@--%@--\r\n", prefix, _boundary];
+
+    BBHTTPUploadBody* body = [_body copy];
+    [body addData:[closing dataUsingEncoding:NSUTF8StringEncoding]];
+
+    return body;
+}
+
+
+#pragma mark Private helpers
+
+- (void)addPartHeadersForField:(NSString*)name fileName:(NSString*)fileName contentType:(NSString*)contentType
+{
+    [_body addData:[self partHeadersForField:name fileName:fileName contentType:contentType]];
+    _partCount++;
+}
+
+- (NSData*)partHeadersForField:(NSString*)name fileName:(NSString*)fileName contentType:(NSString*)contentType
+{
+    BBHTTPEnsureNotNil(name);
+
+    // Every part but the first is preceded by the CRLF that ends the previous part's content
+    NSMutableString* headers = [NSMutableString string];
+    if (_partCount > 0) [headers appendString:@"\r\n"];
+
+    [headers appendFormat:@"--%@\r\nContent-Disposition: form-data; name=\"%@\"", _boundary,
+                          BBHTTPMultipartQuote(name)];
+    if (fileName != nil) [headers appendFormat:@"; filename=\"%@\"", BBHTTPMultipartQuote(fileName)];
+    [headers appendString:@"\r\n"];
+    if (contentType != nil) [headers appendFormat:@"Content-Type: %@\r\n", contentType];
+    [headers appendString:@"\r\n"];
+
+    return [headers dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+@end
@@ -117,6 +117,16 @@
  */
 - (void)downloadContentAsData;
 
+/**
+ Treat the reponse body as memory-mapped `NSData`.
+
+ Just like `<downloadContentAsData>` but the body is streamed to an unlinked temporary file which is then mapped into
+ memory, instead of being accumulated in the heap. Use it for very large responses.
+
+ This method assigns a `<BBHTTPMappedAccumulator>` as the `<responseContentHandler>` for this request.
+ */
+- (void)downloadContentAsMappedData;
+
 /**
  Treat the reponse body as a `NSString`
  
@@ -182,6 +192,13 @@
  */
 - (instancetype)asData;
 
+/**
+ Fluent syntax shortcut for `<downloadContentAsMappedData>`.
+
+ @return The current instance.
+ */
+- (instancetype)asMappedData;
+
 /**
  Fluent syntax shortcut for `<downloadContentAsString>`.
 
@@ -22,6 +22,7 @@
 #import "BBHTTPRequest+Convenience.h"
 
 #import "BBHTTPAccumulator.h"
+#import "BBHTTPMappedAccumulator.h"
 #import "BBHTTPToStringConverter.h"
 #import "BBJSONParser.h"
 #import "BBHTTPImageDecoder.h"
@@ -124,6 +125,11 @@
     self.responseContentHandler = [[BBHTTPAccumulator alloc] init];
 }
 
+- (void)downloadContentAsMappedData
+{
+    self.responseContentHandler = [[BBHTTPMappedAccumulator alloc] init];
+}
+
 - (void)downloadContentAsString
 {
     self.responseContentHandler = [[BBHTTPToStringConverter alloc] init];
@@ -166,6 +172,13 @@
     return self;
 }
 
+- (instancetype)asMappedData
+{
+    [self downloadContentAsMappedData];
+
+    return self;
+}
+
 - (instancetype)asString
 {
     [self downloadContentAsString];
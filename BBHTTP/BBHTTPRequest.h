@@ -22,6 +22,9 @@
 #import "BBHTTPResponse.h"
 #import "BBHTTPContentHandler.h"
 
+@class BBHTTPMultipartFormData;
+@class BBHTTPUploadBody;
+
 
 
 #pragma mark - Custom types
@@ -33,6 +36,17 @@ struct BBTransferSpeed {
 typedef struct BBTransferSpeed BBTransferSpeed;
 
 
+/** How request events (start, progress, finish) are delivered; see `<[BBHTTPRequest callbackDelivery]>`. */
+typedef NS_ENUM(NSUInteger, BBHTTPCallbackDelivery) {
+    /** Each event is delivered with its own `dispatch_async` to the callback queue. */
+    BBHTTPCallbackDeliveryAsync = 0,
+    /** Events are delivered synchronously, on the thread where they happen (usually the transfer thread). */
+    BBHTTPCallbackDeliveryInline,
+    /** Events of all requests targeting the same callback queue are delivered in batches, one dispatch per batch. */
+    BBHTTPCallbackDeliveryBatched
+};
+
+
 
 #pragma mark - Utility Functions
 
@@ -58,8 +72,12 @@ extern NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed);
     long long _endTimestamp;
     NSUInteger _sentBytes;
     NSUInteger _receivedBytes;
+    NSUInteger _decodedBytes;
     NSError* _error;
     BBHTTPResponse* _response;
+    id _uploadProgressCoalescer;
+    id _downloadProgressCoalescer;
+    id _uploadSpool;
 }
 
 
@@ -120,19 +138,42 @@ extern NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed);
 @property(copy, nonatomic) void (^finishBlock)(id request);
 
 /**
- Block that will be called every time a new chunk of data is written to the remote server, during the upload phase.
+ Block that will be called as data is written to the remote server, during the upload phase, at most once every
+ `<progressInterval>`.
  
  The *total* may be reported as `0` if the upload size is unknown (chunked transfer encoding from a stream).
  */
 @property(copy, nonatomic) void (^uploadProgressBlock)(NSUInteger current, NSUInteger total);
 
 /**
- Block that will be called every time a new chunk of data is read from the remote server, during the download phase.
+ Block that will be called as data is read from the remote server, during the download phase, at most once every
+ `<progressInterval>`.
 
  The *total* may be reported as `0` if the download size is unknown (chunked transfer encoding).
+
+ Both *current* and *total* are measured in bytes as received from the wire; when the response is compressed, the number
+ of bytes handed to the `<responseContentHandler>` so far is available through `<decodedBytes>`.
  */
 @property(copy, nonatomic) void (^downloadProgressBlock)(NSUInteger current, NSUInteger total);
 
+/**
+ Minimum time, in seconds, between two consecutive calls to `<uploadProgressBlock>` or `<downloadProgressBlock>`.
+
+ Progress events are coalesced: intermediate events are dropped and, when a call is made, it always reports the latest
+ progress. The final event (i.e. *current* reaching *total*) is never dropped and the latest progress is always
+ reported before `<finishBlock>` is called.
+
+ Defaults to `0.1`; set to `0` to get an event for every chunk of data (still coalesced, if `<callbackQueue>` is busy).
+ */
+@property(assign, nonatomic) NSTimeInterval progressInterval;
+
+/**
+ Minimum progress, in bytes, between two consecutive calls to `<uploadProgressBlock>` or `<downloadProgressBlock>`.
+
+ Applies on top of `<progressInterval>`, with the same guarantees for final events. Defaults to `0`.
+ */
+@property(assign, nonatomic) NSUInteger progressByteStep;
+
 
 #pragma mark Managing download behavior
 
@@ -148,6 +189,29 @@ extern NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed);
 @property(assign, nonatomic, readonly) double downloadProgress;
 @property(assign, nonatomic, readonly) double downloadTransferRate;
 
+/**
+ Explicitly avoid negotiating compressed response content.
+
+ By default, requests are sent with `Accept-Encoding: gzip, deflate` and compressed responses are transparently decoded
+ before being handed to the `<responseContentHandler>` &mdash; handlers always see decoded bytes. When set to `YES`, the
+ `Accept-Encoding` header is not added and response content is handed to the handler exactly as received.
+
+ Defaults to `NO`.
+ */
+@property(assign, nonatomic) BOOL dontAcceptCompressedContent;
+
+/**
+ Maximum size, in bytes, of a response body.
+
+ Responses that announce a larger `Content-Length` are rejected as soon as the headers are received; responses of
+ unknown size (chunked) are aborted as soon as they cross the limit. The limit also applies to the decoded body of
+ compressed responses. Either way, the connection is dropped rather than drained and the request fails with an error
+ with code `BBHTTPErrorCodeResponseTooLarge`.
+
+ Defaults to `0`, meaning the executor's `maxResponseBodySize` applies.
+ */
+@property(assign, nonatomic) unsigned long long maxResponseBodySize;
+
 
 #pragma mark Managing upload behavior
 
@@ -212,6 +276,9 @@ extern NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed);
  If this method returns `YES`, the property `<upload>` will report `YES`. The `Content-Length` header will automatically
  be set as well.
 
+ Buffers of up to 8KB that are neither compressed nor chunked are handed to libcurl along with the request, skipping the
+ upload stream altogether.
+
  @param data Data buffer to use as request body.
  @param contentType The value to use on the `Content-Type` header. Must be a valid
  [MIME type](http://tools.ietf.org/html/rfc2046).
@@ -220,8 +287,50 @@ extern NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed);
  */
 - (BOOL)setUploadData:(NSData*)data withContentType:(NSString*)contentType;
 
+/**
+ Set a body made of several segments (data, files, ranges of files and streams) as the upload body.
+
+ The segments are sent one after the other, each read straight into the transfer buffers, with no intermediate
+ concatenation (see `<BBHTTPUploadBody>`). The `Content-Length` header is set if the size of every segment is known;
+ otherwise the body is sent with chunked transfer encoding.
+
+ @param body The body to upload.
+ @param contentType The value to use on the `Content-Type` header. Must be a valid
+ [MIME type](http://tools.ietf.org/html/rfc2046).
+
+ @return `YES` if this request is HTTP/1.1 and the body isn't too large to upload, `NO` otherwise.
+ */
+- (BOOL)setUploadBody:(BBHTTPUploadBody*)body withContentType:(NSString*)contentType;
+
 - (BOOL)setUploadFormData:(NSDictionary*)formData;
 
+/**
+ Set a `multipart/form-data` form as the upload body.
+
+ The body is streamed as it's sent (see `<BBHTTPMultipartFormData>`); the `Content-Type` header is set with the form's
+ boundary and, if the size of every part is known, so is the `Content-Length` header. Otherwise the body is sent with
+ chunked transfer encoding.
+
+ @param formData The form to upload.
+
+ @return `YES` if this request is HTTP/1.1 and the body isn't too large to upload, `NO` otherwise.
+ */
+- (BOOL)setUploadMultipartFormData:(BBHTTPMultipartFormData*)formData;
+
+/**
+ Set the upload body of another request as this request's upload body, from its first byte.
+
+ Meant for re-sending a body after a failure or a response that calls for it (e.g. `307` or `417`). Data and file
+ bodies, as well as upload bodies without stream segments (see `<uploadBody>`), are simply shared; a stream body can
+ only be taken over if it was spooled (see `<uploadReplayLimit>`) or if nothing was read from it yet. The spool moves
+ over to this request, so *request* can't replay the body anymore. The `Content-Type` header is carried over as well.
+
+ @param request The request whose upload body to replay.
+
+ @return `YES` if the body can be replayed, `NO` otherwise.
+ */
+- (BOOL)setUploadReplayedFromRequest:(BBHTTPRequest*)request;
+
 /** Flag that signals whether this request is an upload (from stream, file or memory). */
 @property(assign, nonatomic, readonly, getter = isUpload) BOOL upload;
 
@@ -236,21 +345,93 @@ extern NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed);
  */
 @property(assign, nonatomic, readonly, getter = isUploadSizeKnown) BOOL uploadSizeKnown;
 
+/**
+ Flag that signals whether the upload body will be compressed.
+
+ This flag is only set to `YES` if the request is an HTTP/1.1 upload and `<compressUpload>` is enabled.
+
+ @see compressUpload
+ */
+@property(assign, nonatomic, readonly, getter = isUploadCompressed) BOOL uploadCompressed;
+
 /** The size, in bytes, of the upload, if any. */
 @property(assign, nonatomic, readonly) NSUInteger uploadSize;
 
 /** The stream from which the upload body will be read, if any. */
 @property(strong, nonatomic, readonly) NSInputStream* uploadStream;
 
-/** The file to upload, if any. */
+/**
+ The body set with `<setUploadBody:withContentType:>` or `<setUploadMultipartFormData:>`, if any.
+
+ `<uploadStream>` is a stream over this body. If the body has no stream segments, it's read from a new stream every
+ time the upload is rewound or replayed, so it never needs to be spooled.
+ */
+@property(strong, nonatomic, readonly) BBHTTPUploadBody* uploadBody;
+
+/**
+ The file to upload, if any.
+
+ Unless the upload is compressed, the file is read straight into the transfer buffers (with kernel read-ahead) rather
+ than through an `NSInputStream`. A file truncated while the upload is in progress fails the request.
+
+ @see mapUploadFile
+ */
 @property(copy, nonatomic) NSString* uploadFile;
 
+/**
+ Flag that indicates that `<uploadFile>` should be memory-mapped, rather than read, for the upload.
+
+ Mapping saves a system call per transfer buffer, but the file must not be truncated while the upload is in progress:
+ a truncation is only detected before mapping each (16MB) window of the file, and touching the pages lost within the
+ current window kills the process with `SIGBUS`. Only enable this for files that are guaranteed not to change.
+
+ Ignored for compressed uploads. Defaults to `NO`.
+ */
+@property(assign, nonatomic) BOOL mapUploadFile;
+
 /** The in-memory buffer of data to upload, if any. */
 @property(strong, nonatomic, readonly) NSData* uploadData;
 
 @property(assign, nonatomic, readonly) double uploadProgress;
 @property(assign, nonatomic, readonly) double uploadTransferRate;
 
+/**
+ Flag that indicates that the upload body should be compressed on the fly and sent with `Content-Encoding: gzip`.
+
+ Since the compressed size cannot be known beforehand, compressed uploads are always sent with chunked transfer encoding
+ and the `Content-Length` header is dropped. As such, this flag is ignored if this request is not a `HTTP/1.1` request.
+
+ Upload progress is still reported in raw (uncompressed) bytes, so that it remains comparable to `<uploadSize>`.
+
+ Make sure the server accepts compressed request bodies before enabling this.
+
+ Defaults to `NO`.
+ */
+@property(assign, nonatomic) BOOL compressUpload;
+
+/**
+ Compression level used when `<compressUpload>` is enabled, ranging from 1 (fastest) to 9 (smallest output).
+
+ Defaults to 6.
+ */
+@property(assign, nonatomic) NSUInteger uploadCompressionLevel;
+
+/**
+ Maximum size, in bytes, of a stream upload body to keep as it's sent, so that it can be sent again.
+
+ Bodies set with `<setUploadStream:withContentType:andSize:>` can only be read once. When this is set, whatever is read
+ from the stream is spooled (the first megabyte in memory, the rest in a temporary file). This allows libcurl to rewind
+ the upload &mdash; e.g. when a reused connection turns out to be dead &mdash; and the body to be replayed on a
+ follow-up request with `<setUploadReplayedFromRequest:>`, after a `307`, a `417` or a failure. The spool is dropped as
+ soon as the request gets a `2xx` response.
+
+ Bodies larger than this stop being spooled and compressed uploads are never spooled. Data and file uploads, as well as
+ upload bodies without stream segments, can always be replayed, regardless of this setting.
+
+ Defaults to `0` (no spooling).
+ */
+@property(assign, nonatomic) unsigned long long uploadReplayLimit;
+
 
 #pragma mark Manipulating headers
 
@@ -324,6 +505,15 @@ extern NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed);
  */
 - (void)setObject:(NSString*)value forKeyedSubscript:(NSString*)header;
 
+/**
+ Remove a header.
+
+ @param header The name of the header to remove.
+
+ @return `YES` if the header was removed, `NO` if the request had no such header.
+ */
+- (BOOL)removeHeader:(NSString*)header;
+
 
 #pragma mark Timeout conditions and speed limits
 
@@ -388,6 +578,22 @@ extern NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed);
 @property(assign, nonatomic) dispatch_queue_t callbackQueue;
 #endif
 
+/**
+ How events are delivered to `<callbackQueue>`.
+
+ - `BBHTTPCallbackDeliveryAsync` (the default) hops to `<callbackQueue>` once per event; simple and safe for UI code.
+ - `BBHTTPCallbackDeliveryInline` ignores `<callbackQueue>` and runs the blocks right away, on the thread where the
+ event happens &mdash; the transfer thread, for most events, or the thread calling `<cancel>`. It has the lowest latency
+ and no thread hops at all, which suits daemons and other workloads without a UI, but blocks must be quick and
+ thread-safe: while they run, the transfer is stalled.
+ - `BBHTTPCallbackDeliveryBatched` queues events up and delivers them to `<callbackQueue>` in batches, shared with all
+ the other batched requests targeting the same queue: under load, a single dispatch delivers the events of many
+ requests, at the cost of some extra latency for each individual event.
+
+ Either way, the events of a request are delivered in order.
+ */
+@property(assign, nonatomic) BBHTTPCallbackDelivery callbackDelivery;
+
 /**
  Explicitly avoid using the `Expect: 100-Continue` header.
 
@@ -458,6 +664,8 @@ extern NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed);
 @property(assign, nonatomic, readonly, getter = isExecuting) BOOL executing;
 @property(assign, nonatomic, readonly) NSUInteger sentBytes;
 @property(assign, nonatomic, readonly) NSUInteger receivedBytes;
+/** Number of response content bytes handed to the `<responseContentHandler>`, after decoding compressed content. */
+@property(assign, nonatomic, readonly) NSUInteger decodedBytes;
 
 @property(strong, nonatomic, readonly) NSError* error;
 @property(assign, nonatomic, readonly, getter = wasSuccessfullyExecuted) BOOL successfullyExecuted;
@@ -21,6 +21,10 @@
 
 #import "BBHTTPRequest.h"
 
+#import "BBHTTPRequest+PrivateInterface.h"
+#import "BBHTTPMultipartFormData.h"
+#import "BBHTTPUploadBody.h"
+#import "BBHTTPUploadSpool.h"
 #import "BBHTTPUtils.h"
 
 
@@ -94,6 +98,8 @@ NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed)
         _downloadTimeout = BBTransferSpeedMake(1024, 20);
         _uploadSpeedLimit = 0;
         _downloadSpeedLimit = 0;
+        _uploadCompressionLevel = 6;
+        _progressInterval = 0.1;
         _callbackQueue = dispatch_get_main_queue();
 
         NSString* hostHeaderValue = [_url host];
@@ -163,6 +169,8 @@ NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed)
 
     _uploadFile = nil;
     _uploadData = nil;
+    _uploadBody = nil;
+    _uploadSpool = nil;
 
     _uploadStream = stream;
     _uploadSize = size;
@@ -202,6 +210,8 @@ NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed)
 
     _uploadData = nil;
     _uploadStream = nil;
+    _uploadBody = nil;
+    _uploadSpool = nil;
 
     _uploadSize = (NSUInteger)size;
     _uploadFile = [path copy];
@@ -218,6 +228,8 @@ NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed)
 
     _uploadStream = nil;
     _uploadFile = nil;
+    _uploadBody = nil;
+    _uploadSpool = nil;
 
     _uploadData = data;
     _uploadSize = [data length];
@@ -228,6 +240,24 @@ NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed)
     return YES;
 }
 
+- (BOOL)setUploadBody:(BBHTTPUploadBody*)body withContentType:(NSString*)contentType
+{
+    BBHTTPEnsureNotNil(body);
+
+    unsigned long long size = body.size;
+    if (size > NSUIntegerMax) {
+        BBHTTPLogError(@"Body is too large (>%lu bytes)", NSUIntegerMax);
+        return NO;
+    }
+
+    // A copy, so that segments added later don't change the body behind the stream's back
+    BBHTTPUploadBody* uploadBody = [body copy];
+    if (![self setUploadStream:[uploadBody bodyStream] withContentType:contentType andSize:(NSUInteger)size]) return NO;
+    _uploadBody = uploadBody;
+
+    return YES;
+}
+
 - (BOOL)setUploadFormData:(NSDictionary*)formData
 {
     BBHTTPEnsureNotNil(formData);
@@ -252,6 +282,51 @@ NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed)
     return [self setUploadData:data withContentType:@"application/x-www-form-urlencoded"];
 }
 
+- (BOOL)setUploadMultipartFormData:(BBHTTPMultipartFormData*)formData
+{
+    BBHTTPEnsureNotNil(formData);
+
+    return [self setUploadBody:[formData uploadBody] withContentType:formData.contentType];
+}
+
+- (BOOL)setUploadReplayedFromRequest:(BBHTTPRequest*)request
+{
+    BBHTTPEnsureNotNil(request);
+
+    NSString* contentType = request.headers[H(ContentType)];
+    if (contentType == nil) contentType = @"application/octet-stream";
+
+    if (request.uploadData != nil) return [self setUploadData:request.uploadData withContentType:contentType];
+
+    if (request.uploadFile != nil) {
+        if (![self setUploadFile:request.uploadFile error:nil]) return NO;
+        [self setValue:contentType forHeader:H(ContentType)];
+        return YES;
+    }
+
+    if ([request.uploadBody isReplayable]) return [self setUploadBody:request.uploadBody withContentType:contentType];
+
+    if (request.uploadStream == nil) return NO;
+
+    // An untouched stream can be taken over even if it wasn't being spooled
+    BBHTTPUploadSpool* spool = request->_uploadSpool;
+    if ((spool == nil) && ([request.uploadStream streamStatus] != NSStreamStatusNotOpen)) return NO;
+
+    if (spool == nil) spool = [request uploadSpool];
+    if (![spool canReadFromOffset:0]) {
+        BBHTTPLogWarn(@"%@ | Upload body of %@ wasn't (fully) spooled, it can't be replayed.", self, request);
+        return NO;
+    }
+
+    if (![self setUploadStream:request.uploadStream withContentType:contentType andSize:request.uploadSize]) return NO;
+    // The spool moves over, rather than being shared, so that it's dropped as soon as this request succeeds
+    _uploadSpool = spool;
+    _uploadReplayLimit = spool.maxLength;
+    request->_uploadSpool = nil;
+
+    return YES;
+}
+
 - (BOOL)isUpload
 {
     return (_uploadData != nil) || (_uploadFile != nil) || (_uploadStream != nil);
@@ -259,11 +334,18 @@ NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed)
 
 - (BOOL)isUploadSizeKnown
 {
+    if ([self isUploadCompressed]) return NO; // Compressed size is only known once the upload finishes
     if ((_uploadStream != nil) && (_uploadSize == 0)) return NO;
     if ((_uploadFile != nil) || (_uploadData != nil)) return YES;
     else return NO;
 }
 
+- (BOOL)isUploadCompressed
+{
+    // Compressed uploads rely on chunked transfer encoding, which requires HTTP/1.1
+    return [self isUpload] && _compressUpload && (_version == BBHTTPProtocolVersion_1_1);
+}
+
 - (double)uploadProgress
 {
     NSUInteger toSend = self.uploadSize;
@@ -321,6 +403,17 @@ NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed)
     [self setValue:value forHeader:header];
 }
 
+- (BOOL)removeHeader:(NSString*)header
+{
+    BBHTTPEnsureNotNil(header);
+
+    if (_headers[header] == nil) return NO;
+
+    [_headers removeObjectForKey:header];
+
+    return YES;
+}
+
 
 #pragma mark Querying request properties
 
@@ -380,13 +473,13 @@ NSString* NSStringFromBBTransferSpeed(BBTransferSpeed transferSpeed)
     _endTimestamp = now;
 
     if (_finishBlock != nil) {
-        dispatch_async(_callbackQueue, ^{
+        [self dispatchCallback:^{
             _finishBlock(self);
 
             _uploadProgressBlock = nil;
             _downloadProgressBlock = nil;
             _finishBlock = nil;
-        });
+        }];
     }
 
     return YES;
@@ -0,0 +1,184 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+@class BBHTTPExecutor;
+@class BBHTTPRequest;
+
+
+
+#pragma mark -
+
+/**
+ The `BBHTTPSegmentedDownload` class downloads a single large resource to a file over several parallel connections.
+
+ A single connection rarely fills a link with a high bandwidth-delay product; splitting the resource into byte ranges
+ and fetching them in parallel usually gets a lot closer to the available bandwidth.
+
+ ### How it works
+
+ The download begins with a single `GET` request for `bytes=0-`. If the server replies with `206 Partial Content` and
+ reveals the total size, the target file is preallocated and the remainder of the resource is split into up to
+ `<maxSegments>` ranges, each fetched by its own request on the `<executor>` &mdash; the first request simply keeps
+ going until the end of its own range. Every segment writes directly to its position in the file with `pwrite(2)`, so
+ nothing is buffered in memory or copied around afterwards.
+
+ Whenever a segment completes, the idle connection steals the second half of the segment with the most data left to
+ receive, so that a single slow connection doesn't hold back the whole download. Segments whose request fails are
+ retried from the point where they stopped, up to `<maxRetriesPerSegment>` times.
+
+ All segments are conditioned on the validator (strong `ETag` or `Last-Modified`) of the first response; if the
+ resource changes mid-download the whole download fails rather than produce a corrupt file.
+
+ If the server doesn't support ranges (replies with `200 OK`), the size is unknown or the response carries no
+ validator, the download gracefully degrades to a regular, single connection download.
+
+ A download that fails or is cancelled deletes the target file, but only once it has started writing to it; a file that
+ was already there is left untouched if the download fails before the first response is accepted.
+
+ ### Parallelism
+
+ Segments are regular requests, so the actual number of parallel connections is also bound by the executor's
+ `maxParallelRequests`. Using a dedicated executor for large segmented downloads keeps them from starving other
+ requests.
+ */
+@interface BBHTTPSegmentedDownload : NSObject
+
+
+#pragma mark Creating a segmented download
+
+///------------------------------------
+/// @name Creating a segmented download
+///------------------------------------
+
+/**
+ Creates a new segmented download.
+
+ @param url The URL of the resource to download.
+ @param pathToFile Path to the file to write to; if it already exists, it will be overwritten.
+
+ @return An initialized `BBHTTPSegmentedDownload`.
+ */
+- (instancetype)initWithURL:(NSURL*)url targetFile:(NSString*)pathToFile;
+
+
+#pragma mark Configuring behavior
+
+///---------------------------
+/// @name Configuring behavior
+///---------------------------
+
+/** The executor where segment requests are executed. Defaults to `<[BBHTTPExecutor sharedExecutor]>`. */
+@property(strong, nonatomic) BBHTTPExecutor* executor;
+
+/** Maximum number of segments being downloaded at any given time. Defaults to 4, minimum allowed value is 1. */
+@property(assign, nonatomic) NSUInteger maxSegments;
+
+/**
+ Smallest range worth fetching on its own connection.
+
+ Resources are never split into segments smaller than this, and segments with less than twice this amount left to
+ receive are never split to feed idle connections. Defaults to 1MB.
+ */
+@property(assign, nonatomic) unsigned long long minSegmentSize;
+
+/** Number of times a failed segment is retried before the download fails. Defaults to 2. */
+@property(assign, nonatomic) NSUInteger maxRetriesPerSegment;
+
+/**
+ Block that will be called to configure each of the requests issued by this download.
+
+ Use it to add authentication headers, adjust timeouts, etc. It's called right before each request is executed, so it
+ may be called several times throughout the download.
+ */
+@property(copy, nonatomic) void (^requestSetupBlock)(BBHTTPRequest* request);
+
+/**
+ The queue where events (progress, finish) will be dispatched to.
+
+ Defaults to `dispatch_get_main_queue()`
+ */
+#if OS_OBJECT_USE_OBJC
+@property(strong, nonatomic) dispatch_queue_t callbackQueue;
+#else
+@property(assign, nonatomic) dispatch_queue_t callbackQueue;
+#endif
+
+
+#pragma mark Handling download events
+
+///-------------------------------
+/// @name Handling download events
+///-------------------------------
+
+/**
+ Block that will be called every time a chunk of data is written to the file, by any of the segments.
+
+ *current* is the total number of bytes written so far, across all segments; *total* may be reported as `0` if the
+ size of the resource is unknown.
+ */
+@property(copy, nonatomic) void (^downloadProgressBlock)(unsigned long long current, unsigned long long total);
+
+/** Block that will be called when the download terminates, either normally or abnormally. */
+@property(copy, nonatomic) void (^finishBlock)(BBHTTPSegmentedDownload* download);
+
+
+#pragma mark Executing the download
+
+///-----------------------------
+/// @name Executing the download
+///-----------------------------
+
+/**
+ Starts the download.
+
+ @return `YES` if the download was started, `NO` if it was already started or the first request was rejected by the
+ executor.
+ */
+- (BOOL)start;
+
+/**
+ Cancels the download, cancelling all segment requests and deleting the partially downloaded file.
+
+ @return `YES` if the download was cancelled, `NO` if it had already finished.
+ */
+- (BOOL)cancel;
+
+
+#pragma mark Querying download information
+
+///------------------------------------
+/// @name Querying download information
+///------------------------------------
+
+@property(copy, nonatomic, readonly) NSURL* url;
+@property(copy, nonatomic, readonly) NSString* pathToFile;
+/** The size of the resource, in bytes, when known. */
+@property(assign, nonatomic, readonly) unsigned long long fileSize;
+/** Total number of bytes written to the file, across all segments. */
+@property(assign, nonatomic, readonly) unsigned long long downloadedBytes;
+/** `YES` if the server accepted range requests and the download was split in segments. */
+@property(assign, nonatomic, readonly, getter = isSegmented) BOOL segmented;
+@property(assign, nonatomic, readonly, getter = hasStarted) BOOL started;
+@property(assign, nonatomic, readonly, getter = hasFinished) BOOL finished;
+@property(assign, nonatomic, readonly, getter = wasCancelled) BOOL cancelled;
+@property(strong, nonatomic, readonly) NSError* error;
+
+@end
@@ -0,0 +1,674 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPSegmentedDownload.h"
+
+#import <fcntl.h>
+#import <unistd.h>
+
+#import "BBHTTPExecutor.h"
+#import "BBHTTPRequest.h"
+#import "BBHTTPContentHandler.h"
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark - Constants
+
+// End offset of a segment whose size isn't known until the response arrives (or at all)
+#define kBBHTTPSegmentUnknownEnd ULLONG_MAX
+
+
+
+#pragma mark - Utility functions
+
+static NSError* BBHTTPSegmentedDownloadPOSIXError(int code, NSString* path)
+{
+    return [NSError errorWithDomain:NSPOSIXErrorDomain code:code userInfo:@{NSFilePathErrorKey: path}];
+}
+
+
+
+#pragma mark - Download segment
+
+@interface BBHTTPDownloadSegment : NSObject
+
+- (instancetype)initWithStart:(unsigned long long)start end:(unsigned long long)end;
+
+@property(assign, nonatomic, readonly) unsigned long long start;
+// Exclusive; may shrink when part of the segment is handed to another connection
+@property(assign, nonatomic) unsigned long long end;
+// Offset up to which bytes have been handed out to the writer
+@property(assign, nonatomic) unsigned long long claimed;
+// Offset up to which bytes are on disk; retries resume from here
+@property(assign, nonatomic) unsigned long long written;
+@property(assign, nonatomic) NSUInteger failures;
+@property(assign, nonatomic, getter = isProbe) BOOL probe;
+@property(strong, nonatomic) BBHTTPRequest* request;
+
+- (unsigned long long)unclaimedBytes;
+- (BOOL)isComplete;
+
+@end
+
+@implementation BBHTTPDownloadSegment
+
+- (instancetype)initWithStart:(unsigned long long)start end:(unsigned long long)end
+{
+    self = [super init];
+    if (self != nil) {
+        _start = start;
+        _end = end;
+        _claimed = start;
+        _written = start;
+    }
+
+    return self;
+}
+
+- (unsigned long long)unclaimedBytes
+{
+    return (_end == kBBHTTPSegmentUnknownEnd) ? 0 : (_end - _claimed);
+}
+
+- (BOOL)isComplete
+{
+    return (_end != kBBHTTPSegmentUnknownEnd) && (_written >= _end);
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"Segment{%llu-%llu, written: %llu}", _start, _end, _written];
+}
+
+@end
+
+
+
+#pragma mark - Private interface
+
+@interface BBHTTPSegmentedDownload ()
+
+- (int)segment:(BBHTTPDownloadSegment*)segment acceptResponse:(NSUInteger)statusCode message:(NSString*)message
+       headers:(NSDictionary*)headers error:(NSError**)error;
+- (NSUInteger)segment:(BBHTTPDownloadSegment*)segment claimBytes:(NSUInteger)length
+             atOffset:(unsigned long long*)offset;
+- (void)segment:(BBHTTPDownloadSegment*)segment didWriteBytes:(NSUInteger)length;
+
+@end
+
+
+
+#pragma mark - Segment writer
+
+/**
+ Content handler for a single segment; writes the bytes it's allowed to claim straight to their offset in the file.
+ */
+@interface BBHTTPSegmentWriter : NSObject <BBHTTPContentHandler>
+
+- (instancetype)initWithDownload:(BBHTTPSegmentedDownload*)download segment:(BBHTTPDownloadSegment*)segment;
+
+@end
+
+@implementation BBHTTPSegmentWriter
+{
+    __weak BBHTTPSegmentedDownload* _download;
+    __weak BBHTTPRequest* _request;
+    BBHTTPDownloadSegment* _segment;
+    int _fd;
+}
+
+- (instancetype)initWithDownload:(BBHTTPSegmentedDownload*)download segment:(BBHTTPDownloadSegment*)segment
+{
+    self = [super init];
+    if (self != nil) {
+        _download = download;
+        _segment = segment;
+        _fd = -1;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self closeFile];
+}
+
+- (void)willExecuteRequest:(BBHTTPRequest*)request
+{
+    _request = request;
+}
+
+- (BOOL)prepareForResponse:(NSUInteger)statusCode message:(NSString*)message headers:(NSDictionary*)headers
+                      error:(NSError**)error
+{
+    [self closeFile];
+
+    // Each writer gets its own descriptor, so the download can close its own without pulling the rug from under us
+    _fd = [_download segment:_segment acceptResponse:statusCode message:message headers:headers error:error];
+
+    return _fd >= 0;
+}
+
+- (NSInteger)appendResponseBytes:(uint8_t*)bytes withLength:(NSUInteger)length error:(NSError**)error
+{
+    unsigned long long offset = 0;
+    NSUInteger claimed = [_download segment:_segment claimBytes:length atOffset:&offset];
+
+    NSUInteger written = 0;
+    while (written < claimed) {
+        ssize_t result = pwrite(_fd, bytes + written, claimed - written, (off_t)(offset + written));
+        if (result >= 0) {
+            written += (NSUInteger)result;
+        } else if (errno != EINTR) {
+            if (error != NULL) *error = BBHTTPSegmentedDownloadPOSIXError(errno, [_download pathToFile]);
+            break;
+        }
+    }
+
+    [_download segment:_segment didWriteBytes:written];
+    if (written < claimed) return -1;
+
+    // Anything past the end of the segment now belongs to another segment (or the download is over)
+    if (claimed < length) [_request cancel];
+
+    return length;
+}
+
+- (id)parseContent:(NSError**)error
+{
+    [self closeFile];
+
+    // Nothing to return, the download itself is the result
+    return nil;
+}
+
+- (void)cleanup
+{
+    [self closeFile];
+}
+
+- (void)closeFile
+{
+    if (_fd < 0) return;
+
+    close(_fd);
+    _fd = -1;
+}
+
+@end
+
+
+
+#pragma mark -
+
+@implementation BBHTTPSegmentedDownload
+{
+    dispatch_queue_t _synchronizationQueue;
+    NSMutableArray* _activeSegments;
+    NSMutableArray* _pendingSegments;
+    NSString* _validator;
+    int _fd;
+    BOOL _ownsFile; // Whether the file at the target path was created (or truncated) by this download
+}
+
+
+#pragma mark Creation
+
+- (instancetype)initWithURL:(NSURL*)url targetFile:(NSString*)pathToFile
+{
+    BBHTTPEnsureNotNil(url);
+    BBHTTPEnsureNotNil(pathToFile);
+
+    self = [super init];
+    if (self != nil) {
+        _url = [url copy];
+        _pathToFile = [pathToFile copy];
+        _executor = [BBHTTPExecutor sharedExecutor];
+        _maxSegments = 4;
+        _minSegmentSize = 1024 * 1024;
+        _maxRetriesPerSegment = 2;
+        _callbackQueue = dispatch_get_main_queue();
+
+        _activeSegments = [NSMutableArray array];
+        _pendingSegments = [NSMutableArray array];
+        _fd = -1;
+
+        _synchronizationQueue = dispatch_queue_create("com.biasedbit.HTTPSegmentedDownloadSyncQueue",
+                                                      DISPATCH_QUEUE_SERIAL);
+    }
+
+    return self;
+}
+
+- (instancetype)init
+{
+    NSAssert(NO, @"please use initWithURL:targetFile: instead");
+    return nil;
+}
+
+
+#pragma mark Destruction
+
+- (void)dealloc
+{
+    if (_fd >= 0) close(_fd);
+
+#if !OS_OBJECT_USE_OBJC
+    dispatch_release(_synchronizationQueue);
+#endif
+}
+
+
+#pragma mark Configuring behavior
+
+- (void)setMaxSegments:(NSUInteger)maxSegments
+{
+    NSParameterAssert(maxSegments >= 1);
+    _maxSegments = maxSegments;
+}
+
+
+#pragma mark Executing the download
+
+- (BOOL)start
+{
+    __block BOOL started = NO;
+    dispatch_sync(_synchronizationQueue, ^{
+        if (_started) return;
+
+        // The first request is open-ended; it doubles as the probe for range support and size
+        BBHTTPDownloadSegment* probe = [[BBHTTPDownloadSegment alloc] initWithStart:0 end:kBBHTTPSegmentUnknownEnd];
+        probe.probe = YES;
+
+        started = [self executeSegment:probe];
+        _started = started;
+    });
+
+    return started;
+}
+
+- (BOOL)cancel
+{
+    __block BOOL cancelled = NO;
+    dispatch_sync(_synchronizationQueue, ^{
+        if (_finished) return;
+
+        _cancelled = YES;
+        [self finishWithError:nil];
+        cancelled = YES;
+    });
+
+    return cancelled;
+}
+
+
+#pragma mark Segment events (writer threads)
+
+- (int)segment:(BBHTTPDownloadSegment*)segment acceptResponse:(NSUInteger)statusCode message:(NSString*)message
+       headers:(NSDictionary*)headers error:(NSError**)error
+{
+    __block int fd = -1;
+    __block NSError* failure = nil;
+    dispatch_sync(_synchronizationQueue, ^{
+        if (_finished) {
+            failure = BBHTTPError(BBHTTPErrorCodeCancelled, @"Download already finished.");
+            return;
+        }
+
+        failure = [segment isProbe] ?
+                  [self acceptProbeResponse:statusCode message:message headers:headers segment:segment] :
+                  [self acceptResponse:statusCode message:message headers:headers segment:segment];
+        if (failure != nil) return;
+
+        fd = dup(_fd);
+        if (fd < 0) failure = BBHTTPSegmentedDownloadPOSIXError(errno, _pathToFile);
+    });
+
+    if ((failure != nil) && (error != NULL)) *error = failure;
+
+    return fd;
+}
+
+- (NSUInteger)segment:(BBHTTPDownloadSegment*)segment claimBytes:(NSUInteger)length
+             atOffset:(unsigned long long*)offset
+{
+    __block NSUInteger claimed = 0;
+    dispatch_sync(_synchronizationQueue, ^{
+        if (_finished) return;
+
+        *offset = segment.claimed;
+        claimed = (NSUInteger)MIN((unsigned long long)length, segment.end - segment.claimed);
+        segment.claimed += claimed;
+    });
+
+    return claimed;
+}
+
+- (void)segment:(BBHTTPDownloadSegment*)segment didWriteBytes:(NSUInteger)length
+{
+    if (length == 0) return;
+
+    dispatch_sync(_synchronizationQueue, ^{
+        if (_finished) return;
+
+        segment.written += length;
+        _downloadedBytes += length;
+        [self notifyProgress];
+
+        if ([segment isComplete]) [self segmentCompleted:segment];
+    });
+}
+
+
+#pragma mark Segment events (synchronization queue)
+
+- (void)segment:(BBHTTPDownloadSegment*)segment finishedWithRequest:(BBHTTPRequest*)request
+{
+    // Completed segments were already dealt with as their last byte was written
+    if (_finished || ![_activeSegments containsObject:segment]) return;
+
+    [_activeSegments removeObject:segment];
+    segment.request = nil;
+
+    // Size unknown upfront, so a clean end of the transfer is the only way to tell the download is complete
+    if ((segment.end == kBBHTTPSegmentUnknownEnd) && [request hasSuccessfulResponse]) {
+        _fileSize = _downloadedBytes;
+        [self finishWithError:nil];
+        return;
+    }
+
+    NSError* error = request.error;
+    if (error == nil) {
+        error = BBHTTPErrorWithFormat(BBHTTPErrorCodeDownloadIntegrityCheckFailed,
+                                      @"Transfer ended prematurely at byte %llu", segment.written);
+    }
+
+    // Without range support there's no picking up where the request left off
+    if (!_segmented || (segment.failures >= _maxRetriesPerSegment)) {
+        [self finishWithError:error];
+        return;
+    }
+
+    segment.failures++;
+    BBHTTPLogDebug(@"[%@] %@ failed (%@), retrying (%lu/%lu).", self, segment, [error localizedDescription],
+                   (unsigned long)segment.failures, (unsigned long)_maxRetriesPerSegment);
+
+    [_pendingSegments insertObject:segment atIndex:0];
+    [self executePendingSegments];
+}
+
+- (void)segmentCompleted:(BBHTTPDownloadSegment*)segment
+{
+    BBHTTPLogTrace(@"[%@] %@ completed.", self, segment);
+
+    // Its request may still be winding down; there's no need to wait for it
+    [_activeSegments removeObject:segment];
+    segment.request = nil;
+
+    if ((_fileSize > 0) && (_downloadedBytes >= _fileSize)) {
+        [self finishWithError:nil];
+    } else {
+        [self executePendingSegments];
+    }
+}
+
+
+#pragma mark Private helpers
+
+- (NSError*)acceptProbeResponse:(NSUInteger)statusCode message:(NSString*)message headers:(NSDictionary*)headers
+                        segment:(BBHTTPDownloadSegment*)segment
+{
+    BOOL partial = NO;
+    if (statusCode == 206) {
+        unsigned long long first = 0;
+        unsigned long long total = 0;
+        if (!BBHTTPParseContentRange(headers[H(ContentRange)], &first, NULL, &total) || (first != 0) ||
+            (total == 0)) {
+            return BBHTTPErrorWithFormat(BBHTTPErrorCodeDownloadIntegrityCheckFailed,
+                                         @"Unexpected partial content range: %@", headers[H(ContentRange)]);
+        }
+
+        partial = YES;
+        _fileSize = total;
+    } else if (statusCode == 200) {
+        _fileSize = (unsigned long long)[headers[H(ContentLength)] longLongValue]; // 0 when unknown
+    } else {
+        return BBHTTPErrorWithFormat(statusCode, @"Unnacceptable response: %lu %@", (unsigned long)statusCode, message);
+    }
+
+    NSError* error = [self openFile];
+    if (error != nil) return error;
+
+    // Without a validator, segments could end up stitching together different versions of the resource
+    _validator = partial ? [self validatorFromHeaders:headers] : nil;
+    _segmented = (_validator != nil);
+
+    segment.probe = NO;
+    segment.end = (_fileSize > 0) ? _fileSize : kBBHTTPSegmentUnknownEnd;
+    if (_segmented) [self splitProbeSegment:segment];
+
+    BBHTTPLogDebug(@"[%@] Downloading %llub in %lu segment(s).", self, _fileSize,
+                   (unsigned long)([_activeSegments count] + [_pendingSegments count]));
+
+    return nil;
+}
+
+- (NSError*)acceptResponse:(NSUInteger)statusCode message:(NSString*)message headers:(NSDictionary*)headers
+                   segment:(BBHTTPDownloadSegment*)segment
+{
+    if ((statusCode != 200) && (statusCode != 206)) {
+        // Possibly transient, let the retry logic deal with it
+        return BBHTTPErrorWithFormat(statusCode, @"Unnacceptable response: %lu %@", (unsigned long)statusCode, message);
+    }
+
+    unsigned long long first = 0;
+    unsigned long long total = 0;
+    if ((statusCode == 206) && BBHTTPParseContentRange(headers[H(ContentRange)], &first, NULL, &total) &&
+        (first == segment.written) && (total == _fileSize)) return nil;
+
+    // A full response means If-Range failed, i.e. the resource changed; there's no point in retrying either way
+    NSError* error = BBHTTPErrorWithFormat(BBHTTPErrorCodeDownloadIntegrityCheckFailed,
+                                           @"Resource changed during download (%lu, Content-Range: %@)",
+                                           (unsigned long)statusCode, headers[H(ContentRange)]);
+    [self finishWithError:error];
+
+    return error;
+}
+
+- (NSString*)validatorFromHeaders:(NSDictionary*)headers
+{
+    // Weak entity tags can't be used with If-Range
+    NSString* entityTag = headers[H(ETag)];
+    if ((entityTag != nil) && ![entityTag hasPrefix:@"W/"]) return entityTag;
+
+    return headers[H(LastModified)];
+}
+
+- (void)splitProbeSegment:(BBHTTPDownloadSegment*)probe
+{
+    unsigned long long count = MIN((unsigned long long)_maxSegments, MAX(_fileSize / _minSegmentSize, 1ULL));
+    unsigned long long segmentSize = _fileSize / count;
+
+    // The probe keeps the first range; its request simply stops once it reaches the end of it
+    probe.end = segmentSize;
+    for (unsigned long long i = 1; i < count; i++) {
+        unsigned long long start = i * segmentSize;
+        unsigned long long end = (i == (count - 1)) ? _fileSize : (start + segmentSize);
+        [_pendingSegments addObject:[[BBHTTPDownloadSegment alloc] initWithStart:start end:end]];
+    }
+
+    [self executePendingSegments];
+}
+
+- (BBHTTPDownloadSegment*)stealFromLargestSegment
+{
+    if (!_segmented) return nil;
+
+    BBHTTPDownloadSegment* victim = nil;
+    for (BBHTTPDownloadSegment* segment in _activeSegments) {
+        if ([segment unclaimedBytes] > [victim unclaimedBytes]) victim = segment;
+    }
+
+    if ((victim == nil) || ([victim unclaimedBytes] < (2 * _minSegmentSize))) return nil;
+
+    // Take the second half of whatever the victim hasn't received yet; its writer stops at the new end
+    unsigned long long middle = victim.claimed + ([victim unclaimedBytes] / 2);
+    BBHTTPDownloadSegment* stolen = [[BBHTTPDownloadSegment alloc] initWithStart:middle end:victim.end];
+    victim.end = middle;
+
+    BBHTTPLogTrace(@"[%@] Split %@ off %@.", self, stolen, victim);
+
+    return stolen;
+}
+
+- (void)executePendingSegments
+{
+    while ([_activeSegments count] < _maxSegments) {
+        if ([_pendingSegments count] == 0) {
+            BBHTTPDownloadSegment* stolen = [self stealFromLargestSegment];
+            if (stolen == nil) break;
+
+            [_pendingSegments addObject:stolen];
+        }
+
+        // If the executor won't take it now, try again when the next segment finishes
+        if (![self executeSegment:_pendingSegments[0]]) break;
+        [_pendingSegments removeObjectAtIndex:0];
+    }
+
+    if (([_activeSegments count] == 0) && ([_pendingSegments count] > 0)) {
+        [self finishWithError:BBHTTPError(BBHTTPErrorCodeSegmentedDownloadFailed,
+                                          @"Executor rejected the requests for the remaining segments.")];
+    }
+}
+
+- (BOOL)executeSegment:(BBHTTPDownloadSegment*)segment
+{
+    segment.claimed = segment.written;
+
+    BBHTTPRequest* request = [[BBHTTPRequest alloc] initWithURL:_url andVerb:@"GET"];
+    request.dontAcceptCompressedContent = YES; // Ranges refer to the encoded representation
+    request.callbackQueue = _synchronizationQueue;
+    request.responseContentHandler = [[BBHTTPSegmentWriter alloc] initWithDownload:self segment:segment];
+
+    NSString* range = (segment.end == kBBHTTPSegmentUnknownEnd) ?
+                      [NSString stringWithFormat:@"bytes=%llu-", segment.written] :
+                      [NSString stringWithFormat:@"bytes=%llu-%llu", segment.written, segment.end - 1];
+    [request setValue:range forHeader:H(Range)];
+    if (_validator != nil) [request setValue:_validator forHeader:H(IfRange)];
+
+    if (_requestSetupBlock != nil) _requestSetupBlock(request);
+
+    request.finishBlock = ^(BBHTTPRequest* finishedRequest) {
+        [self segment:segment finishedWithRequest:finishedRequest];
+    };
+
+    segment.request = request;
+    [_activeSegments addObject:segment];
+    if ([_executor executeRequest:request]) return YES;
+
+    [_activeSegments removeObject:segment];
+    segment.request = nil;
+
+    return NO;
+}
+
+- (NSError*)openFile
+{
+    _fd = open([_pathToFile fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0) return BBHTTPSegmentedDownloadPOSIXError(errno, _pathToFile);
+    _ownsFile = YES;
+
+    if (_fileSize == 0) return nil;
+
+    // No point in starting a download that won't fit
+    int failure = BBHTTPPreallocateFile(_fd, 0, _fileSize);
+    if (failure == ENOSPC) return BBHTTPSegmentedDownloadPOSIXError(failure, _pathToFile);
+
+    // Size the file upfront so segments can be written anywhere in it, in any order
+    if (ftruncate(_fd, (off_t)_fileSize) != 0) return BBHTTPSegmentedDownloadPOSIXError(errno, _pathToFile);
+
+    return nil;
+}
+
+- (void)notifyProgress
+{
+    void (^progress)(unsigned long long, unsigned long long) = _downloadProgressBlock;
+    if (progress == nil) return;
+
+    unsigned long long current = _downloadedBytes;
+    unsigned long long total = _fileSize;
+    dispatch_async(_callbackQueue, ^{
+        progress(current, total);
+    });
+}
+
+- (void)finishWithError:(NSError*)error
+{
+    if (_finished) return;
+
+    _finished = YES;
+    _error = error;
+
+    // Requests still running are either failing or winding down past the end of their segments
+    for (BBHTTPDownloadSegment* segment in _activeSegments) [segment.request cancel];
+    [_activeSegments removeAllObjects];
+    [_pendingSegments removeAllObjects];
+
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+
+    if ((error != nil) || _cancelled) {
+        // Whatever was at the target path before the download got to it is left alone
+        if (_ownsFile) [[NSFileManager defaultManager] removeItemAtPath:_pathToFile error:nil];
+        BBHTTPLogInfo(@"[%@] Download %@.", self, _cancelled ? @"cancelled" : [error localizedDescription]);
+    } else {
+        BBHTTPLogInfo(@"[%@] Download finished (%llub).", self, _downloadedBytes);
+    }
+
+    void (^finish)(BBHTTPSegmentedDownload*) = _finishBlock;
+    _finishBlock = nil;
+    _downloadProgressBlock = nil;
+    _requestSetupBlock = nil;
+
+    if (finish != nil) {
+        dispatch_async(_callbackQueue, ^{
+            finish(self);
+        });
+    }
+}
+
+
+#pragma mark Debug
+
+- (NSString*)description
+{
+    NSString* url = [_url absoluteString];
+    NSString* trimmedUrl = [url length] > 40 ? [[url substringToIndex:37] stringByAppendingString:@"…"] : url;
+
+    return [NSString stringWithFormat:@"%@{%@}", NSStringFromClass([self class]), trimmedUrl];
+}
+
+@end
@@ -0,0 +1,124 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#pragma mark -
+
+/**
+ The `BBHTTPUploadBody` class describes a request body made of an ordered list of segments &mdash; in-memory data,
+ files, ranges of files and streams &mdash; that are sent one after the other, as if they had been concatenated.
+
+ Nothing is actually concatenated: as the request is sent, each segment is read straight into the transfer buffers, so
+ a small header and trailer can wrap a large payload (or a slice of a large file) without copying it into a single
+ `NSData` first. File segments are read in the same way as uploads set with `<[BBHTTPRequest setUploadFile:error:]>`.
+
+ When the size of every segment is known, so is the `<size>` of the body, and the request is sent with a
+ `Content-Length` header rather than chunked transfer encoding.
+
+ Use it with `<[BBHTTPRequest setUploadBody:withContentType:]>`:
+
+    BBHTTPUploadBody* body = [[BBHTTPUploadBody alloc] init];
+    [body addData:header];
+    [body addFile:path offset:chunkStart length:chunkLength error:nil];
+    [body addData:trailer];
+    [request setUploadBody:body withContentType:@"application/octet-stream"];
+
+ @warning Stream segments can only be read once.
+ */
+@interface BBHTTPUploadBody : NSObject <NSCopying>
+
+
+#pragma mark Adding segments
+
+///----------------------
+/// @name Adding segments
+///----------------------
+
+/**
+ Appends in-memory data; the data is retained, not copied.
+
+ @param data The data to append.
+ */
+- (void)addData:(NSData*)data;
+
+/**
+ Appends the whole contents of a file.
+
+ @param path Path to the file.
+ @param error If the file can't be read, the cause.
+
+ @return `YES` if the file was added, `NO` if it can't be read.
+ */
+- (BOOL)addFile:(NSString*)path error:(NSError**)error;
+
+/**
+ Appends a range of a file.
+
+ @param path Path to the file.
+ @param offset Offset of the first byte of the range.
+ @param length Length of the range.
+ @param error If the file can't be read or is too short to cover the range, the cause.
+
+ @return `YES` if the range was added, `NO` otherwise.
+ */
+- (BOOL)addFile:(NSString*)path offset:(unsigned long long)offset length:(unsigned long long)length
+          error:(NSError**)error;
+
+/**
+ Appends the contents of a stream.
+
+ A stream that ends before providing *size* bytes fails the upload; any bytes past *size* are ignored.
+
+ @param stream The stream to read from; it's opened and closed as the body is sent.
+ @param size The number of bytes the stream will provide; pass `0` if unknown, in which case the body is sent with
+ chunked transfer encoding.
+ */
+- (void)addStream:(NSInputStream*)stream ofSize:(unsigned long long)size;
+
+
+#pragma mark Querying the body
+
+///------------------------
+/// @name Querying the body
+///------------------------
+
+/** Number of segments in the body. */
+@property(assign, nonatomic, readonly) NSUInteger segmentCount;
+
+/** Exact size of the body, in bytes, or `0` if there's a stream segment of unknown size. */
+@property(assign, nonatomic, readonly) unsigned long long size;
+
+/**
+ Whether the body can be produced more than once, i.e. it has no stream segments.
+
+ Requests rewind and replay these bodies by creating a new `<bodyStream>`, without having to spool them.
+ */
+@property(assign, nonatomic, readonly, getter = isReplayable) BOOL replayable;
+
+/**
+ Creates a stream that produces the body, reading each segment as it goes.
+
+ Every call returns a new stream, starting from the first segment.
+
+ @return A new input stream over the body.
+ */
+- (NSInputStream*)bodyStream;
+
+@end
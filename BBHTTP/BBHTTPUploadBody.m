@@ -0,0 +1,384 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPUploadBody.h"
+
+#import "BBHTTPFileUploadSource.h"
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark - Body segment
+
+// A contiguous piece of the body: in-memory data, a range of a file or a stream
+@interface BBHTTPUploadSegment : NSObject
+
+@property(strong, nonatomic) NSData* data;
+@property(copy, nonatomic) NSString* path;
+@property(assign, nonatomic) unsigned long long offset; // Within the file
+@property(strong, nonatomic) NSInputStream* stream;
+// 0 for streams of unknown size
+@property(assign, nonatomic) unsigned long long size;
+
+@end
+
+@implementation BBHTTPUploadSegment
+@end
+
+
+
+#pragma mark - Body stream
+
+/**
+ Input stream that produces the body by reading its segments one after the other, directly into the caller's buffer.
+
+ Reads only come up short at the end of the body, which is what `<BBHTTPRequestContext>` expects from upload streams.
+ */
+@interface BBHTTPUploadBodyStream : NSInputStream
+
+- (instancetype)initWithSegments:(NSArray*)segments;
+
+@end
+
+@implementation BBHTTPUploadBodyStream
+{
+    NSArray* _segments;
+    NSUInteger _index;
+    unsigned long long _segmentOffset;
+    BBHTTPFileUploadSource* _fileSource;
+    BOOL _segmentStreamOpen;
+    NSStreamStatus _status;
+    NSError* _error;
+    __weak id<NSStreamDelegate> _delegate;
+}
+
+- (instancetype)initWithSegments:(NSArray*)segments
+{
+    self = [super init];
+    if (self != nil) {
+        _segments = segments;
+        _status = NSStreamStatusNotOpen;
+    }
+
+    return self;
+}
+
+
+#pragma mark NSStream
+
+- (void)open
+{
+    if (_status == NSStreamStatusNotOpen) _status = NSStreamStatusOpen;
+}
+
+- (void)close
+{
+    [self closeSegment];
+    _status = NSStreamStatusClosed;
+}
+
+- (NSStreamStatus)streamStatus
+{
+    return _status;
+}
+
+- (NSError*)streamError
+{
+    return _error;
+}
+
+- (id<NSStreamDelegate>)delegate
+{
+    return _delegate;
+}
+
+- (void)setDelegate:(id<NSStreamDelegate>)delegate
+{
+    _delegate = delegate;
+}
+
+- (id)propertyForKey:(NSString*)key
+{
+    return nil;
+}
+
+- (BOOL)setProperty:(id)property forKey:(NSString*)key
+{
+    return NO;
+}
+
+- (void)scheduleInRunLoop:(NSRunLoop*)runLoop forMode:(NSString*)mode
+{
+    // Only meant for synchronous reads
+}
+
+- (void)removeFromRunLoop:(NSRunLoop*)runLoop forMode:(NSString*)mode
+{
+}
+
+
+#pragma mark NSInputStream
+
+- (NSInteger)read:(uint8_t*)buffer maxLength:(NSUInteger)length
+{
+    if (_status == NSStreamStatusAtEnd) return 0;
+    if ((_status != NSStreamStatusOpen) && (_status != NSStreamStatusReading)) return -1;
+
+    _status = NSStreamStatusReading;
+
+    NSUInteger total = 0;
+    while ((total < length) && (_index < [_segments count])) {
+        NSInteger read = [self readSegment:_segments[_index] intoBuffer:(buffer + total) maxLength:(length - total)];
+        if (read < 0) {
+            [self closeSegment];
+            _status = NSStreamStatusError;
+            return -1;
+        }
+
+        if (read == 0) {
+            [self closeSegment];
+            _index++;
+            _segmentOffset = 0;
+        } else {
+            total += read;
+            _segmentOffset += read;
+        }
+    }
+
+    _status = (_index < [_segments count]) ? NSStreamStatusOpen : NSStreamStatusAtEnd;
+    return total;
+}
+
+- (BOOL)getBuffer:(uint8_t**)buffer length:(NSUInteger*)length
+{
+    return NO;
+}
+
+- (BOOL)hasBytesAvailable
+{
+    return _index < [_segments count];
+}
+
+
+#pragma mark Private helpers
+
+- (NSInteger)readSegment:(BBHTTPUploadSegment*)segment intoBuffer:(uint8_t*)buffer maxLength:(NSUInteger)length
+{
+    if (segment.data != nil) {
+        NSUInteger offset = (NSUInteger)_segmentOffset;
+        NSUInteger available = MIN([segment.data length] - offset, length);
+        [segment.data getBytes:buffer range:NSMakeRange(offset, available)];
+        return available;
+    }
+
+    if (segment.path != nil) {
+        if (_fileSource == nil) {
+            // Fails if the file has shrunk since it was added; the body's Content-Length counts on the full range
+            NSError* error = nil;
+            _fileSource = [[BBHTTPFileUploadSource alloc] initWithPath:segment.path offset:segment.offset
+                                                                length:segment.size error:&error];
+            if (_fileSource == nil) {
+                _error = error;
+                return -1;
+            }
+        }
+
+        NSInteger read = [_fileSource read:buffer maxLength:length];
+        if (read < 0) _error = _fileSource.error;
+        return read;
+    }
+
+    if (!_segmentStreamOpen) {
+        [segment.stream open];
+        _segmentStreamOpen = YES;
+    }
+
+    if (segment.size > 0) {
+        if (_segmentOffset >= segment.size) return 0;
+        length = (NSUInteger)MIN((unsigned long long)length, segment.size - _segmentOffset);
+    }
+
+    NSInteger read = [segment.stream read:buffer maxLength:length];
+    if (read < 0) {
+        _error = [segment.stream streamError];
+        if (_error == nil) _error = BBHTTPError(BBHTTPErrorCodeUploadDataStreamError, @"Couldn't read upload segment.");
+    } else if ((read == 0) && (segment.size > 0)) {
+        _error = BBHTTPErrorWithReason(BBHTTPErrorCodeUploadDataStreamError, @"Couldn't read upload segment.",
+                                       @"Stream ended before providing its declared size.");
+        return -1;
+    }
+
+    return read;
+}
+
+- (void)closeSegment
+{
+    if (_fileSource != nil) [_fileSource close];
+    _fileSource = nil;
+
+    if (_segmentStreamOpen) [[_segments[_index] stream] close];
+    _segmentStreamOpen = NO;
+}
+
+@end
+
+
+
+#pragma mark -
+
+@implementation BBHTTPUploadBody
+{
+    NSMutableArray* _segments;
+    unsigned long long _length;
+    BOOL _sizeUnknown;
+    BOOL _hasStreams;
+}
+
+
+#pragma mark Creating a body
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self != nil) {
+        _segments = [NSMutableArray array];
+    }
+
+    return self;
+}
+
+
+#pragma mark Adding segments
+
+- (void)addData:(NSData*)data
+{
+    BBHTTPEnsureNotNil(data);
+
+    if ([data length] == 0) return;
+
+    BBHTTPUploadSegment* segment = [[BBHTTPUploadSegment alloc] init];
+    segment.data = data;
+    segment.size = [data length];
+    [self addSegment:segment];
+}
+
+- (BOOL)addFile:(NSString*)path error:(NSError**)error
+{
+    return [self addFile:path offset:0 length:ULLONG_MAX error:error];
+}
+
+- (BOOL)addFile:(NSString*)path offset:(unsigned long long)offset length:(unsigned long long)length
+          error:(NSError**)error
+{
+    BBHTTPEnsureNotNil(path);
+
+    NSError* err = nil;
+    NSDictionary* attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:path error:&err];
+    if (err != nil) {
+        if (error != NULL) *error = err;
+        BBHTTPLogError(@"Can't read file attributes: %@", [err localizedDescription]);
+        return NO;
+    }
+
+    unsigned long long fileSize = [attributes fileSize];
+    if (length == ULLONG_MAX) length = (offset < fileSize) ? (fileSize - offset) : 0;
+    if ((offset > fileSize) || (length > (fileSize - offset))) {
+        BBHTTPLogError(@"Range %llu-%llu is past the end of the file (%llu bytes)", offset, offset + length, fileSize);
+        if (error != NULL) {
+            *error = BBHTTPErrorWithFormat(BBHTTPErrorCodeUploadFileStreamError,
+                                           @"Range %llu-%llu is past the end of the file (%llu bytes).",
+                                           offset, offset + length, fileSize);
+        }
+        return NO;
+    }
+
+    if (length == 0) return YES;
+
+    BBHTTPUploadSegment* segment = [[BBHTTPUploadSegment alloc] init];
+    segment.path = path;
+    segment.offset = offset;
+    segment.size = length;
+    [self addSegment:segment];
+
+    return YES;
+}
+
+- (void)addStream:(NSInputStream*)stream ofSize:(unsigned long long)size
+{
+    BBHTTPEnsureNotNil(stream);
+
+    BBHTTPUploadSegment* segment = [[BBHTTPUploadSegment alloc] init];
+    segment.stream = stream;
+    segment.size = size;
+    [self addSegment:segment];
+
+    _hasStreams = YES;
+    if (size == 0) _sizeUnknown = YES;
+}
+
+
+#pragma mark Querying the body
+
+- (NSUInteger)segmentCount
+{
+    return [_segments count];
+}
+
+- (unsigned long long)size
+{
+    return _sizeUnknown ? 0 : _length;
+}
+
+- (BOOL)isReplayable
+{
+    return !_hasStreams;
+}
+
+- (NSInputStream*)bodyStream
+{
+    return [[BBHTTPUploadBodyStream alloc] initWithSegments:[_segments copy]];
+}
+
+
+#pragma mark NSCopying
+
+- (id)copyWithZone:(NSZone*)zone
+{
+    // Segments are never modified once added, so they can be shared
+    BBHTTPUploadBody* copy = [[BBHTTPUploadBody allocWithZone:zone] init];
+    [copy->_segments addObjectsFromArray:_segments];
+    copy->_length = _length;
+    copy->_sizeUnknown = _sizeUnknown;
+    copy->_hasStreams = _hasStreams;
+
+    return copy;
+}
+
+
+#pragma mark Private helpers
+
+- (void)addSegment:(BBHTTPUploadSegment*)segment
+{
+    [_segments addObject:segment];
+    _length += segment.size;
+}
+
+@end
@@ -27,6 +27,12 @@
 
 /**
  Convert request body to `NSData`.
+
+ Chunks are kept as they arrive and only joined once the body is complete, so while `<parseContent:>` builds the
+ final `NSData` a body received in more than one chunk takes up twice its size in memory.
+
+ Subclasses that override `<appendResponseBytes:withLength:error:>` are fed through it, as usual; the chunks are only
+ handed over as `NSData` (via `appendResponseData:error:`) when it's left alone.
  */
 @interface BBHTTPAccumulator : BBHTTPSelectiveDiscarder
 @end
@@ -27,7 +27,23 @@
 
 @implementation BBHTTPAccumulator
 {
-    NSOutputStream* _stream;
+    NSMutableArray* _chunks;
+    NSUInteger _length;
+}
+
+
+#pragma mark Introspection
+
+- (BOOL)respondsToSelector:(SEL)selector
+{
+    // Subclasses overriding appendResponseBytes:withLength:error: expect all content to go through it
+    if (selector == @selector(appendResponseData:error:)) {
+        SEL appendBytes = @selector(appendResponseBytes:withLength:error:);
+        return [[self class] instanceMethodForSelector:appendBytes] ==
+               [BBHTTPAccumulator instanceMethodForSelector:appendBytes];
+    }
+
+    return [super respondsToSelector:selector];
 }
 
 
@@ -35,31 +51,44 @@
 
 - (NSInteger)appendResponseBytes:(uint8_t*)bytes withLength:(NSUInteger)length error:(NSError**)error
 {
-    if (_stream == nil) {
-        _stream = [NSOutputStream outputStreamToMemory];
-        [_stream open];
-    }
+    if (![self appendResponseData:[NSData dataWithBytes:bytes length:length] error:error]) return -1;
 
-    NSInteger written = [_stream write:bytes maxLength:length];
-    if (written <= 0) [_stream close];
-    if ((written < 0) && (error != NULL)) *error = [_stream streamError];
+    return length;
+}
 
-    return written;
+- (BOOL)buffersResponseInMemory
+{
+    return YES;
 }
 
-- (id)parseContent:(NSError**)error
+- (BOOL)appendResponseData:(NSData*)data error:(NSError**)error
 {
-    if (_stream == nil) return nil; // No data received
+    // Chunks are kept as handed over and only joined, if need be, once the body is complete
+    if (_chunks == nil) _chunks = [NSMutableArray array];
 
-    if ([_stream streamError] != nil) {
-        if (error != NULL) *error = [_stream streamError];
-        return nil;
-    }
+    [_chunks addObject:data];
+    _length += [data length];
+
+    return YES;
+}
 
-    if ([_stream streamStatus] != NSStreamStatusClosed) [_stream close];
-    NSData* data = [_stream propertyForKey:NSStreamDataWrittenToMemoryStreamKey];
+- (id)parseContent:(NSError**)error
+{
+    if (_chunks == nil) return nil; // No data received
+
+    NSData* data;
+    if ([_chunks count] == 1) {
+        data = _chunks[0];
+    } else {
+        NSMutableData* joined = [NSMutableData dataWithCapacity:_length];
+        for (NSData* chunk in _chunks) {
+            [joined appendData:chunk];
+        }
+        data = joined;
+    }
 
-    _stream = nil;
+    _chunks = nil;
+    _length = 0;
 
     return data;
 }
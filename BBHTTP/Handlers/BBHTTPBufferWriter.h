@@ -0,0 +1,142 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPSelectiveDiscarder.h"
+
+
+
+#pragma mark -
+
+/**
+ Thread-safe pool of equally sized, reusable buffers for `<BBHTTPBufferWriter>` instances.
+
+ Buffers are allocated upfront; once the pool is warm, taking and returning buffers doesn't allocate anything.
+ */
+@interface BBHTTPBufferPool : NSObject
+
+
+#pragma mark Creating a buffer pool
+
+/**
+ Creates a new pool.
+
+ @param bufferSize Size of each buffer, in bytes.
+ @param count Number of buffers to allocate upfront.
+
+ @return An initialized `BBHTTPBufferPool`.
+ */
+- (instancetype)initWithBufferSize:(NSUInteger)bufferSize count:(NSUInteger)count;
+
+
+#pragma mark Taking and returning buffers
+
+/**
+ Takes a buffer from the pool; if the pool is empty, a new buffer is allocated.
+
+ @return A buffer, `<bufferSize>` bytes long.
+ */
+- (NSMutableData*)takeBuffer;
+
+/**
+ Returns a buffer to the pool. Buffers of the wrong size are dropped.
+
+ @param buffer Buffer to return to the pool.
+ */
+- (void)returnBuffer:(NSMutableData*)buffer;
+
+
+#pragma mark Properties
+
+@property(assign, nonatomic, readonly) NSUInteger bufferSize;
+/** Number of buffers currently available in the pool. */
+@property(assign, nonatomic, readonly) NSUInteger availableBuffers;
+
+@end
+
+
+
+#pragma mark -
+
+/**
+ Writes the response body into a fixed-size buffer supplied by the caller, meant to be reused request after request.
+
+ Suited for small responses of known maximum size (e.g. RPC responses): unlike `<BBHTTPAccumulator>`, receiving a body
+ that fits the buffer involves no allocations at all &mdash; the body is copied into the buffer and nothing else.
+
+ Bodies that don't fit either fail the request, with `BBHTTPErrorCodeResponseTooLarge` (as early as the headers, if
+ the response has a `Content-Length`), or, if `<spillsOverflow>` is set, have their excess spilled into a second,
+ growable buffer.
+
+ The body is never returned by `<parseContent:>`; read it from `<buffer>` (the first `<length>` bytes) and `<overflow>`.
+ */
+@interface BBHTTPBufferWriter : BBHTTPSelectiveDiscarder
+
+
+#pragma mark Creating a new buffer writer
+
+/**
+ Creates a new buffer writer.
+
+ @param buffer The buffer to write to; its length is the capacity of the writer.
+
+ @return An initialized `BBHTTPBufferWriter`.
+ */
+- (instancetype)initWithBuffer:(NSMutableData*)buffer;
+
+/**
+ Creates a new buffer writer that takes its buffer from a pool, as late as possible (when a response is accepted).
+
+ @param pool The pool to take a buffer from.
+
+ @return An initialized `BBHTTPBufferWriter`.
+ */
+- (instancetype)initWithBufferPool:(BBHTTPBufferPool*)pool;
+
+
+#pragma mark Configuring behavior
+
+/**
+ Spill data that doesn't fit the buffer into `<overflow>` instead of failing. Defaults to `NO`.
+
+ The buffer itself is allocated before the response arrives, so it doesn't count towards the executor's
+ `maxBufferedResponseBytes`; with this option set, the overflow has no bound, so the whole body does.
+ */
+@property(assign, nonatomic) BOOL spillsOverflow;
+
+
+#pragma mark Reading the response body
+
+/** The buffer the body is written to. */
+@property(strong, nonatomic, readonly) NSMutableData* buffer;
+/** Number of bytes of the body written to `<buffer>`. */
+@property(assign, nonatomic, readonly) NSUInteger length;
+/** The part of the body that didn't fit `<buffer>`, if `<spillsOverflow>` is set; `nil` if it all fit. */
+@property(strong, nonatomic, readonly) NSData* overflow;
+
+/**
+ Gives the buffer back to the pool the writer was created with, once the body has been consumed.
+
+ Has no effect on writers created with a buffer of their own. The writer takes a new buffer from the pool if it gets
+ used again.
+ */
+- (void)returnBufferToPool;
+
+@end
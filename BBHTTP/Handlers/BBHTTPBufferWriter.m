@@ -0,0 +1,230 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPBufferWriter.h"
+
+#import <pthread.h>
+
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark -
+
+@implementation BBHTTPBufferPool
+{
+    pthread_mutex_t _lock;
+    NSMutableArray* _buffers;
+}
+
+
+#pragma mark Creating a buffer pool
+
+- (instancetype)initWithBufferSize:(NSUInteger)bufferSize count:(NSUInteger)count
+{
+    self = [super init];
+    if (self != nil) {
+        pthread_mutex_init(&_lock, NULL);
+        _bufferSize = bufferSize;
+        _buffers = [NSMutableArray arrayWithCapacity:count];
+        for (NSUInteger i = 0; i < count; i++) {
+            [_buffers addObject:[NSMutableData dataWithLength:bufferSize]];
+        }
+    }
+
+    return self;
+}
+
+
+#pragma mark Destruction
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_lock);
+}
+
+
+#pragma mark Taking and returning buffers
+
+- (NSMutableData*)takeBuffer
+{
+    pthread_mutex_lock(&_lock);
+    NSMutableData* buffer = [_buffers lastObject];
+    if (buffer != nil) [_buffers removeLastObject];
+    pthread_mutex_unlock(&_lock);
+
+    if (buffer == nil) {
+        BBHTTPLogDebug(@"%@ | Pool exhausted, allocating a new %lub buffer.", self, (unsigned long)_bufferSize);
+        buffer = [NSMutableData dataWithLength:_bufferSize];
+    }
+
+    return buffer;
+}
+
+- (void)returnBuffer:(NSMutableData*)buffer
+{
+    if ((buffer == nil) || ([buffer length] != _bufferSize)) return;
+
+    pthread_mutex_lock(&_lock);
+    [_buffers addObject:buffer];
+    pthread_mutex_unlock(&_lock);
+}
+
+
+#pragma mark Properties
+
+- (NSUInteger)availableBuffers
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = [_buffers count];
+    pthread_mutex_unlock(&_lock);
+
+    return count;
+}
+
+
+#pragma mark Debug
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"%@{%lub}", NSStringFromClass([self class]), (unsigned long)_bufferSize];
+}
+
+@end
+
+
+
+#pragma mark -
+
+@implementation BBHTTPBufferWriter
+{
+    BBHTTPBufferPool* _pool;
+    NSMutableData* _overflowBuffer;
+}
+
+
+#pragma mark Creating a new buffer writer
+
+- (instancetype)initWithBuffer:(NSMutableData*)buffer
+{
+    self = [super init];
+    if (self != nil) _buffer = buffer;
+
+    return self;
+}
+
+- (instancetype)initWithBufferPool:(BBHTTPBufferPool*)pool
+{
+    self = [super init];
+    if (self != nil) _pool = pool;
+
+    return self;
+}
+
+
+#pragma mark Destruction
+
+- (void)dealloc
+{
+    [self returnBufferToPool];
+}
+
+
+#pragma mark Reading the response body
+
+- (NSData*)overflow
+{
+    return _overflowBuffer;
+}
+
+- (void)returnBufferToPool
+{
+    if ((_pool == nil) || (_buffer == nil)) return;
+
+    [_pool returnBuffer:_buffer];
+    _buffer = nil;
+    _length = 0;
+}
+
+
+#pragma mark BBHTTPSelectiveDiscarder behavior overrides
+
+- (BOOL)prepareForResponse:(NSUInteger)statusCode message:(NSString*)message headers:(NSDictionary*)headers
+                      error:(NSError**)error
+{
+    if (![super prepareForResponse:statusCode message:message headers:headers error:error]) return NO;
+
+    if (_buffer == nil) _buffer = [_pool takeBuffer];
+    _length = 0;
+    _overflowBuffer = nil;
+
+    // Fail before reading anything if the body is known not to fit
+    NSString* contentLength = headers[H(ContentLength)];
+    if (!_spillsOverflow && (contentLength != nil) && ((NSUInteger)[contentLength longLongValue] > [_buffer length])) {
+        if (error != NULL) *error = [self tooLargeError];
+        return NO;
+    }
+
+    return YES;
+}
+
+- (NSInteger)appendResponseBytes:(uint8_t*)bytes withLength:(NSUInteger)length error:(NSError**)error
+{
+    NSUInteger available = [_buffer length] - _length;
+    NSUInteger fitting = MIN(length, available);
+    memcpy((uint8_t*)[_buffer mutableBytes] + _length, bytes, fitting);
+    _length += fitting;
+
+    if (fitting == length) return length;
+
+    if (!_spillsOverflow) {
+        if (error != NULL) *error = [self tooLargeError];
+        return -1;
+    }
+
+    if (_overflowBuffer == nil) _overflowBuffer = [NSMutableData dataWithCapacity:(length - fitting)];
+    [_overflowBuffer appendBytes:(bytes + fitting) length:(length - fitting)];
+
+    return length;
+}
+
+- (BOOL)buffersResponseInMemory
+{
+    // Pausing the transfer doesn't free the buffer, only the overflow can grow
+    return _spillsOverflow;
+}
+
+- (id)parseContent:(NSError**)error
+{
+    // The content is read off the writer, returning it wrapped in an object would take an allocation
+    return nil;
+}
+
+
+#pragma mark Private helpers
+
+- (NSError*)tooLargeError
+{
+    return BBHTTPErrorWithFormat(BBHTTPErrorCodeResponseTooLarge, @"Response body does not fit a %lub buffer",
+                                 (unsigned long)[_buffer length]);
+}
+
+@end
@@ -18,6 +18,9 @@
 //  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
 //  Copyright (c) 2013 BiasedBit. All rights reserved.
 //
+@class BBHTTPRequest;
+
+
 
 #pragma mark -
 
@@ -73,6 +76,61 @@
 
 @optional
 
+/**
+ Gives the handler a chance to adjust the request it's assigned to (e.g. add headers), right before it's executed.
+
+ @param request The request about to be executed.
+ */
+- (void)willExecuteRequest:(BBHTTPRequest*)request;
+
+/**
+ Feed response body data to the handler, as an immutable `NSData` the handler is free to keep.
+
+ When implemented, this method is called *instead of* `<appendResponseBytes:withLength:error:>`. Handlers that hold on
+ to the content can simply retain each chunk: decoded (e.g. gunzipped) content is handed over without any copy and raw
+ content with a single one &mdash; libcurl reuses its buffer once the write callback returns, so that one copy can't be
+ avoided.
+
+ @param data A chunk of the response body.
+ @param error On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object
+ containing the error information. You may specify nil for this parameter if you do not want the error information.
+
+ @return `YES` if the chunk was handled, `NO` to abort the download.
+ */
+- (BOOL)appendResponseData:(NSData*)data error:(NSError**)error;
+
+/**
+ Tells whether the handler can take more response bytes right now.
+
+ Handlers that hand data over to slower consumers can implement this method to apply backpressure: while it returns
+ `NO`, the transfer is paused &mdash; the connection is kept open and no more data is read from it, so the server
+ eventually stops sending &mdash; and the bytes already received are held back. The executor polls the handler
+ periodically (roughly once per second, at most) and resumes the transfer as soon as this method returns `YES`.
+
+ @return `YES` if `<appendResponseBytes:withLength:error:>` can be called, `NO` to pause the transfer.
+ */
+- (BOOL)isReadyForResponseBytes;
+
+/**
+ Tells whether the handler keeps the response body in memory.
+
+ Bodies kept in memory are accounted for against the executor's `maxBufferedResponseBytes` budget. Handlers can change
+ their answer as the body is received (e.g. when moving it to disk).
+
+ @return `YES` if the handler holds on to the body in memory, `NO` otherwise.
+ */
+- (BOOL)buffersResponseInMemory;
+
+/**
+ Tells the handler that the request failed, right before `<cleanup>` is called.
+
+ `<parseContent:>` may have already been called by then (e.g. when the connection drops mid-body), so handlers that
+ hand data over as it arrives can use this to tell a truncated body apart from a complete one.
+
+ @param error The reason why the request failed.
+ */
+- (void)requestFailedWithError:(NSError*)error;
+
 /**
  Perform additional cleanup, if needed.
  */
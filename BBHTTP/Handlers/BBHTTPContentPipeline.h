@@ -0,0 +1,130 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPContentHandler.h"
+
+
+
+#pragma mark - Types
+
+/**
+ Block through which a stage hands its output to the next stage of the pipeline. Returns `NO` if a downstream stage
+ (or the final handler) failed, in which case the stage should stop processing and return `NO` as well.
+ */
+typedef BOOL (^BBHTTPContentStageOutput)(uint8_t* bytes, NSUInteger length);
+
+
+
+#pragma mark -
+
+/**
+ Defines the interface for a stage of a `<BBHTTPContentPipeline>`.
+
+ A stage receives response bytes, processes them and passes the output on to the next stage. Stages that only observe
+ the bytes (e.g. to compute a digest or count them) should pass the input buffer along untouched, without copying it;
+ stages that transform the bytes (e.g. decrypt or decompress) can hand over their output in as many chunks as they see
+ fit.
+ */
+@protocol BBHTTPContentStage <NSObject>
+
+
+@required
+
+/**
+ Processes a chunk of response bytes.
+
+ @param bytes Array of bytes.
+ @param length Length of the byte array.
+ @param output Block that passes output bytes to the next stage.
+ @param error On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object
+ containing the error information. You may specify nil for this parameter if you do not want the error information.
+
+ @return `YES` if the bytes were processed and accepted downstream, `NO` to abort the response.
+ */
+- (BOOL)processBytes:(uint8_t*)bytes withLength:(NSUInteger)length toBlock:(BBHTTPContentStageOutput)output
+               error:(NSError**)error;
+
+
+@optional
+
+/**
+ Prepares the stage for a response; returning `NO` rejects the response.
+
+ Has the same semantics as `<[BBHTTPContentHandler prepareForResponse:message:headers:error:]>`.
+ */
+- (BOOL)prepareForResponse:(NSUInteger)statusCode message:(NSString*)message headers:(NSDictionary*)headers
+                      error:(NSError**)error;
+
+/**
+ Signals the end of the response; stages that hold back data must flush it through *output* here.
+
+ @return `YES` if the stage was successfully finalized, `NO` to fail the response.
+ */
+- (BOOL)finishToBlock:(BBHTTPContentStageOutput)output error:(NSError**)error;
+
+/**
+ Whether the stage outputs exactly as many bytes as it receives.
+
+ When any of the stages of a pipeline doesn't, the final handler is prepared without the `Content-Length` header.
+ Defaults to `NO` when not implemented.
+ */
+- (BOOL)preservesLength;
+
+/** Perform additional cleanup, if needed. */
+- (void)cleanup;
+
+@end
+
+
+
+#pragma mark -
+
+/**
+ Content handler that runs response bytes through a chain of stages before handing them to a final content handler.
+
+ Any stage can reject the response when it's being prepared or abort it while processing bytes, on its own; the final
+ handler's content is returned as the content of the response. When a stage fails, the final handler's `parseContent:`
+ isn't called; it's told about the failure through `requestFailedWithError:` instead.
+
+ Pipelines are themselves content handlers, so they can be fed by a `<BBHTTPContentTee>` or feed one.
+ */
+@interface BBHTTPContentPipeline : NSObject <BBHTTPContentHandler>
+
+
+#pragma mark Creating a new pipeline
+
+/**
+ Creates a new pipeline.
+
+ @param stages Array of `<BBHTTPContentStage>` instances, in the order the bytes go through them. May be empty.
+ @param handler The content handler that receives the output of the last stage.
+
+ @return An initialized `BBHTTPContentPipeline`.
+ */
+- (instancetype)initWithStages:(NSArray*)stages handler:(id<BBHTTPContentHandler>)handler;
+
+
+#pragma mark Properties
+
+@property(strong, nonatomic, readonly) NSArray* stages;
+@property(strong, nonatomic, readonly) id<BBHTTPContentHandler> handler;
+
+@end
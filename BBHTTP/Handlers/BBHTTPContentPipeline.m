@@ -0,0 +1,195 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPContentPipeline.h"
+
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark -
+
+@implementation BBHTTPContentPipeline
+{
+    NSArray* _stageOutputs;
+    NSError* _pipelineError;
+}
+
+
+#pragma mark Creation
+
+- (instancetype)initWithStages:(NSArray*)stages handler:(id<BBHTTPContentHandler>)handler
+{
+    BBHTTPEnsureNotNil(stages);
+    BBHTTPEnsureNotNil(handler);
+
+    self = [super init];
+    if (self != nil) {
+        _stages = [stages copy];
+        _handler = handler;
+
+        // Each stage's output block feeds the next one; created once rather than on every chunk
+        __weak BBHTTPContentPipeline* weakSelf = self;
+        NSMutableArray* outputs = [NSMutableArray arrayWithCapacity:[_stages count]];
+        for (NSUInteger i = 0; i < [_stages count]; i++) {
+            [outputs addObject:[^BOOL(uint8_t* bytes, NSUInteger length) {
+                return [weakSelf pushBytes:bytes withLength:length toStageAtIndex:(i + 1)];
+            } copy]];
+        }
+        _stageOutputs = outputs;
+    }
+
+    return self;
+}
+
+
+#pragma mark BBHTTPContentHandler
+
+- (void)willExecuteRequest:(BBHTTPRequest*)request
+{
+    if ([_handler respondsToSelector:@selector(willExecuteRequest:)]) [_handler willExecuteRequest:request];
+}
+
+- (BOOL)prepareForResponse:(NSUInteger)statusCode message:(NSString*)message headers:(NSDictionary*)headers
+                      error:(NSError**)error
+{
+    _pipelineError = nil;
+
+    BOOL preservesLength = YES;
+    for (id<BBHTTPContentStage> stage in _stages) {
+        if ([stage respondsToSelector:@selector(prepareForResponse:message:headers:error:)] &&
+            ![stage prepareForResponse:statusCode message:message headers:headers error:error]) return NO;
+
+        preservesLength = preservesLength && [stage respondsToSelector:@selector(preservesLength)] &&
+                          [stage preservesLength];
+    }
+
+    if (!preservesLength && (headers[H(ContentLength)] != nil)) {
+        NSMutableDictionary* handlerHeaders = [headers mutableCopy];
+        [handlerHeaders removeObjectForKey:H(ContentLength)];
+        headers = handlerHeaders;
+    }
+
+    return [_handler prepareForResponse:statusCode message:message headers:headers error:error];
+}
+
+- (BOOL)isReadyForResponseBytes
+{
+    return ![_handler respondsToSelector:@selector(isReadyForResponseBytes)] || [_handler isReadyForResponseBytes];
+}
+
+- (BOOL)buffersResponseInMemory
+{
+    return [_handler respondsToSelector:@selector(buffersResponseInMemory)] && [_handler buffersResponseInMemory];
+}
+
+- (NSInteger)appendResponseBytes:(uint8_t*)bytes withLength:(NSUInteger)length error:(NSError**)error
+{
+    if ([self pushBytes:bytes withLength:length toStageAtIndex:0]) return length;
+
+    if (error != NULL) *error = _pipelineError;
+    return -1;
+}
+
+- (id)parseContent:(NSError**)error
+{
+    // Let stages flush whatever they're holding back, in order, so each flush goes through the ones after it
+    for (NSUInteger i = 0; (i < [_stages count]) && (_pipelineError == nil); i++) {
+        id<BBHTTPContentStage> stage = _stages[i];
+        if (![stage respondsToSelector:@selector(finishToBlock:error:)]) continue;
+
+        NSError* stageError = nil;
+        if (![stage finishToBlock:_stageOutputs[i] error:&stageError] && (_pipelineError == nil)) {
+            _pipelineError = [self errorForStage:stage error:stageError];
+        }
+    }
+
+    // Once a stage failed, the handler must not commit its content (e.g. a file writer finishing a corrupt file); it's
+    // told about the failure through requestFailedWithError: instead
+    if (_pipelineError == nil) return [_handler parseContent:error];
+
+    if (error != NULL) *error = _pipelineError;
+    return nil;
+}
+
+- (void)requestFailedWithError:(NSError*)error
+{
+    if ([_handler respondsToSelector:@selector(requestFailedWithError:)]) [_handler requestFailedWithError:error];
+}
+
+- (void)cleanup
+{
+    for (id<BBHTTPContentStage> stage in _stages) {
+        if ([stage respondsToSelector:@selector(cleanup)]) [stage cleanup];
+    }
+
+    if ([_handler respondsToSelector:@selector(cleanup)]) [_handler cleanup];
+}
+
+
+#pragma mark Private helpers
+
+- (BOOL)pushBytes:(uint8_t*)bytes withLength:(NSUInteger)length toStageAtIndex:(NSUInteger)index
+{
+    if (length == 0) return YES;
+
+    NSError* error = nil;
+    if (index == [_stages count]) {
+        NSInteger written = [_handler appendResponseBytes:bytes withLength:length error:&error];
+        if ((error == nil) && (written == (NSInteger)length)) return YES;
+
+        if (error == nil) {
+            error = BBHTTPErrorWithReason(BBHTTPErrorCodeDownloadCannotWriteToHandler,
+                                          @"Error handling response content",
+                                          @"Response handler capacity reached before content was fully read.");
+        }
+        if (_pipelineError == nil) _pipelineError = error;
+
+        return NO;
+    }
+
+    id<BBHTTPContentStage> stage = _stages[index];
+    if ([stage processBytes:bytes withLength:length toBlock:_stageOutputs[index] error:&error]) return YES;
+
+    // A downstream failure has already been recorded, and is the actual cause
+    if (_pipelineError == nil) _pipelineError = [self errorForStage:stage error:error];
+
+    return NO;
+}
+
+- (NSError*)errorForStage:(id<BBHTTPContentStage>)stage error:(NSError*)error
+{
+    if (error != nil) return error;
+
+    return BBHTTPErrorWithFormat(BBHTTPErrorCodeDownloadCannotWriteToHandler,
+                                 @"Response content aborted by pipeline stage %@", stage);
+}
+
+
+#pragma mark Debug
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"%@{%lu stages -> %@}", NSStringFromClass([self class]),
+                                      (unsigned long)[_stages count], _handler];
+}
+
+@end
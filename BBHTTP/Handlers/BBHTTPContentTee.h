@@ -0,0 +1,86 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPContentHandler.h"
+
+
+
+#pragma mark -
+
+/**
+ Content handler that feeds the same response to several other content handlers.
+
+ Use it to, for instance, write a download to a file while also computing its digest, or parse a JSON response while
+ also archiving the raw bytes &mdash; all in a single request.
+
+ Every chunk received is handed to each handler in turn, by pointer. Handlers that keep chunks as `NSData` (those that
+ implement `appendResponseData:error:`) are the exception: the chunk is copied once into an `NSData` that all of them
+ share. Handlers must not modify the bytes they receive.
+
+ The first handler is the primary handler: its parsed content is what this handler returns as content. The content of
+ every handler is available through `<contents>` after the response is parsed.
+
+ ### Failures
+
+ By default, if any handler rejects the response (in `prepareForResponse:message:headers:error:`) or fails to handle its
+ bytes, the whole response fails with that handler's error. When `<tolerateSecondaryFailures>` is set, failing
+ secondary handlers are simply detached (and cleaned up) while the others carry on; only the primary handler can then
+ fail the response.
+ */
+@interface BBHTTPContentTee : NSObject <BBHTTPContentHandler>
+
+
+#pragma mark Creating a new tee
+
+/**
+ Creates a new tee.
+
+ @param handlers Array of `<BBHTTPContentHandler>` instances to feed the response to; the first one is the primary
+ handler. Cannot be empty.
+
+ @return An initialized `BBHTTPContentTee`.
+ */
+- (instancetype)initWithHandlers:(NSArray*)handlers;
+
+
+#pragma mark Configuring behavior
+
+/** Detach failing secondary handlers instead of failing the response. Defaults to `NO`. */
+@property(assign, nonatomic) BOOL tolerateSecondaryFailures;
+
+
+#pragma mark Properties
+
+/** The handlers the response is fed to. */
+@property(strong, nonatomic, readonly) NSArray* handlers;
+
+/**
+ Content parsed by each of the handlers, in the same order as `<handlers>`.
+
+ Handlers that returned no content (or were detached) are represented by `NSNull`. Only available after the response is
+ parsed.
+ */
+@property(strong, nonatomic, readonly) NSArray* contents;
+
+/** Errors raised by detached secondary handlers, if any. */
+@property(strong, nonatomic, readonly) NSArray* errors;
+
+@end
@@ -0,0 +1,219 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPContentTee.h"
+
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark -
+
+@implementation BBHTTPContentTee
+{
+    NSMutableArray* _activeHandlers;
+    NSMutableArray* _detachedErrors;
+}
+
+
+#pragma mark Creation
+
+- (instancetype)initWithHandlers:(NSArray*)handlers
+{
+    BBHTTPEnsureNotNil(handlers);
+    NSParameterAssert([handlers count] > 0);
+
+    self = [super init];
+    if (self != nil) {
+        _handlers = [handlers copy];
+        _activeHandlers = [NSMutableArray arrayWithArray:_handlers];
+        _detachedErrors = [NSMutableArray array];
+    }
+
+    return self;
+}
+
+
+#pragma mark BBHTTPContentHandler
+
+- (void)willExecuteRequest:(BBHTTPRequest*)request
+{
+    for (id<BBHTTPContentHandler> handler in _handlers) {
+        if ([handler respondsToSelector:@selector(willExecuteRequest:)]) [handler willExecuteRequest:request];
+    }
+}
+
+- (BOOL)prepareForResponse:(NSUInteger)statusCode message:(NSString*)message headers:(NSDictionary*)headers
+                      error:(NSError**)error
+{
+    _activeHandlers = [NSMutableArray arrayWithArray:_handlers];
+    [_detachedErrors removeAllObjects];
+    _contents = nil;
+
+    for (id<BBHTTPContentHandler> handler in _handlers) {
+        NSError* handlerError = nil;
+        if ([handler prepareForResponse:statusCode message:message headers:headers error:&handlerError]) continue;
+
+        if (![self detachHandler:handler error:handlerError]) {
+            if (error != NULL) *error = handlerError;
+            return NO;
+        }
+    }
+
+    return YES;
+}
+
+- (BOOL)isReadyForResponseBytes
+{
+    // The slowest handler sets the pace
+    for (id<BBHTTPContentHandler> handler in _activeHandlers) {
+        if ([handler respondsToSelector:@selector(isReadyForResponseBytes)] && ![handler isReadyForResponseBytes]) {
+            return NO;
+        }
+    }
+
+    return YES;
+}
+
+- (BOOL)buffersResponseInMemory
+{
+    for (id<BBHTTPContentHandler> handler in _activeHandlers) {
+        if ([handler respondsToSelector:@selector(buffersResponseInMemory)] && [handler buffersResponseInMemory]) {
+            return YES;
+        }
+    }
+
+    return NO;
+}
+
+- (NSInteger)appendResponseBytes:(uint8_t*)bytes withLength:(NSUInteger)length error:(NSError**)error
+{
+    // Handlers that keep chunks all share the same copy
+    NSData* data = nil;
+
+    // Iterate over a snapshot, handlers may be detached along the way
+    for (id<BBHTTPContentHandler> handler in [_activeHandlers copy]) {
+        NSError* handlerError = nil;
+        NSInteger written;
+        if ([handler respondsToSelector:@selector(appendResponseData:error:)]) {
+            if (data == nil) data = [NSData dataWithBytes:bytes length:length];
+            written = [handler appendResponseData:data error:&handlerError] ? (NSInteger)length : -1;
+        } else {
+            written = [handler appendResponseBytes:bytes withLength:length error:&handlerError];
+        }
+        if ((handlerError == nil) && (written == (NSInteger)length)) continue;
+
+        if (handlerError == nil) {
+            handlerError = BBHTTPErrorWithReason(BBHTTPErrorCodeDownloadCannotWriteToHandler,
+                                                 @"Error handling response content",
+                                                 @"Response handler capacity reached before content was fully read.");
+        }
+
+        if (![self detachHandler:handler error:handlerError]) {
+            if (error != NULL) *error = handlerError;
+            return -1;
+        }
+    }
+
+    return length;
+}
+
+- (id)parseContent:(NSError**)error
+{
+    NSMutableArray* contents = [NSMutableArray arrayWithCapacity:[_handlers count]];
+    NSError* failure = nil;
+
+    for (id<BBHTTPContentHandler> handler in _handlers) {
+        if (![_activeHandlers containsObject:handler]) {
+            [contents addObject:[NSNull null]];
+            continue;
+        }
+
+        // Every handler gets to parse (or finalize) its content, even if an earlier one failed
+        NSError* handlerError = nil;
+        id content = [handler parseContent:&handlerError];
+        [contents addObject:(content != nil) ? content : [NSNull null]];
+
+        if ((handlerError != nil) && ![self detachHandler:handler error:handlerError] && (failure == nil)) {
+            failure = handlerError;
+        }
+    }
+
+    _contents = contents;
+
+    if (failure != nil) {
+        if (error != NULL) *error = failure;
+        return nil;
+    }
+
+    id primaryContent = _contents[0];
+    return (primaryContent == [NSNull null]) ? nil : primaryContent;
+}
+
+- (void)requestFailedWithError:(NSError*)error
+{
+    for (id<BBHTTPContentHandler> handler in _activeHandlers) {
+        if ([handler respondsToSelector:@selector(requestFailedWithError:)]) [handler requestFailedWithError:error];
+    }
+}
+
+- (void)cleanup
+{
+    // Detached handlers have already been cleaned up
+    for (id<BBHTTPContentHandler> handler in _activeHandlers) {
+        if ([handler respondsToSelector:@selector(cleanup)]) [handler cleanup];
+    }
+}
+
+
+#pragma mark Properties
+
+- (NSArray*)errors
+{
+    return [_detachedErrors copy];
+}
+
+
+#pragma mark Private helpers
+
+- (BOOL)detachHandler:(id<BBHTTPContentHandler>)handler error:(NSError*)error
+{
+    // The primary handler can never be detached, the response fails along with it
+    if (!_tolerateSecondaryFailures || (handler == _handlers[0])) return NO;
+
+    BBHTTPLogDebug(@"[%@] Detaching %@: %@", self, handler, [error localizedDescription]);
+
+    [_activeHandlers removeObject:handler];
+    if (error != nil) [_detachedErrors addObject:error];
+    if ([handler respondsToSelector:@selector(cleanup)]) [handler cleanup];
+
+    return YES;
+}
+
+
+#pragma mark Debug
+
+- (NSString*)description
+{
+    return NSStringFromClass([self class]);
+}
+
+@end
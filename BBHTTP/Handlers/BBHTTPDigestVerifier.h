@@ -0,0 +1,116 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPContentPipeline.h"
+
+
+
+#pragma mark - Enums
+
+typedef NS_ENUM(NSUInteger, BBHTTPDigestAlgorithm) {
+    BBHTTPDigestAlgorithmMD5 = 0,
+    BBHTTPDigestAlgorithmSHA1,
+    BBHTTPDigestAlgorithmSHA256,
+    BBHTTPDigestAlgorithmCRC32C
+};
+
+
+
+#pragma mark -
+
+/**
+ Pipeline stage that computes digests of the response content as it streams through, and fails the response if they
+ don't match the expected values.
+
+ The stage passes every chunk along untouched (no copies are made), so it can be placed in front of any handler; e.g.
+ to verify a download while it's being written to disk, rather than reading the file back afterwards:
+
+     BBHTTPDigestVerifier* verifier = [[BBHTTPDigestVerifier alloc] initWithAlgorithm:BBHTTPDigestAlgorithmSHA256
+                                                                        expectedDigest:expectedSHA256];
+     BBHTTPFileWriter* writer = [[BBHTTPFileWriter alloc] initWithTargetFile:path];
+     request.responseContentHandler = [[BBHTTPContentPipeline alloc] initWithStages:@[verifier] handler:writer];
+
+ ### Expected digests
+
+ Expected digests come from two sources:
+
+ - the algorithm and digest passed to `<initWithAlgorithm:expectedDigest:>`, if any;
+ - the `Digest` (`MD5`, `SHA`, `SHA-256` and `CRC32c` values) and `Content-MD5` response headers, unless
+   `<verifyResponseHeaders>` is turned off.
+
+ Digests announced by the server describe the bytes on the wire, so they're ignored for partial (`206`) responses and
+ for responses that are transparently decoded before reaching the pipeline.
+
+ Partial responses only carry the bytes past the point a download is resumed from, so the digest passed to
+ `<initWithAlgorithm:expectedDigest:>` isn't checked (nor computed) for them either; e.g. a download resumed by a
+ `<[BBHTTPFileWriter resumable]>` writer is only verified when it's downloaded in full.
+
+ When there's a mismatch, the response fails with an error with code `BBHTTPErrorCodeDownloadIntegrityCheckFailed`.
+
+ ### Performance
+
+ MD5, SHA-1 and SHA-256 are computed with CommonCrypto, which uses the hardware acceleration available on the device.
+ CRC32C uses the SSE4.2 `crc32` instruction on Intel and the ARMv8 CRC32 extension on ARM when present, falling back
+ to a table-driven implementation.
+ */
+@interface BBHTTPDigestVerifier : NSObject <BBHTTPContentStage>
+
+
+#pragma mark Creating a new digest verifier
+
+/**
+ Creates a new verifier that checks the digests announced in the response headers.
+
+ @return An initialized `BBHTTPDigestVerifier`.
+ */
+- (instancetype)init;
+
+/**
+ Creates a new verifier for a known digest.
+
+ @param algorithm The digest algorithm.
+ @param expectedDigest The expected (binary) digest of the whole content. If `nil`, the digest is computed but not
+ verified; it can be retrieved with `<digestForAlgorithm:>` once the response is complete. Ignored for partial (`206`)
+ responses.
+
+ @return An initialized `BBHTTPDigestVerifier`.
+ */
+- (instancetype)initWithAlgorithm:(BBHTTPDigestAlgorithm)algorithm expectedDigest:(NSData*)expectedDigest;
+
+
+#pragma mark Configuring behavior
+
+/** Whether to verify the digests announced by the server (`Digest` and `Content-MD5` headers). Defaults to `YES`. */
+@property(assign, nonatomic) BOOL verifyResponseHeaders;
+
+
+#pragma mark Querying results
+
+/**
+ The digest computed for the last response.
+
+ @param algorithm The digest algorithm.
+
+ @return The binary digest (CRC32C in big-endian byte order), or `nil` if it wasn't computed.
+ */
+- (NSData*)digestForAlgorithm:(BBHTTPDigestAlgorithm)algorithm;
+
+@end
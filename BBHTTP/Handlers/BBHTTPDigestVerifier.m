@@ -0,0 +1,345 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPDigestVerifier.h"
+
+#import <CommonCrypto/CommonDigest.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+    #import <nmmintrin.h>
+    #import <sys/sysctl.h>
+#elif defined(__ARM_FEATURE_CRC32)
+    #import <arm_acle.h>
+#endif
+
+#import "BBHTTPContentDecoder.h"
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark - Constants
+
+#define kBBHTTPDigestAlgorithmCount 4
+
+
+
+#pragma mark - CRC32C
+
+static uint32_t BBHTTPCRC32CTable[256];
+
+static uint32_t BBHTTPCRC32CSoftware(uint32_t crc, const uint8_t* bytes, size_t length)
+{
+    for (size_t i = 0; i < length; i++) crc = BBHTTPCRC32CTable[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+
+    return crc;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse4.2")))
+static uint32_t BBHTTPCRC32CHardware(uint32_t crc, const uint8_t* bytes, size_t length)
+{
+    for (; (length > 0) && (((uintptr_t)bytes & 7) != 0); length--) crc = _mm_crc32_u8(crc, *bytes++);
+#if defined(__x86_64__)
+    for (; length >= 8; length -= 8, bytes += 8) crc = (uint32_t)_mm_crc32_u64(crc, *(const uint64_t*)bytes);
+#endif
+    for (; length >= 4; length -= 4, bytes += 4) crc = _mm_crc32_u32(crc, *(const uint32_t*)bytes);
+    for (; length > 0; length--) crc = _mm_crc32_u8(crc, *bytes++);
+
+    return crc;
+}
+
+static BOOL BBHTTPCRC32CHardwareAvailable(void)
+{
+    int available = 0;
+    size_t size = sizeof(available);
+
+    return (sysctlbyname("hw.optional.sse4_2", &available, &size, NULL, 0) == 0) && (available != 0);
+}
+#elif defined(__ARM_FEATURE_CRC32)
+static uint32_t BBHTTPCRC32CHardware(uint32_t crc, const uint8_t* bytes, size_t length)
+{
+    for (; (length > 0) && (((uintptr_t)bytes & 7) != 0); length--) crc = __crc32cb(crc, *bytes++);
+    for (; length >= 8; length -= 8, bytes += 8) crc = __crc32cd(crc, *(const uint64_t*)bytes);
+    for (; length > 0; length--) crc = __crc32cb(crc, *bytes++);
+
+    return crc;
+}
+
+static BOOL BBHTTPCRC32CHardwareAvailable(void)
+{
+    return YES; // Guaranteed by the compiler flags
+}
+#endif
+
+static uint32_t BBHTTPCRC32CUpdate(uint32_t crc, const uint8_t* bytes, size_t length)
+{
+    static uint32_t (*implementation)(uint32_t, const uint8_t*, size_t) = NULL;
+    static dispatch_once_t token;
+    dispatch_once(&token, ^{
+        implementation = BBHTTPCRC32CSoftware;
+
+#if defined(__x86_64__) || defined(__i386__) || defined(__ARM_FEATURE_CRC32)
+        if (BBHTTPCRC32CHardwareAvailable()) implementation = BBHTTPCRC32CHardware;
+#endif
+
+        if (implementation == BBHTTPCRC32CSoftware) {
+            // Castagnoli polynomial, reversed
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; bit++) value = (value & 1) ? ((value >> 1) ^ 0x82F63B78) : (value >> 1);
+                BBHTTPCRC32CTable[i] = value;
+            }
+        }
+    });
+
+    return implementation(crc, bytes, length);
+}
+
+
+
+#pragma mark - Utility functions
+
+static NSData* BBHTTPDigestDecodeBase64(NSString* string)
+{
+    if ([NSData instancesRespondToSelector:@selector(initWithBase64EncodedString:options:)]) {
+        return [[NSData alloc] initWithBase64EncodedString:string options:NSDataBase64DecodingIgnoreUnknownCharacters];
+    }
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+    return [[NSData alloc] initWithBase64Encoding:string];
+#pragma clang diagnostic pop
+}
+
+static NSString* BBHTTPDigestAlgorithmName(BBHTTPDigestAlgorithm algorithm)
+{
+    switch (algorithm) {
+        case BBHTTPDigestAlgorithmMD5:    return @"MD5";
+        case BBHTTPDigestAlgorithmSHA1:   return @"SHA-1";
+        case BBHTTPDigestAlgorithmSHA256: return @"SHA-256";
+        case BBHTTPDigestAlgorithmCRC32C: return @"CRC32C";
+    }
+
+    return nil;
+}
+
+
+
+#pragma mark -
+
+@implementation BBHTTPDigestVerifier
+{
+    BBHTTPDigestAlgorithm _expectedAlgorithm;
+    NSData* _expectedDigest;
+    BOOL _computeExpectedAlgorithm;
+
+    // Per-response state
+    NSData* _expected[kBBHTTPDigestAlgorithmCount];
+    NSData* _computed[kBBHTTPDigestAlgorithmCount];
+    BOOL _active[kBBHTTPDigestAlgorithmCount];
+
+    CC_MD5_CTX _md5;
+    CC_SHA1_CTX _sha1;
+    CC_SHA256_CTX _sha256;
+    uint32_t _crc32c;
+}
+
+
+#pragma mark Creation
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self != nil) {
+        _verifyResponseHeaders = YES;
+    }
+
+    return self;
+}
+
+- (instancetype)initWithAlgorithm:(BBHTTPDigestAlgorithm)algorithm expectedDigest:(NSData*)expectedDigest
+{
+    NSParameterAssert(algorithm < kBBHTTPDigestAlgorithmCount);
+
+    self = [self init];
+    if (self != nil) {
+        _expectedAlgorithm = algorithm;
+        _expectedDigest = [expectedDigest copy];
+        _computeExpectedAlgorithm = YES;
+    }
+
+    return self;
+}
+
+
+#pragma mark BBHTTPContentStage
+
+- (BOOL)prepareForResponse:(NSUInteger)statusCode message:(NSString*)message headers:(NSDictionary*)headers
+                      error:(NSError**)error
+{
+    for (NSUInteger i = 0; i < kBBHTTPDigestAlgorithmCount; i++) {
+        _expected[i] = nil;
+        _computed[i] = nil;
+        _active[i] = NO;
+    }
+
+    // A partial response only carries the bytes after the resume point, so it can't match a digest of the whole content
+    if (_computeExpectedAlgorithm && (statusCode != 206)) {
+        _active[_expectedAlgorithm] = YES;
+        _expected[_expectedAlgorithm] = _expectedDigest;
+    } else if (_computeExpectedAlgorithm && (_expectedDigest != nil)) {
+        BBHTTPLogDebug(@"[%@] Partial response, skipping verification of the expected %@ digest.",
+                       self, BBHTTPDigestAlgorithmName(_expectedAlgorithm));
+    }
+
+    // Server digests cover the whole representation as sent, not a range of it nor its decoded form
+    if (_verifyResponseHeaders && (statusCode != 206) &&
+        ![BBHTTPContentDecoder supportsEncoding:headers[H(ContentEncoding)]]) {
+        [self collectExpectedDigestsFromHeaders:headers];
+    }
+
+    CC_MD5_Init(&_md5);
+    CC_SHA1_Init(&_sha1);
+    CC_SHA256_Init(&_sha256);
+    _crc32c = 0xFFFFFFFF;
+
+    return YES;
+}
+
+- (BOOL)processBytes:(uint8_t*)bytes withLength:(NSUInteger)length toBlock:(BBHTTPContentStageOutput)output
+               error:(NSError**)error
+{
+    if (_active[BBHTTPDigestAlgorithmMD5]) CC_MD5_Update(&_md5, bytes, (CC_LONG)length);
+    if (_active[BBHTTPDigestAlgorithmSHA1]) CC_SHA1_Update(&_sha1, bytes, (CC_LONG)length);
+    if (_active[BBHTTPDigestAlgorithmSHA256]) CC_SHA256_Update(&_sha256, bytes, (CC_LONG)length);
+    if (_active[BBHTTPDigestAlgorithmCRC32C]) _crc32c = BBHTTPCRC32CUpdate(_crc32c, bytes, length);
+
+    return output(bytes, length);
+}
+
+- (BOOL)finishToBlock:(BBHTTPContentStageOutput)output error:(NSError**)error
+{
+    [self finalizeDigests];
+
+    for (NSUInteger i = 0; i < kBBHTTPDigestAlgorithmCount; i++) {
+        if ((_expected[i] == nil) || [_expected[i] isEqualToData:_computed[i]]) continue;
+
+        BBHTTPLogWarn(@"[%@] %@ digest mismatch: expected %@, got %@.", self,
+                      BBHTTPDigestAlgorithmName(i), _expected[i], _computed[i]);
+        if (error != NULL) {
+            *error = BBHTTPErrorWithFormat(BBHTTPErrorCodeDownloadIntegrityCheckFailed,
+                                           @"Response content %@ digest mismatch", BBHTTPDigestAlgorithmName(i));
+        }
+        return NO;
+    }
+
+    return YES;
+}
+
+- (BOOL)preservesLength
+{
+    return YES;
+}
+
+
+#pragma mark Querying results
+
+- (NSData*)digestForAlgorithm:(BBHTTPDigestAlgorithm)algorithm
+{
+    if (algorithm >= kBBHTTPDigestAlgorithmCount) return nil;
+
+    return _computed[algorithm];
+}
+
+
+#pragma mark Private helpers
+
+- (void)collectExpectedDigestsFromHeaders:(NSDictionary*)headers
+{
+    // Digest: SHA-256=X48E9qOokqqrvdts8nOJRJN3OWDUoyWxBf7kbu9DBPE=,MD5=HUXZLQLMuI/KZ5KDcJPcOA==
+    for (NSString* item in [headers[H(Digest)] componentsSeparatedByString:@","]) {
+        NSRange separator = [item rangeOfString:@"="];
+        if (separator.location == NSNotFound) continue;
+
+        NSString* name = [[[item substringToIndex:separator.location]
+                           stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]] lowercaseString];
+        NSString* value = [[item substringFromIndex:(separator.location + 1)]
+                           stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+
+        BBHTTPDigestAlgorithm algorithm;
+        if ([name isEqualToString:@"md5"]) algorithm = BBHTTPDigestAlgorithmMD5;
+        else if ([name isEqualToString:@"sha"]) algorithm = BBHTTPDigestAlgorithmSHA1;
+        else if ([name isEqualToString:@"sha-256"]) algorithm = BBHTTPDigestAlgorithmSHA256;
+        else if ([name isEqualToString:@"crc32c"]) algorithm = BBHTTPDigestAlgorithmCRC32C;
+        else continue; // Unsupported algorithm
+
+        [self expectDigest:BBHTTPDigestDecodeBase64(value) forAlgorithm:algorithm];
+    }
+
+    NSString* contentMD5 = headers[H(ContentMD5)];
+    if (contentMD5 != nil) {
+        [self expectDigest:BBHTTPDigestDecodeBase64(contentMD5) forAlgorithm:BBHTTPDigestAlgorithmMD5];
+    }
+}
+
+- (void)expectDigest:(NSData*)digest forAlgorithm:(BBHTTPDigestAlgorithm)algorithm
+{
+    if ([digest length] == 0) return; // Malformed value
+
+    _active[algorithm] = YES;
+    if (_expected[algorithm] == nil) _expected[algorithm] = digest;
+}
+
+- (void)finalizeDigests
+{
+    if (_active[BBHTTPDigestAlgorithmMD5]) {
+        uint8_t digest[CC_MD5_DIGEST_LENGTH];
+        CC_MD5_Final(digest, &_md5);
+        _computed[BBHTTPDigestAlgorithmMD5] = [NSData dataWithBytes:digest length:sizeof(digest)];
+    }
+
+    if (_active[BBHTTPDigestAlgorithmSHA1]) {
+        uint8_t digest[CC_SHA1_DIGEST_LENGTH];
+        CC_SHA1_Final(digest, &_sha1);
+        _computed[BBHTTPDigestAlgorithmSHA1] = [NSData dataWithBytes:digest length:sizeof(digest)];
+    }
+
+    if (_active[BBHTTPDigestAlgorithmSHA256]) {
+        uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+        CC_SHA256_Final(digest, &_sha256);
+        _computed[BBHTTPDigestAlgorithmSHA256] = [NSData dataWithBytes:digest length:sizeof(digest)];
+    }
+
+    if (_active[BBHTTPDigestAlgorithmCRC32C]) {
+        uint32_t crc = CFSwapInt32HostToBig(~_crc32c);
+        _computed[BBHTTPDigestAlgorithmCRC32C] = [NSData dataWithBytes:&crc length:sizeof(crc)];
+    }
+}
+
+
+#pragma mark Debug
+
+- (NSString*)description
+{
+    return NSStringFromClass([self class]);
+}
+
+@end
@@ -22,15 +22,49 @@
 #import "BBHTTPSelectiveDiscarder.h"
 
 
+
+#pragma mark - Enums
+
+typedef NS_ENUM(NSUInteger, BBHTTPFileWriterSyncPolicy) {
+    BBHTTPFileWriterSyncPolicyNone = 0,     // Leave it up to the OS to decide when data hits the disk
+    BBHTTPFileWriterSyncPolicyOnFinish,     // Sync once, after the whole file has been written
+    BBHTTPFileWriterSyncPolicyOnEveryWrite  // Sync after every coalesced write
+};
+
+
+
 #pragma mark -
 
 /**
  Response parser that inherits selective behavior from `<BBHTTPSelectiveResponseParser>` and dumps all the data it
  receives through `<appendResponseBytes:withLength:>` to a the file it was initialized with.
- 
+
+ Data is written straight to a file descriptor: the chunks handed over by libcurl are coalesced in memory and written to
+ disk in large, page-aligned blocks. When the response carries a `Content-Length` header, disk space for the whole file
+ is preallocated up front. By default, disk writes are performed on a background queue so that they do not block the
+ transfer &mdash; at most one block is in flight at any time, so memory usage remains bounded.
+
  If the file cannot be written to or there's not enough space left on device, the request will fail.
 
- If an error occurs while transferring data to the the file, the partial file will automatically be deleted.
+ If an error occurs while transferring data to the the file, the partial file will automatically be deleted &mdash;
+ unless the writer is `<resumable>`. Files that fail an integrity check (e.g. of a `<BBHTTPDigestVerifier>` placed in
+ front of the writer) are always deleted.
+
+ ### Resumable downloads
+
+ When `<resumable>` is set and a download is interrupted, the partial file is kept, along with a small sidecar file
+ (the target path with a `.bbhttp-resume` extension) that records the number of bytes written and the `ETag` or
+ `Last-Modified` validator of the response.
+
+ The next request for the same URL that downloads to the same file with a resumable writer will automatically send the
+ `Range` and `If-Range` headers. If the server responds with `206 Partial Content`, the new data is appended to the
+ partial file; if it responds with `200 OK` (the resource changed or ranges aren't supported), the file is rewritten
+ from scratch. Once the download finishes, the size of the file is checked against the size announced by the server
+ and, if the request succeeded, the sidecar is deleted. Bodies of unknown size (e.g. chunked) that get cut short are
+ kept for resuming like any other interrupted download.
+
+ Resumable downloads are never compressed (`dontAcceptCompressedContent` is set on the request), since byte ranges
+ always refer to the encoded representation of a resource.
  */
 @interface BBHTTPFileWriter : BBHTTPSelectiveDiscarder
 
@@ -39,4 +73,33 @@
 
 - (instancetype)initWithTargetFile:(NSString*)pathToFile;
 
+
+#pragma mark Configuring write behavior
+
+/**
+ When to force written data to permanent storage.
+
+ Defaults to `BBHTTPFileWriterSyncPolicyNone`.
+ */
+@property(assign, nonatomic) BBHTTPFileWriterSyncPolicy syncPolicy;
+
+/**
+ Flag that indicates whether coalesced blocks are written to disk on a background queue.
+
+ When set to `NO`, writes are performed on the transfer thread.
+
+ Defaults to `YES`.
+ */
+@property(assign, nonatomic) BOOL asynchronousWrites;
+
+/**
+ Flag that indicates whether interrupted downloads should be kept on disk to be resumed later.
+
+ Responses without a strong `ETag` or a `Last-Modified` header can't be safely resumed; if such a download is
+ interrupted, the partial file is deleted.
+
+ Defaults to `NO`.
+ */
+@property(assign, nonatomic, getter = isResumable) BOOL resumable;
+
 @end
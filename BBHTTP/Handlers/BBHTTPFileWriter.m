@@ -21,17 +21,62 @@
 
 #import "BBHTTPFileWriter.h"
 
+#import <fcntl.h>
+#import <unistd.h>
+
+#import "BBHTTPRequest.h"
 #import "BBHTTPUtils.h"
 
 
 
+#pragma mark - Constants
+
+// Size of the blocks written to disk; a multiple of the page size, so that writes remain aligned.
+#define kBBHTTPFileWriterBlockSize (256 * 1024)
+
+// Resume sidecar file extension & keys
+#define kBBHTTPFileWriterResumeExtension    @"bbhttp-resume"
+#define kBBHTTPFileWriterResumeURL          @"url"
+#define kBBHTTPFileWriterResumeOffset       @"offset"
+#define kBBHTTPFileWriterResumeTotal        @"total"
+#define kBBHTTPFileWriterResumeETag         @"etag"
+#define kBBHTTPFileWriterResumeLastModified @"lastModified"
+
+
+
+#pragma mark - Helpers
+
+static NSError* BBHTTPFileWriterPOSIXError(int code, NSString* path)
+{
+    return [NSError errorWithDomain:NSPOSIXErrorDomain code:code userInfo:@{NSFilePathErrorKey: path}];
+}
+
+
+
 #pragma mark -
 
 @implementation BBHTTPFileWriter
 {
     NSString* _pathToFile;
-    NSOutputStream* _stream;
+    int _fd;
+    unsigned long long _fileSize;
+    uint8_t* _blocks[2];
+    uint8_t* _currentBlock;
+    NSUInteger _currentBlockLength;
+    dispatch_queue_t _writeQueue;
+    dispatch_semaphore_t _writeSlot;
+    NSError* _writeError;
+    NSError* _verificationError;
     BOOL _needsCleanup;
+    BOOL _completed;
+    BOOL _requestFailed;
+
+    NSString* _resumeURL;
+    unsigned long long _resumeOffset;
+    unsigned long long _expectedFileSize;
+    NSString* _entityTag;
+    NSString* _lastModified;
+    BOOL _discardPartialFile;
 }
 
 
@@ -42,61 +87,441 @@
     self = [super init];
     if (self != nil) {
         _pathToFile = pathToFile;
+        _fd = -1;
         _needsCleanup = NO;
+        _syncPolicy = BBHTTPFileWriterSyncPolicyNone;
+        _asynchronousWrites = YES;
     }
 
     return self;
 }
 
 
+#pragma mark Destruction
+
+- (void)dealloc
+{
+    [self closeFile];
+
+    free(_blocks[0]);
+    free(_blocks[1]);
+
+#if !OS_OBJECT_USE_OBJC
+    if (_writeQueue != NULL) dispatch_release(_writeQueue);
+    if (_writeSlot != NULL) dispatch_release(_writeSlot);
+#endif
+}
+
+
 #pragma mark BBHTTPContentHandler
 
+- (void)willExecuteRequest:(BBHTTPRequest*)request
+{
+    _resumeOffset = 0;
+    if (!_resumable) return;
+
+    // Byte ranges always refer to the encoded representation, so decoded content could never be resumed
+    request.dontAcceptCompressedContent = YES;
+    _resumeURL = [request.url absoluteString];
+
+    if (![self loadResumeInfo]) return;
+
+    NSString* validator = (_entityTag != nil) ? _entityTag : _lastModified;
+    [request setValue:[NSString stringWithFormat:@"bytes=%llu-", _resumeOffset] forHeader:H(Range)];
+    [request setValue:validator forHeader:H(IfRange)];
+
+    BBHTTPLogDebug(@"[%@] Resuming download of '%@' from byte %llu.", self, _pathToFile, _resumeOffset);
+}
+
 - (BOOL)prepareForResponse:(NSUInteger)statusCode message:(NSString*)message headers:(NSDictionary*)headers
                       error:(NSError**)error
 {
-    if (![super prepareForResponse:statusCode message:message headers:headers error:error]) return NO;
+    BOOL resuming = (statusCode == 206) && (_resumeOffset > 0);
+    if (resuming) {
+        if (![self acceptPartialContentWithHeaders:headers error:error]) return NO;
+    } else {
+        if ((statusCode == 416) && (_resumeOffset > 0)) [self deleteResumeInfo]; // Stale partial file
+        if (![super prepareForResponse:statusCode message:message headers:headers error:error]) return NO;
+
+        if (_resumeOffset > 0) {
+            BBHTTPLogDebug(@"[%@] Server responded with %lu instead of partial content; restarting download.",
+                           self, (unsigned long)statusCode);
+            _resumeOffset = 0;
+        }
+    }
+
+    [self closeFile];
+    if (![self prepareBlocks:error]) return NO;
+
+    int flags = resuming ? O_WRONLY : (O_WRONLY | O_CREAT | O_TRUNC);
+    _fd = open([_pathToFile fileSystemRepresentation], flags, 0644);
+    if ((_fd >= 0) && resuming && (lseek(_fd, (off_t)_resumeOffset, SEEK_SET) < 0)) [self closeFile];
+    if (_fd < 0) {
+        if (error != NULL) *error = BBHTTPFileWriterPOSIXError(errno, _pathToFile);
+        return NO;
+    }
 
-    _stream = [NSOutputStream outputStreamToFileAtPath:_pathToFile append:NO];
-    [_stream open];
     _needsCleanup = YES;
+    _completed = NO;
+    _requestFailed = NO;
+    _verificationError = nil;
+    _fileSize = _resumeOffset;
+    _writeError = nil;
+    _discardPartialFile = NO;
+    [self recordValidatorsFromHeaders:headers];
+
+    unsigned long long contentLength = (unsigned long long)[headers[H(ContentLength)] longLongValue];
+    if (!resuming) _expectedFileSize = contentLength;
+
+    if ((contentLength > 0) && ![self preallocateSpaceFromOffset:_fileSize length:contentLength error:error]) {
+        [self cleanup];
+        return NO;
+    }
 
     return YES;
 }
 
 - (NSInteger)appendResponseBytes:(uint8_t*)bytes withLength:(NSUInteger)length error:(NSError**)error
 {
-    NSInteger written = [_stream write:bytes maxLength:length];
-    if (written <= 0) [self cleanup];
-    if ((written < 0) && (error != NULL)) *error = [_stream streamError];
+    NSUInteger consumed = 0;
+    while (consumed < length) {
+        NSUInteger chunk = MIN(length - consumed, kBBHTTPFileWriterBlockSize - _currentBlockLength);
+        memcpy(_currentBlock + _currentBlockLength, bytes + consumed, chunk);
+        _currentBlockLength += chunk;
+        consumed += chunk;
 
-    return written;
+        if ((_currentBlockLength == kBBHTTPFileWriterBlockSize) && ![self flushCurrentBlock:error]) {
+            [self cleanup];
+            return -1;
+        }
+    }
+
+    _fileSize += length;
+
+    return length;
 }
 
 - (id)parseContent:(NSError**)error
 {
-    _needsCleanup = NO;
-    if (([_stream streamError] != nil) && (error != NULL)) *error = [_stream streamError];
-    if ([_stream streamStatus] != NSStreamStatusClosed) [_stream close];
+    NSError* finishError = nil;
+    if (![self finishFile:&finishError] || ![self verifyFileSize:&finishError]) {
+        if (error != NULL) *error = finishError;
+        return nil;
+    }
+
+    // Without a Content-Length, a truncated body looks just like a complete one; the file is only committed on cleanup,
+    // once it's known whether the request failed.
+    _completed = YES;
 
-    // There's never anything to return here, this parser merely pumps data to the output stream.
+    // There's never anything to return here, this parser merely pumps data to the file.
     return nil;
 }
 
+- (void)requestFailedWithError:(NSError*)error
+{
+    _requestFailed = YES;
+
+    // Content that failed someone else's integrity check (e.g. a digest verifier in front of this writer) is corrupt,
+    // so there's nothing worth resuming
+    if ((error != _verificationError) && [error.domain isEqualToString:@"com.biasedbit.http"] &&
+        (error.code == BBHTTPErrorCodeDownloadIntegrityCheckFailed)) {
+        _discardPartialFile = YES;
+    }
+}
+
 - (void)cleanup
 {
     if (!_needsCleanup) return;
 
     _needsCleanup = NO;
-    [_stream close];
+    if (_completed && !_requestFailed) {
+        if (_resumable) [self deleteResumeInfo];
+        return;
+    }
+
+    if ([self keepPartialFileForResume]) return;
+
+    [self closeFile];
     [self deleteFileInBackground];
 }
 
 
 #pragma mark Private helpers
 
+- (BOOL)prepareBlocks:(NSError**)error
+{
+    for (NSUInteger i = 0; i < 2; i++) {
+        if (_blocks[i] != NULL) continue;
+
+        int result = posix_memalign((void**)&_blocks[i], (size_t)getpagesize(), kBBHTTPFileWriterBlockSize);
+        if (result != 0) {
+            _blocks[i] = NULL;
+            if (error != NULL) *error = BBHTTPFileWriterPOSIXError(result, _pathToFile);
+            return NO;
+        }
+    }
+
+    _currentBlock = _blocks[0];
+    _currentBlockLength = 0;
+
+    if (_asynchronousWrites && (_writeQueue == NULL)) {
+        _writeQueue = dispatch_queue_create("com.biasedbit.HTTPFileWriterQueue", DISPATCH_QUEUE_SERIAL);
+        _writeSlot = dispatch_semaphore_create(1);
+    }
+
+    return YES;
+}
+
+- (BOOL)preallocateSpaceFromOffset:(unsigned long long)offset length:(unsigned long long)size
+                             error:(NSError**)error
+{
+    // The offset is always the end of the file (a fresh file or the end of a partial one)
+    int failure = BBHTTPPreallocateFile(_fd, offset, size);
+
+    if (failure == 0) {
+        BBHTTPLogTrace(@"[%@] Preallocated %llub for '%@'.", self, size, _pathToFile);
+        return YES;
+    }
+
+    if (failure == ENOSPC) {
+        // No point in starting a download that won't fit
+        if (error != NULL) *error = BBHTTPFileWriterPOSIXError(failure, _pathToFile);
+        return NO;
+    }
+
+    // Preallocation is merely an optimization; file systems that don't support it can still be written to.
+    BBHTTPLogDebug(@"[%@] Could not preallocate %llub for '%@': %s", self, size, _pathToFile, strerror(failure));
+    return YES;
+}
+
+- (BOOL)flushCurrentBlock:(NSError**)error
+{
+    if (_currentBlockLength == 0) return YES;
+
+    uint8_t* block = _currentBlock;
+    NSUInteger length = _currentBlockLength;
+    _currentBlockLength = 0;
+
+    if (!_asynchronousWrites || (_writeQueue == NULL)) {
+        [self writeBlock:block withLength:length];
+        if ((_writeError != nil) && (error != NULL)) *error = _writeError;
+
+        return _writeError == nil;
+    }
+
+    // Only one write may be in flight; once it's done, the block it was writing becomes available again.
+    dispatch_semaphore_wait(_writeSlot, DISPATCH_TIME_FOREVER);
+    if (_writeError != nil) {
+        dispatch_semaphore_signal(_writeSlot);
+        if (error != NULL) *error = _writeError;
+        return NO;
+    }
+
+    dispatch_async(_writeQueue, ^{
+        [self writeBlock:block withLength:length];
+        dispatch_semaphore_signal(_writeSlot);
+    });
+
+    _currentBlock = (block == _blocks[0]) ? _blocks[1] : _blocks[0];
+
+    return YES;
+}
+
+- (void)writeBlock:(uint8_t*)block withLength:(NSUInteger)length
+{
+    if (_writeError != nil) return;
+
+    NSUInteger written = 0;
+    while (written < length) {
+        ssize_t result = write(_fd, block + written, length - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+
+            _writeError = BBHTTPFileWriterPOSIXError(errno, _pathToFile);
+            BBHTTPLogError(@"[%@] Failed to write %lub to '%@': %@",
+                           self, (unsigned long)length, _pathToFile, [_writeError localizedDescription]);
+            return;
+        }
+
+        written += result;
+    }
+
+    if ((_syncPolicy == BBHTTPFileWriterSyncPolicyOnEveryWrite) && ![self syncFile]) {
+        _writeError = BBHTTPFileWriterPOSIXError(errno, _pathToFile);
+    }
+}
+
+- (void)waitForPendingWrites
+{
+    if (_writeSlot == NULL) return;
+
+    // Acquiring (and releasing) the slot guarantees that the last write in flight has completed
+    dispatch_semaphore_wait(_writeSlot, DISPATCH_TIME_FOREVER);
+    dispatch_semaphore_signal(_writeSlot);
+}
+
+- (BOOL)syncFile
+{
+#if defined(F_FULLFSYNC)
+    // On Darwin, fsync() doesn't ask the drive to flush its own cache; F_FULLFSYNC does.
+    if (fcntl(_fd, F_FULLFSYNC) == 0) return YES;
+#endif
+
+    return fsync(_fd) == 0;
+}
+
+- (BOOL)finishFile:(NSError**)error
+{
+    if (_fd < 0) return YES;
+
+    [self flushCurrentBlock:NULL];
+    [self waitForPendingWrites];
+
+    if ((_writeError == nil) && (ftruncate(_fd, (off_t)_fileSize) != 0)) {
+        // Preallocation may have left the file larger than what was actually received
+        _writeError = BBHTTPFileWriterPOSIXError(errno, _pathToFile);
+    }
+
+    if ((_writeError == nil) && (_syncPolicy != BBHTTPFileWriterSyncPolicyNone) && ![self syncFile]) {
+        _writeError = BBHTTPFileWriterPOSIXError(errno, _pathToFile);
+    }
+
+    [self closeFile];
+
+    if ((_writeError != nil) && (error != NULL)) *error = _writeError;
+
+    return _writeError == nil;
+}
+
+- (void)closeFile
+{
+    if (_fd < 0) return;
+
+    [self waitForPendingWrites];
+    close(_fd);
+    _fd = -1;
+}
+
+- (BOOL)verifyFileSize:(NSError**)error
+{
+    if ((_expectedFileSize == 0) || (_fileSize == _expectedFileSize)) return YES;
+
+    // Too few bytes means the transfer was interrupted (and may be resumed); too many means the file is corrupt.
+    _discardPartialFile = (_fileSize > _expectedFileSize);
+    _verificationError = BBHTTPErrorWithFormat(BBHTTPErrorCodeDownloadIntegrityCheckFailed,
+                                               @"Downloaded file size mismatch (expected %llu bytes, got %llu)",
+                                               _expectedFileSize, _fileSize);
+    if (error != NULL) *error = _verificationError;
+
+    return NO;
+}
+
+- (BOOL)acceptPartialContentWithHeaders:(NSDictionary*)headers error:(NSError**)error
+{
+    NSString* contentType = headers[H(ContentType)]; // might be nil
+    if (![self isAcceptableContentType:contentType]) {
+        if (error != NULL) {
+            *error = BBHTTPErrorWithFormat(BBHTTPErrorCodeUnnacceptableContentType,
+                                           @"Unnacceptable response content: %@", contentType);
+        }
+        return NO;
+    }
+
+    unsigned long long first = 0;
+    unsigned long long total = 0;
+    if (!BBHTTPParseContentRange(headers[H(ContentRange)], &first, NULL, &total) || (first != _resumeOffset)) {
+        // Can't trust the partial file to line up with what the server sent; start over next time
+        [self deleteResumeInfo];
+        if (error != NULL) {
+            *error = BBHTTPErrorWithFormat(BBHTTPErrorCodeDownloadIntegrityCheckFailed,
+                                           @"Unexpected partial content range: %@", headers[H(ContentRange)]);
+        }
+        return NO;
+    }
+
+    _expectedFileSize = total;
+
+    return YES;
+}
+
+- (void)recordValidatorsFromHeaders:(NSDictionary*)headers
+{
+    NSString* entityTag = headers[H(ETag)];
+    NSString* lastModified = headers[H(LastModified)];
+
+    // Partial responses may omit the validators, in which case the ones from the original response still apply
+    if ((entityTag == nil) && (lastModified == nil) && (_resumeOffset > 0)) return;
+
+    // Weak entity tags can't be used with If-Range
+    _entityTag = ((entityTag != nil) && ![entityTag hasPrefix:@"W/"]) ? entityTag : nil;
+    _lastModified = lastModified;
+}
+
+- (NSString*)resumeInfoPath
+{
+    return [_pathToFile stringByAppendingPathExtension:kBBHTTPFileWriterResumeExtension];
+}
+
+- (BOOL)loadResumeInfo
+{
+    NSDictionary* info = [NSDictionary dictionaryWithContentsOfFile:[self resumeInfoPath]];
+    if (info == nil) return NO;
+
+    // Only trust the partial file if it's exactly as it was left, for the same resource
+    unsigned long long offset = [info[kBBHTTPFileWriterResumeOffset] unsignedLongLongValue];
+    NSDictionary* attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:_pathToFile error:nil];
+    BOOL hasValidator = (info[kBBHTTPFileWriterResumeETag] != nil) ||
+                        (info[kBBHTTPFileWriterResumeLastModified] != nil);
+
+    if (![info[kBBHTTPFileWriterResumeURL] isEqualToString:_resumeURL] || !hasValidator ||
+        (offset == 0) || (attributes == nil) || ([attributes fileSize] != offset)) {
+        BBHTTPLogDebug(@"[%@] Discarding stale resume information for '%@'.", self, _pathToFile);
+        [self deleteResumeInfo];
+        return NO;
+    }
+
+    _resumeOffset = offset;
+    _expectedFileSize = [info[kBBHTTPFileWriterResumeTotal] unsignedLongLongValue];
+    _entityTag = info[kBBHTTPFileWriterResumeETag];
+    _lastModified = info[kBBHTTPFileWriterResumeLastModified];
+
+    return YES;
+}
+
+- (BOOL)keepPartialFileForResume
+{
+    if (!_resumable || _discardPartialFile || (_writeError != nil) || (_resumeURL == nil)) return NO;
+    if ((_entityTag == nil) && (_lastModified == nil)) return NO;
+
+    // Make sure everything received so far is on disk, and nothing beyond that (preallocated space) is
+    if (![self finishFile:NULL] || (_fileSize == 0)) return NO;
+
+    NSMutableDictionary* info = [NSMutableDictionary dictionary];
+    info[kBBHTTPFileWriterResumeURL] = _resumeURL;
+    info[kBBHTTPFileWriterResumeOffset] = @(_fileSize);
+    info[kBBHTTPFileWriterResumeTotal] = @(_expectedFileSize);
+    if (_entityTag != nil) info[kBBHTTPFileWriterResumeETag] = _entityTag;
+    if (_lastModified != nil) info[kBBHTTPFileWriterResumeLastModified] = _lastModified;
+
+    if (![info writeToFile:[self resumeInfoPath] atomically:YES]) {
+        BBHTTPLogWarn(@"[%@] Could not save resume information for '%@'.", self, _pathToFile);
+        return NO;
+    }
+
+    BBHTTPLogDebug(@"[%@] Kept %llub of '%@' to resume later.", self, _fileSize, _pathToFile);
+    return YES;
+}
+
+- (void)deleteResumeInfo
+{
+    [[NSFileManager defaultManager] removeItemAtPath:[self resumeInfoPath] error:nil];
+}
+
 - (void)deleteFileInBackground
 {
     dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+        if (_resumable) [self deleteResumeInfo];
+
         NSError* error = nil;
         if (![[NSFileManager defaultManager] removeItemAtPath:_pathToFile error:&error]) {
             NSError* cause = [[error userInfo] objectForKey:NSUnderlyingErrorKey];
@@ -0,0 +1,74 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPSelectiveDiscarder.h"
+
+
+
+#pragma mark -
+
+/**
+ Convert request body to `NSData`, in memory or on disk depending on its size.
+
+ Bodies up to `<memoryThreshold>` bytes are accumulated in memory, just like `<BBHTTPAccumulator>` does; as soon as
+ a body crosses that threshold, everything received so far is moved to a temporary file and the rest of the body is
+ streamed to it, just like `<BBHTTPMappedAccumulator>` does. Either way, `<parseContent:>` returns an `NSData`
+ &mdash; heap-backed for small bodies, memory-mapped for large ones.
+
+ When the response carries a `Content-Length`, the decision is made upfront: bodies known to be larger than the
+ threshold go straight to disk.
+ */
+@interface BBHTTPHybridAccumulator : BBHTTPSelectiveDiscarder
+
+
+#pragma mark Creating a new hybrid accumulator
+
+/**
+ Creates a new hybrid accumulator that keeps its temporary files under `NSTemporaryDirectory()`.
+
+ @return An initialized `BBHTTPHybridAccumulator`.
+ */
+- (instancetype)init;
+
+/**
+ Creates a new hybrid accumulator that keeps its temporary files in a given directory.
+
+ @param directory Directory where the temporary files will be created; must be writable.
+
+ @return An initialized `BBHTTPHybridAccumulator`.
+ */
+- (instancetype)initWithTemporaryDirectory:(NSString*)directory;
+
+
+#pragma mark Configuring behavior
+
+/** Size, in bytes, above which a body is moved to disk. Defaults to 1MB. */
+@property(assign, nonatomic) NSUInteger memoryThreshold;
+
+
+#pragma mark Properties
+
+/** The directory where the temporary files are created. */
+@property(copy, nonatomic, readonly) NSString* temporaryDirectory;
+/** Whether the body of the current response is being written to disk. */
+@property(assign, nonatomic, readonly, getter = hasSpilledToDisk) BOOL spilledToDisk;
+
+@end
@@ -0,0 +1,153 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPHybridAccumulator.h"
+
+#import "BBHTTPAccumulator.h"
+#import "BBHTTPMappedAccumulator.h"
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark -
+
+@implementation BBHTTPHybridAccumulator
+{
+    id<BBHTTPContentHandler> _handler; // Either the memory or the disk accumulator
+
+    NSUInteger _accumulated;
+    NSUInteger _statusCode;
+    NSString* _message;
+    NSDictionary* _headers;
+}
+
+
+#pragma mark Creating a new hybrid accumulator
+
+- (instancetype)init
+{
+    return [self initWithTemporaryDirectory:NSTemporaryDirectory()];
+}
+
+- (instancetype)initWithTemporaryDirectory:(NSString*)directory
+{
+    BBHTTPEnsureNotNil(directory);
+
+    self = [super init];
+    if (self != nil) {
+        _temporaryDirectory = [directory copy];
+        _memoryThreshold = 1024 * 1024;
+    }
+
+    return self;
+}
+
+
+#pragma mark BBHTTPSelectiveDiscarder behavior overrides
+
+- (BOOL)prepareForResponse:(NSUInteger)statusCode message:(NSString*)message headers:(NSDictionary*)headers
+                      error:(NSError**)error
+{
+    if (![super prepareForResponse:statusCode message:message headers:headers error:error]) return NO;
+
+    [self cleanup];
+
+    _accumulated = 0;
+    _statusCode = statusCode;
+    _message = message;
+    _headers = headers;
+
+    NSString* contentLength = headers[H(ContentLength)];
+    if ((contentLength != nil) && ((unsigned long long)[contentLength longLongValue] > _memoryThreshold)) {
+        BBHTTPLogTrace(@"%@ | Body is %@b long, going straight to disk.", self, contentLength);
+        return [self spillToDisk:error];
+    }
+
+    _spilledToDisk = NO;
+    _handler = [self configureHandler:[[BBHTTPAccumulator alloc] init]];
+
+    return [_handler prepareForResponse:statusCode message:message headers:headers error:error];
+}
+
+- (BOOL)buffersResponseInMemory
+{
+    return !_spilledToDisk;
+}
+
+- (NSInteger)appendResponseBytes:(uint8_t*)bytes withLength:(NSUInteger)length error:(NSError**)error
+{
+    if (!_spilledToDisk && ((_accumulated + length) > _memoryThreshold)) {
+        BBHTTPLogTrace(@"%@ | Body crossed the %lub threshold, moving it to disk.",
+                       self, (unsigned long)_memoryThreshold);
+        if (![self spillToDisk:error]) return -1;
+    }
+
+    NSInteger written = [_handler appendResponseBytes:bytes withLength:length error:error];
+    if (written > 0) _accumulated += written;
+
+    return written;
+}
+
+- (id)parseContent:(NSError**)error
+{
+    id content = [_handler parseContent:error];
+
+    _handler = nil;
+    _headers = nil;
+
+    return content;
+}
+
+- (void)cleanup
+{
+    if ([_handler respondsToSelector:@selector(cleanup)]) [_handler cleanup];
+}
+
+
+#pragma mark Private helpers
+
+- (id<BBHTTPContentHandler>)configureHandler:(BBHTTPSelectiveDiscarder*)handler
+{
+    // This handler already vetted the response
+    handler.acceptableResponses = @[@(_statusCode)];
+    handler.acceptableContentTypes = nil;
+
+    return handler;
+}
+
+- (BOOL)spillToDisk:(NSError**)error
+{
+    // Whatever was accumulated in memory so far goes first
+    NSData* accumulated = [_handler parseContent:error];
+    if ((_handler != nil) && (accumulated == nil) && (_accumulated > 0)) return NO;
+
+    _spilledToDisk = YES;
+    _handler = [self configureHandler:[[BBHTTPMappedAccumulator alloc]
+                                       initWithTemporaryDirectory:_temporaryDirectory]];
+    if (![_handler prepareForResponse:_statusCode message:_message headers:_headers error:error]) return NO;
+
+    if ([accumulated length] == 0) return YES;
+
+    return [_handler appendResponseBytes:(uint8_t*)[accumulated bytes] withLength:[accumulated length]
+                                   error:error] == (NSInteger)[accumulated length];
+}
+
+@end
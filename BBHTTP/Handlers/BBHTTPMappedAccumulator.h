@@ -0,0 +1,68 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPSelectiveDiscarder.h"
+
+
+
+#pragma mark -
+
+/**
+ Convert request body to a memory-mapped `NSData`.
+
+ Unlike `<BBHTTPAccumulator>`, which grows a heap buffer as data arrives, this handler streams the body to an anonymous
+ temporary file &mdash; created and immediately unlinked, so it never outlives the process &mdash; and, once the
+ response is complete, returns an `NSData` backed by a read-only `mmap(2)` of that file.
+
+ Heap usage remains flat regardless of the size of the response and the system is free to page the contents in and out
+ as they're accessed, which makes this handler a good fit for bodies of hundreds of megabytes. When the response
+ carries a `Content-Length`, space for the file is reserved upfront.
+
+ The mapping is released (and the disk space reclaimed) when the returned `NSData` is deallocated.
+ */
+@interface BBHTTPMappedAccumulator : BBHTTPSelectiveDiscarder
+
+
+#pragma mark Creating a new mapped accumulator
+
+/**
+ Creates a new mapped accumulator that keeps its temporary files under `NSTemporaryDirectory()`.
+
+ @return An initialized `BBHTTPMappedAccumulator`.
+ */
+- (instancetype)init;
+
+/**
+ Creates a new mapped accumulator that keeps its temporary files in a given directory.
+
+ @param directory Directory where the temporary files will be created; must be writable.
+
+ @return An initialized `BBHTTPMappedAccumulator`.
+ */
+- (instancetype)initWithTemporaryDirectory:(NSString*)directory;
+
+
+#pragma mark Properties
+
+/** The directory where the temporary files are created. */
+@property(copy, nonatomic, readonly) NSString* temporaryDirectory;
+
+@end
@@ -0,0 +1,243 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPMappedAccumulator.h"
+
+#import <sys/mman.h>
+#import <fcntl.h>
+#import <unistd.h>
+
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark - Utility functions
+
+static NSError* BBHTTPMappedAccumulatorPOSIXError(int code, NSString* path)
+{
+    return [NSError errorWithDomain:NSPOSIXErrorDomain code:code userInfo:@{NSFilePathErrorKey: path}];
+}
+
+
+
+#pragma mark - Mapped data
+
+/**
+ Immutable `NSData` over a read-only file mapping; unmaps it when deallocated.
+ */
+@interface BBHTTPMappedData : NSData
+
+- (instancetype)initWithMapping:(void*)mapping length:(NSUInteger)length;
+
+@end
+
+@implementation BBHTTPMappedData
+{
+    void* _mapping;
+    NSUInteger _length;
+}
+
+- (instancetype)initWithMapping:(void*)mapping length:(NSUInteger)length
+{
+    self = [super init];
+    if (self != nil) {
+        _mapping = mapping;
+        _length = length;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    munmap(_mapping, _length);
+}
+
+- (NSUInteger)length
+{
+    return _length;
+}
+
+- (const void*)bytes
+{
+    return _mapping;
+}
+
+@end
+
+
+
+#pragma mark -
+
+@implementation BBHTTPMappedAccumulator
+{
+    int _fd;
+    unsigned long long _fileSize;
+    NSError* _writeError;
+}
+
+
+#pragma mark Creation
+
+- (instancetype)init
+{
+    return [self initWithTemporaryDirectory:NSTemporaryDirectory()];
+}
+
+- (instancetype)initWithTemporaryDirectory:(NSString*)directory
+{
+    BBHTTPEnsureNotNil(directory);
+
+    self = [super init];
+    if (self != nil) {
+        _temporaryDirectory = [directory copy];
+        _fd = -1;
+    }
+
+    return self;
+}
+
+
+#pragma mark Destruction
+
+- (void)dealloc
+{
+    [self closeFile];
+}
+
+
+#pragma mark BBHTTPSelectiveDiscarder behavior overrides
+
+- (BOOL)prepareForResponse:(NSUInteger)statusCode message:(NSString*)message headers:(NSDictionary*)headers
+                      error:(NSError**)error
+{
+    if (![super prepareForResponse:statusCode message:message headers:headers error:error]) return NO;
+
+    [self closeFile];
+    if (![self createTemporaryFile:error]) return NO;
+
+    _fileSize = 0;
+    _writeError = nil;
+
+    unsigned long long contentLength = (unsigned long long)[headers[H(ContentLength)] longLongValue];
+    if (contentLength > 0) {
+        int failure = BBHTTPPreallocateFile(_fd, 0, contentLength);
+        if (failure == ENOSPC) {
+            // No point in receiving a body that won't fit
+            if (error != NULL) *error = BBHTTPMappedAccumulatorPOSIXError(failure, _temporaryDirectory);
+            [self closeFile];
+            return NO;
+        }
+    }
+
+    return YES;
+}
+
+- (NSInteger)appendResponseBytes:(uint8_t*)bytes withLength:(NSUInteger)length error:(NSError**)error
+{
+    NSUInteger written = 0;
+    while (written < length) {
+        ssize_t result = write(_fd, bytes + written, length - written);
+        if (result >= 0) {
+            written += (NSUInteger)result;
+        } else if (errno != EINTR) {
+            _writeError = BBHTTPMappedAccumulatorPOSIXError(errno, _temporaryDirectory);
+            if (error != NULL) *error = _writeError;
+            [self closeFile];
+            return -1;
+        }
+    }
+
+    _fileSize += length;
+
+    return length;
+}
+
+- (id)parseContent:(NSError**)error
+{
+    if (_writeError != nil) {
+        if (error != NULL) *error = _writeError;
+        return nil;
+    }
+
+    if (_fd < 0) return nil; // No response prepared
+    if (_fileSize == 0) {
+        [self closeFile];
+        return [NSData data];
+    }
+
+    // Drop any preallocated space that wasn't used, so the mapping doesn't extend past the data
+    void* mapping = MAP_FAILED;
+    if (ftruncate(_fd, (off_t)_fileSize) == 0) {
+        mapping = mmap(NULL, (size_t)_fileSize, PROT_READ, MAP_SHARED, _fd, 0);
+    }
+
+    int failure = errno;
+
+    // The mapping keeps the (already unlinked) file alive on its own
+    [self closeFile];
+
+    if (mapping == MAP_FAILED) {
+        if (error != NULL) *error = BBHTTPMappedAccumulatorPOSIXError(failure, _temporaryDirectory);
+        return nil;
+    }
+
+    return [[BBHTTPMappedData alloc] initWithMapping:mapping length:(NSUInteger)_fileSize];
+}
+
+- (void)cleanup
+{
+    [self closeFile];
+}
+
+
+#pragma mark Private helpers
+
+- (BOOL)createTemporaryFile:(NSError**)error
+{
+    NSString* template = [_temporaryDirectory stringByAppendingPathComponent:@"bbhttp-mapped.XXXXXX"];
+    char* path = strdup([template fileSystemRepresentation]);
+
+    _fd = mkstemp(path);
+    int failure = errno;
+
+    // Unlink right away; the descriptor (and later the mapping) keeps the contents around for as long as needed and
+    // nothing is left behind if the process dies.
+    if (_fd >= 0) unlink(path);
+    free(path);
+
+    if (_fd < 0) {
+        if (error != NULL) *error = BBHTTPMappedAccumulatorPOSIXError(failure, _temporaryDirectory);
+        return NO;
+    }
+
+    return YES;
+}
+
+- (void)closeFile
+{
+    if (_fd < 0) return;
+
+    close(_fd);
+    _fd = -1;
+}
+
+@end
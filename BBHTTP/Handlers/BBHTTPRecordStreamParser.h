@@ -0,0 +1,106 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPSelectiveDiscarder.h"
+
+
+
+#pragma mark - Enums
+
+typedef NS_ENUM(NSUInteger, BBHTTPRecordStreamFormat) {
+    /** Newline-delimited JSON (one JSON value per line); records are the parsed JSON values. */
+    BBHTTPRecordStreamFormatNDJSON = 0,
+    /** Server-Sent Events (`text/event-stream`); records are `<BBHTTPServerSentEvent>` instances. */
+    BBHTTPRecordStreamFormatServerSentEvents
+};
+
+
+
+#pragma mark -
+
+/**
+ A single event of a Server-Sent Events stream.
+ */
+@interface BBHTTPServerSentEvent : NSObject
+
+/** The event type (`event` field); defaults to `message`. */
+@property(copy, nonatomic, readonly) NSString* type;
+/** The event data (`data` fields, joined by newlines). */
+@property(copy, nonatomic, readonly) NSString* data;
+/** The last event id seen in the stream (`id` field), if any. */
+@property(copy, nonatomic, readonly) NSString* identifier;
+/** Reconnection time requested by the server (`retry` field), in milliseconds; `0` if not sent. */
+@property(assign, nonatomic, readonly) NSUInteger retry;
+
+@end
+
+
+
+#pragma mark -
+
+/**
+ Parses long-lived streams of records &mdash; newline-delimited JSON or Server-Sent Events &mdash; incrementally,
+ handing each record to a block as soon as it's complete.
+
+ Unlike `<BBJSONParser>`, nothing is accumulated: only the current, incomplete record is held in memory, no matter how
+ long the stream stays open.
+
+ Records are delivered, in order, just like the request's other events &mdash; on its `callbackQueue`, as per its
+ `callbackDelivery` &mdash; so the last record is always delivered before the request's `finishBlock` is called. If
+ the consumer falls behind and more than `<maxPendingRecords>` records are waiting to be delivered, the transfer is
+ paused until it catches up.
+
+ Lines may end in `CR`, `LF` or `CRLF`, as allowed for event streams, and a leading UTF-8 byte order mark is ignored.
+
+ A malformed record (invalid JSON or larger than `<maxRecordSize>`) fails the response.
+ */
+@interface BBHTTPRecordStreamParser : BBHTTPSelectiveDiscarder
+
+
+#pragma mark Creating a new record stream parser
+
+/**
+ Creates a new record stream parser.
+
+ @param format The format of the stream.
+ @param recordBlock Block called with each record, on the request's callback queue.
+
+ @return An initialized `BBHTTPRecordStreamParser`.
+ */
+- (instancetype)initWithFormat:(BBHTTPRecordStreamFormat)format recordBlock:(void (^)(id record))recordBlock;
+
+
+#pragma mark Configuring behavior
+
+/** Maximum number of records waiting to be delivered before the transfer is paused. Defaults to 64. */
+@property(assign, nonatomic) NSUInteger maxPendingRecords;
+
+/** Maximum size of a single record, in bytes. Defaults to 1MB. */
+@property(assign, nonatomic) NSUInteger maxRecordSize;
+
+
+#pragma mark Properties
+
+@property(assign, nonatomic, readonly) BBHTTPRecordStreamFormat format;
+/** Number of records parsed so far, for the current response. */
+@property(assign, nonatomic, readonly) NSUInteger recordCount;
+
+@end
@@ -0,0 +1,334 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPRecordStreamParser.h"
+
+#import <libkern/OSAtomic.h>
+
+#import "BBHTTPRequest+PrivateInterface.h"
+#import "BBJSONDictionary.h"
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark - Server-Sent Event
+
+@interface BBHTTPServerSentEvent ()
+
+- (instancetype)initWithType:(NSString*)type data:(NSString*)data identifier:(NSString*)identifier
+                       retry:(NSUInteger)retry;
+
+@end
+
+@implementation BBHTTPServerSentEvent
+
+- (instancetype)initWithType:(NSString*)type data:(NSString*)data identifier:(NSString*)identifier
+                       retry:(NSUInteger)retry
+{
+    self = [super init];
+    if (self != nil) {
+        _type = [type copy];
+        _data = [data copy];
+        _identifier = [identifier copy];
+        _retry = retry;
+    }
+
+    return self;
+}
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"%@{type: %@, id: %@, data: %@}",
+                                      NSStringFromClass([self class]), _type, _identifier, _data];
+}
+
+@end
+
+
+
+#pragma mark -
+
+@implementation BBHTTPRecordStreamParser
+{
+    void (^_recordBlock)(id record);
+    __weak BBHTTPRequest* _request;
+    NSMutableData* _buffer; // Incomplete record carried over between chunks
+    volatile int32_t _pendingRecords;
+    BOOL _atStreamStart;
+    BOOL _skipLineFeed; // Last line ended in a CR at the very end of a chunk; a LF starting the next one is part of it
+
+    // Server-Sent Events state
+    NSString* _eventType;
+    NSMutableString* _eventData;
+    NSString* _lastEventIdentifier;
+    NSUInteger _retry;
+}
+
+
+#pragma mark Creation
+
+- (instancetype)initWithFormat:(BBHTTPRecordStreamFormat)format recordBlock:(void (^)(id record))recordBlock
+{
+    self = [super init];
+    if (self != nil) {
+        _format = format;
+        _recordBlock = [recordBlock copy];
+        _maxPendingRecords = 64;
+        _maxRecordSize = 1024 * 1024;
+        _buffer = [NSMutableData data];
+
+        self.acceptableResponses = @[@200];
+        if (format == BBHTTPRecordStreamFormatServerSentEvents) {
+            self.acceptableContentTypes = @[@"text/event-stream"];
+        } else {
+            self.acceptableContentTypes = @[@"application/x-ndjson", @"application/jsonl", @"application/json"];
+        }
+    }
+
+    return self;
+}
+
+
+#pragma mark BBHTTPSelectiveDiscarder behavior overrides
+
+- (void)willExecuteRequest:(BBHTTPRequest*)request
+{
+    _request = request;
+}
+
+- (BOOL)prepareForResponse:(NSUInteger)statusCode message:(NSString*)message headers:(NSDictionary*)headers
+                      error:(NSError**)error
+{
+    if (![super prepareForResponse:statusCode message:message headers:headers error:error]) return NO;
+
+    [_buffer setLength:0];
+    _recordCount = 0;
+    _atStreamStart = YES;
+    _skipLineFeed = NO;
+
+    _eventType = nil;
+    _eventData = nil;
+    _lastEventIdentifier = nil;
+    _retry = 0;
+
+    return YES;
+}
+
+- (BOOL)isReadyForResponseBytes
+{
+    return (NSUInteger)_pendingRecords < _maxPendingRecords;
+}
+
+- (NSInteger)appendResponseBytes:(uint8_t*)bytes withLength:(NSUInteger)length error:(NSError**)error
+{
+    NSError* parseError = nil;
+
+    if ([_buffer length] == 0) {
+        // Frame straight from the incoming bytes; only the trailing incomplete record gets copied
+        NSUInteger consumed = [self parseRecordsInBytes:bytes length:length error:&parseError];
+        if (parseError == nil) [_buffer appendBytes:(bytes + consumed) length:(length - consumed)];
+
+    } else if ((memchr(bytes, '\n', length) == NULL) && (memchr(bytes, '\r', length) == NULL)) {
+        // Still no end in sight for the record being carried over; no need to scan it all over again
+        [_buffer appendBytes:bytes length:length];
+
+    } else {
+        [_buffer appendBytes:bytes length:length];
+        NSUInteger consumed = [self parseRecordsInBytes:[_buffer mutableBytes] length:[_buffer length]
+                                                  error:&parseError];
+        if (parseError == nil) [_buffer replaceBytesInRange:NSMakeRange(0, consumed) withBytes:NULL length:0];
+    }
+
+    if ((parseError == nil) && ([_buffer length] > _maxRecordSize)) {
+        parseError = BBHTTPErrorWithFormat(BBHTTPErrorCodeResponseTooLarge,
+                                           @"Record exceeds the maximum allowed size (%lub)",
+                                           (unsigned long)_maxRecordSize);
+    }
+
+    if (parseError != nil) {
+        if (error != NULL) *error = parseError;
+        return -1;
+    }
+
+    return length;
+}
+
+- (id)parseContent:(NSError**)error
+{
+    id content = [super parseContent:error];
+
+    // The last NDJSON record may not be newline terminated; an unterminated event, on the other hand, is discarded
+    if ((_format == BBHTTPRecordStreamFormatNDJSON) && ([_buffer length] > 0)) {
+        uint8_t* bytes = [_buffer mutableBytes];
+        NSUInteger length = [_buffer length];
+        NSUInteger start = [self byteOrderMarkLengthInBytes:bytes length:length];
+        if (start == NSNotFound) start = 0; // A truncated BOM; let it fail as the garbage it is
+
+        if (start < length) [self parseLine:(bytes + start) length:(length - start) error:error];
+    }
+
+    [_buffer setLength:0];
+
+    return content;
+}
+
+- (void)cleanup
+{
+    [_buffer setLength:0];
+}
+
+
+#pragma mark Private helpers
+
+- (NSUInteger)parseRecordsInBytes:(uint8_t*)bytes length:(NSUInteger)length error:(NSError**)error
+{
+    // UTF-8 BOM is allowed (and ignored) at the start of event streams; skipped rather than overwritten, since the
+    // bytes may be shared with other handlers (e.g. behind a tee). Nothing is consumed until there's enough to tell.
+    NSUInteger start = [self byteOrderMarkLengthInBytes:bytes length:length];
+    if (start == NSNotFound) return 0;
+
+    if (_skipLineFeed && (start < length)) {
+        if (bytes[start] == '\n') start++;
+        _skipLineFeed = NO;
+    }
+
+    for (NSUInteger i = start; i < length; i++) {
+        if ((bytes[i] != '\r') && (bytes[i] != '\n')) continue;
+
+        if (![self parseLine:(bytes + start) length:(i - start) error:error]) return start;
+
+        // A CR on its own ends the line too; whether a LF follows may only be known with the next chunk
+        if (bytes[i] == '\r') {
+            if (i == (length - 1)) {
+                _skipLineFeed = YES;
+            } else if (bytes[i + 1] == '\n') {
+                i++;
+            }
+        }
+        start = i + 1;
+    }
+
+    return start;
+}
+
+- (NSUInteger)byteOrderMarkLengthInBytes:(uint8_t*)bytes length:(NSUInteger)length
+{
+    if (!_atStreamStart) return 0;
+
+    static const uint8_t bom[] = {0xEF, 0xBB, 0xBF};
+    NSUInteger compared = MIN(length, sizeof(bom));
+    BOOL matches = (memcmp(bytes, bom, compared) == 0);
+
+    // NSNotFound while what's been received so far could still be the start of a BOM
+    if (matches && (compared < sizeof(bom))) return NSNotFound;
+
+    _atStreamStart = NO;
+    return matches ? sizeof(bom) : 0;
+}
+
+- (BOOL)parseLine:(uint8_t*)bytes length:(NSUInteger)length error:(NSError**)error
+{
+    if (_format == BBHTTPRecordStreamFormatServerSentEvents) return [self parseEventLine:bytes length:length];
+
+    if (length == 0) return YES; // Blank lines between records are tolerated
+
+    NSData* line = [NSData dataWithBytesNoCopy:bytes length:length freeWhenDone:NO];
+    id record = [NSJSONSerialization JSONObjectWithData:line options:NSJSONReadingAllowFragments error:error];
+    if (record == nil) return NO;
+
+    // Same treatment as BBJSONParser, allows keypath retrieval via subscript operators
+    if ([record isKindOfClass:[NSDictionary class]]) record = [[BBJSONDictionary alloc] initWithDictionary:record];
+    [self deliverRecord:record];
+
+    return YES;
+}
+
+- (BOOL)parseEventLine:(uint8_t*)bytes length:(NSUInteger)length
+{
+    // Blank line dispatches the event; events without data are dropped, as per spec
+    if (length == 0) {
+        if (_eventData != nil) {
+            NSString* type = ([_eventType length] > 0) ? _eventType : @"message";
+            [self deliverRecord:[[BBHTTPServerSentEvent alloc] initWithType:type data:_eventData
+                                                                 identifier:_lastEventIdentifier retry:_retry]];
+        }
+
+        _eventType = nil;
+        _eventData = nil;
+        return YES;
+    }
+
+    if (bytes[0] == ':') return YES; // Comment
+
+    NSString* line = [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+    if (line == nil) return YES; // Not valid UTF-8, ignore the field
+
+    NSString* field = line;
+    NSString* value = @"";
+    NSRange colon = [line rangeOfString:@":"];
+    if (colon.location != NSNotFound) {
+        field = [line substringToIndex:colon.location];
+        value = [line substringFromIndex:(colon.location + 1)];
+        if ([value hasPrefix:@" "]) value = [value substringFromIndex:1];
+    }
+
+    if ([field isEqualToString:@"data"]) {
+        if (_eventData == nil) {
+            _eventData = [NSMutableString stringWithString:value];
+        } else {
+            [_eventData appendFormat:@"\n%@", value];
+        }
+    } else if ([field isEqualToString:@"event"]) {
+        _eventType = value;
+    } else if ([field isEqualToString:@"id"]) {
+        if ([value rangeOfString:@"\0"].location == NSNotFound) _lastEventIdentifier = value;
+    } else if ([field isEqualToString:@"retry"]) {
+        NSCharacterSet* nonDigits = [[NSCharacterSet decimalDigitCharacterSet] invertedSet];
+        if (([value length] > 0) && ([value rangeOfCharacterFromSet:nonDigits].location == NSNotFound)) {
+            _retry = (NSUInteger)[value integerValue];
+        }
+    } // Other fields are ignored
+
+    return YES;
+}
+
+- (void)deliverRecord:(id)record
+{
+    _recordCount++;
+    if (_recordBlock == nil) return;
+
+    void (^recordBlock)(id record) = _recordBlock;
+    dispatch_block_t delivery = ^{
+        recordBlock(record);
+        OSAtomicDecrement32Barrier(&_pendingRecords);
+    };
+
+    // Records go out the same way as the request's other events, so they're always delivered before it finishes
+    OSAtomicIncrement32Barrier(&_pendingRecords);
+    BBHTTPRequest* request = _request;
+    if (request != nil) {
+        [request dispatchCallback:delivery];
+    } else {
+        dispatch_async(dispatch_get_main_queue(), delivery);
+    }
+}
+
+@end
@@ -0,0 +1,108 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPSelectiveDiscarder.h"
+
+
+
+#pragma mark -
+
+/**
+ Exposes the response body as a stream of bytes that consumers read at their own pace, on their own thread &mdash;
+ much like reading from a file &mdash; rather than having the data pushed to them as it arrives.
+
+ Data flows through a bounded ring buffer sitting between the transfer and the reader. When the buffer fills up to
+ `<highWatermark>`, the transfer is paused; once the reader drains it down to `<lowWatermark>`, it is resumed (within
+ about a second, see `<[BBHTTPContentHandler isReadyForResponseBytes]>`).
+
+ The body can be consumed either by blocking reads, with `<read:maxLength:>`, or asynchronously, by registering a block
+ with `<readChunksOnQueue:withBlock:>`; the two shouldn't be mixed for the same response.
+
+ End of body is only signalled once the request has finished: a transfer that fails midway is reported as an error
+ to the reader, never as a (truncated) end of body.
+ */
+@interface BBHTTPResponseReader : BBHTTPSelectiveDiscarder
+
+
+#pragma mark Creating a new response reader
+
+/**
+ Creates a new reader with the given buffer capacity.
+
+ @param capacity Capacity of the ring buffer, in bytes.
+
+ @return An initialized `BBHTTPResponseReader`, with watermarks at 3/4 and 1/4 of *capacity*.
+ */
+- (instancetype)initWithCapacity:(NSUInteger)capacity;
+
+
+#pragma mark Configuring behavior
+
+/**
+ Amount of buffered data, in bytes, at which the transfer is paused.
+
+ The buffer is never allowed to lose data, so a chunk arriving when the buffer is near capacity (e.g. decompressed
+ content) grows it instead.
+ */
+@property(assign, nonatomic) NSUInteger highWatermark;
+
+/** Amount of buffered data, in bytes, at or below which a paused transfer is resumed. */
+@property(assign, nonatomic) NSUInteger lowWatermark;
+
+
+#pragma mark Reading the response body
+
+/**
+ Reads up to *length* bytes of the response body, blocking until data is available.
+
+ @param buffer The buffer to copy the data into.
+ @param length Size of *buffer*.
+
+ @return The number of bytes read, `0` at end of body or `-1` if the request failed (see `<error>`).
+ */
+- (NSInteger)read:(uint8_t*)buffer maxLength:(NSUInteger)length;
+
+/**
+ Delivers the response body asynchronously, in chunks, as it arrives.
+
+ The block is called serially on *queue* with whatever data is available; the last call has *finished* set to `YES`
+ (its *chunk* holds the last of the data, or is `nil`) and *error* set if the request failed.
+
+ @param queue Queue on which to call *block*; defaults to the main queue if `nil`.
+ @param block Block to call with each chunk.
+ */
+- (void)readChunksOnQueue:(dispatch_queue_t)queue
+                withBlock:(void (^)(NSData* chunk, BOOL finished, NSError* error))block;
+
+/** Stops reading: buffered data is dropped and the request is cancelled. */
+- (void)close;
+
+
+#pragma mark Properties
+
+/** Number of bytes currently buffered. */
+@property(assign, nonatomic, readonly) NSUInteger bufferedBytes;
+/** `YES` once the request has finished, successfully or not. */
+@property(assign, nonatomic, readonly, getter = hasFinished) BOOL finished;
+/** The error with which the request failed, if any. */
+@property(strong, nonatomic, readonly) NSError* error;
+
+@end
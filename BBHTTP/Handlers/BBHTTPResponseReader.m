@@ -0,0 +1,311 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPResponseReader.h"
+
+#import "BBHTTPRequest.h"
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark -
+
+@implementation BBHTTPResponseReader
+{
+    __weak BBHTTPRequest* _request;
+    NSCondition* _condition; // Guards everything below
+
+    uint8_t* _ring;
+    NSUInteger _ringSize;
+    NSUInteger _head;
+    NSUInteger _count;
+    BOOL _paused;
+    BOOL _closed;
+
+    void (^_chunkBlock)(NSData* chunk, BOOL finished, NSError* error);
+    dispatch_queue_t _chunkQueue;
+    BOOL _chunkDeliveryScheduled;
+    BOOL _finishDelivered;
+}
+
+
+#pragma mark Creating a new response reader
+
+- (instancetype)init
+{
+    return [self initWithCapacity:256 * 1024];
+}
+
+- (instancetype)initWithCapacity:(NSUInteger)capacity
+{
+    self = [super init];
+    if (self != nil) {
+        _condition = [[NSCondition alloc] init];
+        _ringSize = MAX(capacity, (NSUInteger)1024);
+        _ring = malloc(_ringSize);
+        _highWatermark = (_ringSize / 4) * 3;
+        _lowWatermark = _ringSize / 4;
+    }
+
+    return self;
+}
+
+
+#pragma mark Destruction
+
+- (void)dealloc
+{
+    free(_ring);
+#if !OS_OBJECT_USE_OBJC
+    if (_chunkQueue != NULL) dispatch_release(_chunkQueue);
+#endif
+}
+
+
+#pragma mark Reading the response body
+
+- (NSInteger)read:(uint8_t*)buffer maxLength:(NSUInteger)length
+{
+    [_condition lock];
+    while ((_count == 0) && !_finished && !_closed) [_condition wait];
+
+    NSInteger read = 0;
+    if (_count > 0) {
+        read = [self takeBytes:buffer maxLength:length];
+    } else if ((_error != nil) || _closed) {
+        read = -1;
+    }
+    [_condition unlock];
+
+    return read;
+}
+
+- (void)readChunksOnQueue:(dispatch_queue_t)queue
+                withBlock:(void (^)(NSData* chunk, BOOL finished, NSError* error))block
+{
+    if (queue == NULL) queue = dispatch_get_main_queue();
+
+    [_condition lock];
+#if !OS_OBJECT_USE_OBJC
+    dispatch_retain(queue);
+    if (_chunkQueue != NULL) dispatch_release(_chunkQueue);
+#endif
+    _chunkQueue = queue;
+    _chunkBlock = [block copy];
+    [self scheduleChunkDelivery];
+    [_condition unlock];
+}
+
+- (void)close
+{
+    [_condition lock];
+    _closed = YES;
+    _head = 0;
+    _count = 0;
+    [_condition broadcast];
+    [_condition unlock];
+
+    [_request cancel];
+}
+
+
+#pragma mark BBHTTPSelectiveDiscarder behavior overrides
+
+- (void)willExecuteRequest:(BBHTTPRequest*)request
+{
+    _request = request;
+
+    [_condition lock];
+    _finished = NO;
+    _error = nil;
+    _closed = NO;
+    _finishDelivered = NO;
+    [_condition unlock];
+}
+
+- (BOOL)prepareForResponse:(NSUInteger)statusCode message:(NSString*)message headers:(NSDictionary*)headers
+                      error:(NSError**)error
+{
+    if (![super prepareForResponse:statusCode message:message headers:headers error:error]) return NO;
+
+    [_condition lock];
+    _head = 0;
+    _count = 0;
+    _paused = NO;
+    [_condition unlock];
+
+    return YES;
+}
+
+- (BOOL)isReadyForResponseBytes
+{
+    [_condition lock];
+    if (_paused) {
+        if ((_count <= _lowWatermark) || _closed) _paused = NO;
+    } else if ((_count >= _highWatermark) && !_closed) {
+        _paused = YES;
+    }
+    BOOL ready = !_paused;
+    [_condition unlock];
+
+    return ready;
+}
+
+- (NSInteger)appendResponseBytes:(uint8_t*)bytes withLength:(NSUInteger)length error:(NSError**)error
+{
+    [_condition lock];
+    if (!_closed) {
+        [self ensureCapacity:(_count + length)];
+
+        NSUInteger tail = (_head + _count) % _ringSize;
+        NSUInteger firstPart = MIN(length, _ringSize - tail);
+        memcpy(_ring + tail, bytes, firstPart);
+        memcpy(_ring, bytes + firstPart, length - firstPart);
+        _count += length;
+
+        [_condition broadcast];
+        [self scheduleChunkDelivery];
+    }
+    [_condition unlock];
+
+    return length;
+}
+
+- (id)parseContent:(NSError**)error
+{
+    // The request may still fail after the body has been read; end of body is only signalled on cleanup
+    return nil;
+}
+
+- (void)requestFailedWithError:(NSError*)error
+{
+    [self finishWithError:error];
+}
+
+- (void)cleanup
+{
+    [self finishWithError:nil];
+}
+
+
+#pragma mark Properties
+
+- (NSUInteger)bufferedBytes
+{
+    [_condition lock];
+    NSUInteger count = _count;
+    [_condition unlock];
+
+    return count;
+}
+
+
+#pragma mark Private helpers
+
+// The methods below must be called with the lock held.
+
+- (void)ensureCapacity:(NSUInteger)capacity
+{
+    if (capacity <= _ringSize) return;
+
+    NSUInteger newSize = MAX(_ringSize * 2, capacity);
+    uint8_t* ring = malloc(newSize);
+    NSUInteger count = _count;
+    [self takeBytes:ring maxLength:count]; // Linearizes the contents at the start of the new buffer
+    free(_ring);
+
+    _ring = ring;
+    _ringSize = newSize;
+    _head = 0;
+    _count = count;
+}
+
+- (NSInteger)takeBytes:(uint8_t*)buffer maxLength:(NSUInteger)length
+{
+    NSUInteger read = MIN(length, _count);
+    NSUInteger firstPart = MIN(read, _ringSize - _head);
+    memcpy(buffer, _ring + _head, firstPart);
+    memcpy(buffer + firstPart, _ring, read - firstPart);
+
+    _head = (_head + read) % _ringSize;
+    _count -= read;
+    if (_count == 0) _head = 0;
+
+    return read;
+}
+
+- (void)finishWithError:(NSError*)error
+{
+    [_condition lock];
+    if (!_finished) {
+        _finished = YES;
+        _error = error;
+        [_condition broadcast];
+        [self scheduleChunkDelivery];
+    }
+    [_condition unlock];
+}
+
+- (void)scheduleChunkDelivery
+{
+    if ((_chunkBlock == nil) || _chunkDeliveryScheduled || _finishDelivered) return;
+    if ((_count == 0) && !_finished) return;
+
+    _chunkDeliveryScheduled = YES;
+    dispatch_async(_chunkQueue, ^{
+        [self deliverChunks];
+    });
+}
+
+- (void)deliverChunks
+{
+    void (^block)(NSData* chunk, BOOL finished, NSError* error) = nil;
+
+    for (;;) {
+        [_condition lock];
+        NSMutableData* chunk = nil;
+        if (_count > 0) {
+            chunk = [NSMutableData dataWithLength:_count];
+            [self takeBytes:[chunk mutableBytes] maxLength:_count];
+        }
+
+        BOOL finished = _finished && !_closed;
+        NSError* error = _error;
+        block = _chunkBlock;
+
+        if ((chunk == nil) && !finished) {
+            _chunkDeliveryScheduled = NO;
+            [_condition unlock];
+            return;
+        }
+
+        if (finished) {
+            _finishDelivered = YES;
+            _chunkDeliveryScheduled = NO;
+        }
+        [_condition unlock];
+
+        block(chunk, finished, error);
+        if (finished) return;
+    }
+}
+
+@end
@@ -34,7 +34,8 @@
  If an error occurs while transferring data to the output stream, the stream will be closed.
  When processing ends, the stream will be closed.
  
- If the stream does not have enough space available, the request will fail.
+ If the stream does not have enough space available, the data it can't take is buffered (up to
+ `<maxBufferedBytes>`) and the transfer is paused until the stream catches up, instead of failing the request.
  */
 @interface BBHTTPStreamWriter : BBHTTPSelectiveDiscarder
 
@@ -43,4 +44,20 @@
 
 - (instancetype)initWithOutputStream:(NSOutputStream*)stream;
 
+
+#pragma mark Configuring behavior
+
+/**
+ Amount of response data, in bytes, that can be held back while the output stream has no space available; once this
+ many bytes are pending, the transfer is paused until the stream drains them.
+
+ A single chunk may overshoot this limit, so actual memory usage can exceed it by the size of one (decoded) chunk.
+
+ Setting this to `0` disables buffering, restoring the strict behavior: the request fails as soon as the stream can't
+ take all the data it's offered.
+
+ Defaults to 1MB.
+ */
+@property(assign, nonatomic) NSUInteger maxBufferedBytes;
+
 @end
@@ -21,6 +21,8 @@
 
 #import "BBHTTPStreamWriter.h"
 
+#import "BBHTTPUtils.h"
+
 
 
 #pragma mark -
@@ -28,6 +30,7 @@
 @implementation BBHTTPStreamWriter
 {
     NSOutputStream* _stream;
+    NSMutableData* _pending; // Data the stream had no space for, yet
 }
 
 
@@ -36,7 +39,11 @@
 - (instancetype)initWithOutputStream:(NSOutputStream*)stream
 {
     self = [super init];
-    if (self != nil) _stream = stream;
+    if (self != nil) {
+        _stream = stream;
+        _pending = [NSMutableData data];
+        _maxBufferedBytes = 1024 * 1024;
+    }
 
     return self;
 }
@@ -50,22 +57,61 @@
     if (![super prepareForResponse:statusCode message:message headers:headers error:error]) return NO;
 
     if ([_stream streamStatus] != NSStreamStatusOpen) [_stream open];
+    [_pending setLength:0];
 
     return YES;
 }
 
+- (BOOL)isReadyForResponseBytes
+{
+    if (_maxBufferedBytes == 0) return YES;
+
+    [self drainPendingData:NO];
+    // A failed stream is never going to catch up; let the data through so the failure surfaces
+    return ([_pending length] < _maxBufferedBytes) || [self hasStreamFailed];
+}
+
 - (NSInteger)appendResponseBytes:(uint8_t*)bytes withLength:(NSUInteger)length error:(NSError**)error
 {
-    NSInteger written = [_stream write:bytes maxLength:length];
-    if (written <= 0) [_stream close];
-    if ((written < 0) && (error != NULL)) *error = [_stream streamError];
+    if (_maxBufferedBytes == 0) {
+        NSInteger written = [_stream write:bytes maxLength:length];
+        if (written <= 0) [_stream close];
+        if ((written < 0) && (error != NULL)) *error = [_stream streamError];
+
+        return written;
+    }
 
-    return written;
+    // Data must reach the stream in order, so nothing new can be written before the backlog is gone
+    NSInteger written = 0;
+    if ([self drainPendingData:NO]) written = [self writeBytes:bytes withLength:length blocking:NO];
+
+    if ((written < 0) || [self hasStreamFailed]) {
+        [_stream close];
+        if (error != NULL) *error = [_stream streamError];
+        return -1;
+    }
+
+    // Whatever didn't fit is held back; the executor pauses the transfer once the backlog grows past the limit
+    if ((NSUInteger)written < length) [_pending appendBytes:(bytes + written) length:(length - written)];
+
+    return length;
 }
 
 - (id)parseContent:(NSError**)error
 {
-    if (([_stream streamError] != nil) && (error != NULL)) *error = [_stream streamError];
+    // Last chance for the stream to take the backlog, wait for it
+    [self drainPendingData:YES];
+
+    // Whatever the stream didn't take is lost, and so is the body
+    NSError* streamError = [_stream streamError];
+    if ((streamError == nil) && ([_pending length] > 0)) {
+        streamError = BBHTTPErrorWithReason(BBHTTPErrorCodeDownloadCannotWriteToHandler,
+                                            @"Error handling response content",
+                                            @"Output stream stopped accepting data before content was fully written.");
+    }
+    [_pending setLength:0];
+
+    if ((streamError != nil) && (error != NULL)) *error = streamError;
     if ([_stream streamStatus] != NSStreamStatusClosed) [_stream close];
 
     // There's never anything to return here, this parser merely pumps data to the output stream.
@@ -74,7 +120,45 @@
 
 - (void)cleanup
 {
+    [_pending setLength:0];
     if ([_stream streamStatus] != NSStreamStatusClosed) [_stream close];
 }
 
+
+#pragma mark Private helpers
+
+- (BOOL)hasStreamFailed
+{
+    NSStreamStatus status = [_stream streamStatus];
+    return (status == NSStreamStatusAtEnd) || (status == NSStreamStatusClosed) || (status == NSStreamStatusError);
+}
+
+- (NSInteger)writeBytes:(uint8_t*)bytes withLength:(NSUInteger)length blocking:(BOOL)blocking
+{
+    NSUInteger total = 0;
+    while ((total < length) && (blocking || [_stream hasSpaceAvailable])) {
+        NSInteger written = [_stream write:(bytes + total) maxLength:(length - total)];
+        if (written < 0) return -1;
+        if (written == 0) break;
+
+        total += written;
+    }
+
+    return total;
+}
+
+- (BOOL)drainPendingData:(BOOL)blocking
+{
+    if ([_pending length] == 0) return YES;
+
+    NSInteger written = [self writeBytes:[_pending mutableBytes] withLength:[_pending length] blocking:blocking];
+    if (written < 0) {
+        [_pending setLength:0];
+        return NO;
+    }
+
+    [_pending replaceBytesInRange:NSMakeRange(0, written) withBytes:NULL length:0];
+    return [_pending length] == 0;
+}
+
 @end
@@ -0,0 +1,63 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#pragma mark -
+
+/**
+ Collects callbacks aimed at a queue and runs them in batches, with a single `dispatch_async` per batch, rather than
+ one per callback.
+
+ There's one batcher per target queue, shared by all the requests delivering their callbacks to that queue. Callbacks
+ run in the order they were added. Batchers are only kept around while they have callbacks to deliver.
+ */
+@interface BBHTTPCallbackBatcher : NSObject
+
+
+#pragma mark Obtaining a batcher
+
+///--------------------------
+/// @name Obtaining a batcher
+///--------------------------
+
+/**
+ Returns the batcher for a queue, creating it if needed.
+
+ @param queue The queue on which the callbacks will run.
+
+ @return The batcher for *queue*.
+ */
++ (instancetype)batcherForQueue:(dispatch_queue_t)queue;
+
+
+#pragma mark Adding callbacks
+
+///-----------------------
+/// @name Adding callbacks
+///-----------------------
+
+/**
+ Adds a callback to the next batch; if no batch is pending, one is dispatched to the queue.
+
+ @param block The callback.
+ */
+- (void)addCallback:(dispatch_block_t)block;
+
+@end
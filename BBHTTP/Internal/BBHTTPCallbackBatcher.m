@@ -0,0 +1,150 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPCallbackBatcher.h"
+
+#import <pthread.h>
+
+
+
+#pragma mark - Registry
+
+static NSMutableDictionary* BBHTTPCallbackBatchers(void)
+{
+    static NSMutableDictionary* batchers = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        batchers = [NSMutableDictionary dictionary];
+    });
+
+    return batchers;
+}
+
+
+
+#pragma mark -
+
+@implementation BBHTTPCallbackBatcher
+{
+    dispatch_queue_t _queue;
+    NSValue* _key;
+    pthread_mutex_t _lock;
+    NSMutableArray* _pending;
+    BOOL _batchScheduled;
+}
+
+
+#pragma mark Obtaining a batcher
+
++ (instancetype)batcherForQueue:(dispatch_queue_t)queue
+{
+    NSMutableDictionary* batchers = BBHTTPCallbackBatchers();
+
+    // Batchers retain their queue, so the pointer can't be reused by another queue while it's a key
+    BBHTTPCallbackBatcher* batcher;
+    @synchronized (batchers) {
+        batcher = batchers[[NSValue valueWithPointer:(__bridge const void*)queue]];
+        if (batcher == nil) {
+            batcher = [[self alloc] initWithQueue:queue];
+            batchers[batcher->_key] = batcher;
+        }
+    }
+
+    return batcher;
+}
+
+
+#pragma mark Creation
+
+- (instancetype)initWithQueue:(dispatch_queue_t)queue
+{
+    self = [super init];
+    if (self != nil) {
+#if !OS_OBJECT_USE_OBJC
+        dispatch_retain(queue);
+#endif
+        _queue = queue;
+        _key = [NSValue valueWithPointer:(__bridge const void*)queue];
+        pthread_mutex_init(&_lock, NULL);
+        _pending = [NSMutableArray array];
+    }
+
+    return self;
+}
+
+
+#pragma mark Destruction
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_lock);
+#if !OS_OBJECT_USE_OBJC
+    dispatch_release(_queue);
+#endif
+}
+
+
+#pragma mark Adding callbacks
+
+- (void)addCallback:(dispatch_block_t)block
+{
+    pthread_mutex_lock(&_lock);
+    [_pending addObject:[block copy]];
+    BOOL schedule = !_batchScheduled;
+    _batchScheduled = YES;
+    pthread_mutex_unlock(&_lock);
+
+    if (schedule) {
+        dispatch_async(_queue, ^{
+            [self runBatch];
+        });
+    }
+}
+
+
+#pragma mark Private helpers
+
+- (void)runBatch
+{
+    // Callbacks added while this batch runs go into the next one
+    pthread_mutex_lock(&_lock);
+    NSArray* batch = _pending;
+    _pending = [NSMutableArray arrayWithCapacity:[batch count]];
+    _batchScheduled = NO;
+    pthread_mutex_unlock(&_lock);
+
+    for (dispatch_block_t block in batch) {
+        block();
+    }
+
+    // Nothing left to deliver; drop the batcher (and its hold on the queue) until the queue is used again. Callbacks
+    // still added to it get delivered all the same, it just won't be handed out anymore.
+    NSMutableDictionary* batchers = BBHTTPCallbackBatchers();
+    @synchronized (batchers) {
+        pthread_mutex_lock(&_lock);
+        BOOL idle = !_batchScheduled;
+        pthread_mutex_unlock(&_lock);
+
+        if (idle && (batchers[_key] == self)) [batchers removeObjectForKey:_key];
+    }
+}
+
+@end
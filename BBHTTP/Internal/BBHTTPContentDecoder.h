@@ -0,0 +1,124 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#pragma mark -
+
+/**
+ Streaming decoder for compressed response bodies (`Content-Encoding: gzip` and `Content-Encoding: deflate`).
+
+ Compressed bytes are fed through `<decodeBytes:withLength:toBlock:error:>` as they arrive and decoded output is handed
+ back in chunks of at most `kBBHTTPContentDecoderChunkSize` bytes, so the full body is never held in memory.
+ */
+@interface BBHTTPContentDecoder : NSObject
+
+
+#pragma mark Querying supported encodings
+
+///-----------------------------------
+/// @name Querying supported encodings
+///-----------------------------------
+
+/** Value for the `Accept-Encoding` header, listing all the encodings this decoder supports. */
++ (NSString*)acceptedEncodings;
+
+/**
+ Tests whether a `Content-Encoding` header value can be decoded.
+
+ @param encoding The value of the `Content-Encoding` header.
+
+ @return `YES` if *encoding* is supported, `NO` otherwise (including `nil` or `identity`).
+ */
++ (BOOL)supportsEncoding:(NSString*)encoding;
+
+
+#pragma mark Creating a decoder
+
+///-------------------------
+/// @name Creating a decoder
+///-------------------------
+
+/**
+ Creates a new decoder for the given content encoding.
+
+ @param encoding The value of the `Content-Encoding` header.
+
+ @return An initialized decoder, or `nil` if the encoding is not supported.
+ */
+- (instancetype)initWithEncoding:(NSString*)encoding;
+
+
+#pragma mark Decoding content
+
+///-----------------------
+/// @name Decoding content
+///-----------------------
+
+/**
+ Decodes a chunk of compressed content.
+
+ @param bytes Compressed bytes.
+ @param length Number of compressed bytes.
+ @param block Block that receives each chunk of decoded bytes; must return `NO` to stop decoding.
+ @param error On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object
+ containing the error information. You may specify nil for this parameter if you do not want the error information.
+
+ @return `YES` if all the bytes were decoded and accepted by *block*, `NO` otherwise.
+ */
+- (BOOL)decodeBytes:(uint8_t*)bytes withLength:(NSUInteger)length
+            toBlock:(BOOL (^)(uint8_t* decoded, NSUInteger decodedLength))block error:(NSError**)error;
+
+/**
+ Decodes a chunk of compressed content, handing decoded output over as `NSData` instances.
+
+ Unlike `<decodeBytes:withLength:toBlock:error:>`, each chunk is inflated straight into its own buffer, which the
+ `NSData` takes ownership of; receivers can keep the chunks around without copying them.
+
+ @param bytes Compressed bytes.
+ @param length Number of compressed bytes.
+ @param block Block that receives each chunk of decoded content; must return `NO` to stop decoding.
+ @param error On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object
+ containing the error information. You may specify nil for this parameter if you do not want the error information.
+
+ @return `YES` if all the bytes were decoded and accepted by *block*, `NO` otherwise.
+ */
+- (BOOL)decodeBytes:(uint8_t*)bytes withLength:(NSUInteger)length
+        toDataBlock:(BOOL (^)(NSData* decoded))block error:(NSError**)error;
+
+/**
+ Signals the end of the compressed content.
+
+ @param error On input, a pointer to an error object. If the compressed content was truncated, this pointer is set to an
+ actual error object. You may specify nil for this parameter if you do not want the error information.
+
+ @return `YES` if the compressed content was complete, `NO` otherwise.
+ */
+- (BOOL)finish:(NSError**)error;
+
+/** The encoding this decoder was created with, normalized to lowercase. */
+@property(copy, nonatomic, readonly) NSString* encoding;
+
+/** Number of compressed bytes fed to the decoder so far. */
+@property(assign, nonatomic, readonly) NSUInteger encodedBytes;
+
+/** Number of decoded bytes produced by the decoder so far. */
+@property(assign, nonatomic, readonly) NSUInteger decodedBytes;
+
+@end
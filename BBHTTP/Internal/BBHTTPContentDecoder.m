@@ -0,0 +1,244 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPContentDecoder.h"
+
+#import <zlib.h>
+
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark - Constants
+
+#define kBBHTTPContentDecoderChunkSize 16384
+
+// Window bits for inflateInit2(); adding 32 enables automatic zlib/gzip header detection.
+#define kBBHTTPContentDecoderAutoDetectWindowBits (MAX_WBITS + 32)
+// Negative window bits make inflate() expect a raw deflate stream, without any headers.
+#define kBBHTTPContentDecoderRawDeflateWindowBits (-MAX_WBITS)
+
+
+
+#pragma mark -
+
+@implementation BBHTTPContentDecoder
+{
+    z_stream _stream;
+    BOOL _streamInitialized;
+    BOOL _streamEnded;
+    BOOL _rawDeflate;
+    uint8_t _header[2]; // Leading bytes of 'deflate' content, held back until the zlib header can be checked
+    NSUInteger _headerLength;
+    uint8_t _buffer[kBBHTTPContentDecoderChunkSize];
+}
+
+
+#pragma mark Querying supported encodings
+
++ (NSString*)acceptedEncodings
+{
+    return @"gzip, deflate";
+}
+
++ (BOOL)supportsEncoding:(NSString*)encoding
+{
+    if (encoding == nil) return NO;
+
+    NSString* normalized = [[encoding stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]]
+                            lowercaseString];
+
+    return [normalized isEqualToString:@"gzip"] ||
+           [normalized isEqualToString:@"x-gzip"] ||
+           [normalized isEqualToString:@"deflate"];
+}
+
+
+#pragma mark Creating a decoder
+
+- (instancetype)init
+{
+    NSAssert(NO, @"please use initWithEncoding: instead");
+    return nil;
+}
+
+- (instancetype)initWithEncoding:(NSString*)encoding
+{
+    if (![[self class] supportsEncoding:encoding]) return nil;
+
+    self = [super init];
+    if (self != nil) {
+        _encoding = [[encoding stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]]
+                     lowercaseString];
+
+        memset(&_stream, 0, sizeof(z_stream));
+        if (inflateInit2(&_stream, kBBHTTPContentDecoderAutoDetectWindowBits) != Z_OK) {
+            BBHTTPLogError(@"[%@] inflateInit2() failed: %s", self, _stream.msg);
+            return nil;
+        }
+        _streamInitialized = YES;
+    }
+
+    return self;
+}
+
+
+#pragma mark Destruction
+
+- (void)dealloc
+{
+    if (_streamInitialized) inflateEnd(&_stream);
+}
+
+
+#pragma mark Decoding content
+
+- (BOOL)decodeBytes:(uint8_t*)bytes withLength:(NSUInteger)length
+            toBlock:(BOOL (^)(uint8_t* decoded, NSUInteger decodedLength))block error:(NSError**)error
+{
+    return [self decodeBytes:bytes withLength:length intoOwnedChunks:NO toBlock:block error:error];
+}
+
+- (BOOL)decodeBytes:(uint8_t*)bytes withLength:(NSUInteger)length
+        toDataBlock:(BOOL (^)(NSData* decoded))block error:(NSError**)error
+{
+    return [self decodeBytes:bytes withLength:length intoOwnedChunks:YES
+                     toBlock:^BOOL(uint8_t* decoded, NSUInteger decodedLength) {
+        // Give back the unused tail of partially filled chunks; shrinking is usually done in place
+        if (decodedLength < kBBHTTPContentDecoderChunkSize) {
+            uint8_t* shrunk = realloc(decoded, decodedLength);
+            if (shrunk != NULL) decoded = shrunk;
+        }
+
+        return block([NSData dataWithBytesNoCopy:decoded length:decodedLength freeWhenDone:YES]);
+    } error:error];
+}
+
+- (BOOL)finish:(NSError**)error
+{
+    // An empty body (e.g. 204 or HEAD) is not an error, even if the server tagged it with a content encoding.
+    if (_streamEnded || (_encodedBytes == 0)) return YES;
+
+    if (error != NULL) {
+        *error = BBHTTPErrorWithReason(BBHTTPErrorCodeContentDecodingFailed,
+                                       @"Error decoding response content",
+                                       @"Compressed response content ended prematurely.");
+    }
+
+    return NO;
+}
+
+
+#pragma mark Private helpers
+
+// With owned chunks, each chunk of output is inflated straight into a new buffer, which *block* takes ownership of
+- (BOOL)decodeBytes:(uint8_t*)bytes withLength:(NSUInteger)length intoOwnedChunks:(BOOL)ownedChunks
+            toBlock:(BOOL (^)(uint8_t* decoded, NSUInteger decodedLength))block error:(NSError**)error
+{
+    if (length == 0) return YES;
+
+    if (_streamEnded) {
+        // Some servers pad the compressed stream; anything after the end of the stream is ignored.
+        BBHTTPLogTrace(@"[%@] Ignoring %lub received after end of compressed stream.", self, (unsigned long)length);
+        return YES;
+    }
+
+    BOOL awaitingHeader = [_encoding isEqualToString:@"deflate"] && (_encodedBytes < sizeof(_header));
+    _encodedBytes += length;
+    if (!awaitingHeader) return [self inflateBytes:bytes withLength:length intoOwnedChunks:ownedChunks toBlock:block
+                                             error:error];
+
+    // 'deflate' is supposed to be zlib-wrapped but plenty of servers send a raw deflate stream instead; the first two
+    // bytes tell them apart, however the content happens to be split into chunks
+    NSUInteger taken = MIN(length, sizeof(_header) - _headerLength);
+    memcpy(_header + _headerLength, bytes, taken);
+    _headerLength += taken;
+    if (_headerLength < sizeof(_header)) return YES;
+
+    BOOL zlibWrapped = ((_header[0] & 0x0f) == Z_DEFLATED) && ((((_header[0] << 8) | _header[1]) % 31) == 0);
+    if (!zlibWrapped) {
+        BBHTTPLogDebug(@"[%@] Content is not zlib-wrapped; decoding as raw deflate.", self);
+        _rawDeflate = YES;
+        inflateReset2(&_stream, kBBHTTPContentDecoderRawDeflateWindowBits);
+    }
+
+    return [self inflateBytes:_header withLength:sizeof(_header) intoOwnedChunks:ownedChunks toBlock:block
+                        error:error] &&
+           [self inflateBytes:(bytes + taken) withLength:(length - taken) intoOwnedChunks:ownedChunks toBlock:block
+                        error:error];
+}
+
+- (BOOL)inflateBytes:(uint8_t*)bytes withLength:(NSUInteger)length intoOwnedChunks:(BOOL)ownedChunks
+             toBlock:(BOOL (^)(uint8_t* decoded, NSUInteger decodedLength))block error:(NSError**)error
+{
+    if ((length == 0) || _streamEnded) return YES;
+
+    _stream.next_in = bytes;
+    _stream.avail_in = (uInt)length;
+
+    do {
+        uint8_t* output = ownedChunks ? malloc(kBBHTTPContentDecoderChunkSize) : _buffer;
+        _stream.next_out = output;
+        _stream.avail_out = kBBHTTPContentDecoderChunkSize;
+
+        int result = inflate(&_stream, Z_NO_FLUSH);
+        NSUInteger decodedLength = kBBHTTPContentDecoderChunkSize - _stream.avail_out;
+        if (ownedChunks && (decodedLength == 0)) free(output);
+
+        if ((result != Z_OK) && (result != Z_STREAM_END) && (result != Z_BUF_ERROR)) {
+            if (ownedChunks && (decodedLength > 0)) free(output);
+            if (error != NULL) {
+                NSString* reason = (_stream.msg == NULL) ?
+                                   [NSString stringWithFormat:@"inflate() failed with code %d.", result] :
+                                   [NSString stringWithUTF8String:_stream.msg];
+                *error = BBHTTPErrorWithReason(BBHTTPErrorCodeContentDecodingFailed,
+                                               @"Error decoding response content", reason);
+            }
+            return NO;
+        }
+
+        if (decodedLength > 0) {
+            _decodedBytes += decodedLength;
+            if (!block(output, decodedLength)) return NO;
+        }
+
+        if (result == Z_STREAM_END) {
+            _streamEnded = YES;
+            break;
+        }
+
+        // No progress possible without more input
+        if (result == Z_BUF_ERROR) break;
+
+    } while ((_stream.avail_in > 0) || (_stream.avail_out == 0));
+
+    return YES;
+}
+
+
+#pragma mark Debug
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"%@{%@}", NSStringFromClass([self class]), _encoding];
+}
+
+@end
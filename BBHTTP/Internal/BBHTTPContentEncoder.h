@@ -0,0 +1,86 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#pragma mark -
+
+/**
+ Streaming `gzip` encoder for request bodies.
+
+ Raw bytes are pulled from an input stream and compressed directly into the buffer supplied by libcurl's read callback,
+ so the compressed body is never fully held in memory. Since the compressed size cannot be known beforehand, requests
+ using this encoder must be sent with chunked transfer encoding.
+ */
+@interface BBHTTPContentEncoder : NSObject
+
+
+#pragma mark Creating an encoder
+
+///--------------------------
+/// @name Creating an encoder
+///--------------------------
+
+/**
+ Creates a new encoder with the given compression level.
+
+ @param level Compression level, from 1 (fastest) to 9 (smallest output); values out of range are clamped.
+
+ @return An initialized encoder.
+ */
+- (instancetype)initWithCompressionLevel:(NSUInteger)level;
+
+
+#pragma mark Encoding content
+
+///-----------------------
+/// @name Encoding content
+///-----------------------
+
+/**
+ Reads raw bytes from *stream* and writes compressed bytes to *buffer*.
+
+ Returns as soon as some compressed output is available and the bytes read so far have been consumed, to avoid
+ stalling the transfer on slow streams.
+
+ @param stream Input stream from which raw content is read.
+ @param buffer Buffer to which compressed content is written.
+ @param limit Capacity of *buffer*.
+ @param error On input, a pointer to an error object. If an error occurs, this pointer is set to an actual error object
+ containing the error information. You may specify nil for this parameter if you do not want the error information.
+
+ @return The number of compressed bytes written to *buffer*, `0` when the compressed content has been fully written or
+ `-1` on error.
+ */
+- (NSInteger)readFromStream:(NSInputStream*)stream intoBuffer:(uint8_t*)buffer limit:(NSUInteger)limit
+                      error:(NSError**)error;
+
+/** Value for the `Content-Encoding` header of requests using this encoder. */
+@property(copy, nonatomic, readonly) NSString* encoding;
+
+/** Number of raw bytes read from the input stream so far. */
+@property(assign, nonatomic, readonly) NSUInteger consumedBytes;
+
+/** Number of compressed bytes produced so far. */
+@property(assign, nonatomic, readonly) NSUInteger encodedBytes;
+
+/** Flag that signals whether the input was fully read and all the compressed content has been produced. */
+@property(assign, nonatomic, readonly, getter = isFinished) BOOL finished;
+
+@end
@@ -0,0 +1,148 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPContentEncoder.h"
+
+#import <zlib.h>
+
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark - Constants
+
+#define kBBHTTPContentEncoderChunkSize 16384
+
+// Window bits for deflateInit2(); adding 16 produces a gzip wrapper instead of a zlib one.
+#define kBBHTTPContentEncoderGzipWindowBits (MAX_WBITS + 16)
+#define kBBHTTPContentEncoderMemLevel       8
+#define kBBHTTPContentEncoderDefaultLevel   6
+
+
+
+#pragma mark -
+
+@implementation BBHTTPContentEncoder
+{
+    z_stream _stream;
+    BOOL _streamInitialized;
+    BOOL _inputEnded;
+    uint8_t _buffer[kBBHTTPContentEncoderChunkSize];
+}
+
+
+#pragma mark Creating an encoder
+
+- (instancetype)init
+{
+    return [self initWithCompressionLevel:kBBHTTPContentEncoderDefaultLevel];
+}
+
+- (instancetype)initWithCompressionLevel:(NSUInteger)level
+{
+    self = [super init];
+    if (self != nil) {
+        _encoding = HV(Gzip);
+
+        int zlibLevel = (int)MAX((NSUInteger)Z_BEST_SPEED, MIN((NSUInteger)Z_BEST_COMPRESSION, level));
+
+        memset(&_stream, 0, sizeof(z_stream));
+        if (deflateInit2(&_stream, zlibLevel, Z_DEFLATED, kBBHTTPContentEncoderGzipWindowBits,
+                         kBBHTTPContentEncoderMemLevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+            BBHTTPLogError(@"[%@] deflateInit2() failed: %s", self, _stream.msg);
+            return nil;
+        }
+        _streamInitialized = YES;
+    }
+
+    return self;
+}
+
+
+#pragma mark Destruction
+
+- (void)dealloc
+{
+    if (_streamInitialized) deflateEnd(&_stream);
+}
+
+
+#pragma mark Encoding content
+
+- (NSInteger)readFromStream:(NSInputStream*)stream intoBuffer:(uint8_t*)buffer limit:(NSUInteger)limit
+                      error:(NSError**)error
+{
+    if (_finished || (limit == 0)) return 0;
+
+    _stream.next_out = buffer;
+    _stream.avail_out = (uInt)limit;
+
+    while (_stream.avail_out > 0) {
+        if ((_stream.avail_in == 0) && !_inputEnded) {
+            NSInteger read = [stream read:_buffer maxLength:kBBHTTPContentEncoderChunkSize];
+            if (read < 0) {
+                if (error != NULL) *error = [stream streamError];
+                return -1;
+            }
+
+            if (read == 0) {
+                _inputEnded = YES;
+            } else {
+                _consumedBytes += read;
+                _stream.next_in = _buffer;
+                _stream.avail_in = (uInt)read;
+            }
+        }
+
+        int result = deflate(&_stream, _inputEnded ? Z_FINISH : Z_NO_FLUSH);
+        if (result == Z_STREAM_END) {
+            _finished = YES;
+            break;
+        }
+
+        if (result == Z_STREAM_ERROR) {
+            if (error != NULL) {
+                *error = BBHTTPErrorWithReason(BBHTTPErrorCodeUploadDataStreamError,
+                                               @"Couldn't compress upload",
+                                               @"deflate() failed due to an inconsistent stream state.");
+            }
+            return -1;
+        }
+
+        // Hand over whatever is ready rather than blocking on the input stream for more
+        if ((_stream.avail_in == 0) && (_stream.avail_out < limit)) break;
+    }
+
+    NSUInteger encoded = limit - _stream.avail_out;
+    _encodedBytes += encoded;
+
+    return encoded;
+}
+
+
+#pragma mark Debug
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"%@{%@}", NSStringFromClass([self class]), _encoding];
+}
+
+@end
@@ -0,0 +1,91 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#pragma mark -
+
+/**
+ Thread-safe record of how the hosts an executor uploads to deal with `Expect: 100-Continue`, used to decide whether
+ uploads to a host should wait for a `100-Continue` and for how long.
+
+ Hosts are identified by scheme, host name and port. A host that accepted an upload (answered it with a 2xx) or that
+ repeatedly failed to send a `100-Continue` skips the handshake altogether; any other host gets the default wait, or
+ twice as long as its `100-Continue` took the last few times, whichever is longer. A host that turns down an upload
+ with a 4xx or 5xx no longer counts as accepting uploads.
+ */
+@interface BBHTTPExpectationTracker : NSObject
+
+
+#pragma mark Querying hosts
+
+///---------------------
+/// @name Querying hosts
+///---------------------
+
+/**
+ Whether uploads to the host of a URL should be sent without `Expect: 100-Continue`.
+
+ @param url A URL on the host.
+
+ @return `YES` if the host is known to accept uploads or to ignore `100-Continue`, `NO` otherwise.
+ */
+- (BOOL)shouldSkip100ContinueForURL:(NSURL*)url;
+
+/**
+ Time, in milliseconds, that uploads to the host of a URL should wait for a `100-Continue`.
+
+ @param url A URL on the host.
+ @param timeout The wait for hosts with no recorded `100-Continue` latency; `0` means waiting indefinitely.
+
+ @return *timeout*, or a longer wait if the host is known to take longer than that to send a `100-Continue`.
+ */
+- (NSUInteger)wait100ContinueForURL:(NSURL*)url withTimeout:(NSUInteger)timeout;
+
+
+#pragma mark Recording outcomes
+
+///-------------------------
+/// @name Recording outcomes
+///-------------------------
+
+/**
+ Records that the host of a URL sent a `100-Continue`.
+
+ @param url A URL on the host.
+ @param latency Time, in milliseconds, between sending the request and receiving the `100-Continue`.
+ */
+- (void)record100ContinueForURL:(NSURL*)url latency:(NSUInteger)latency;
+
+/**
+ Records that the host of a URL didn't send a `100-Continue` in time.
+
+ @param url A URL on the host.
+ */
+- (void)recordMissing100ContinueForURL:(NSURL*)url;
+
+/**
+ Records the final response status of an upload to the host of a URL.
+
+ @param url A URL on the host.
+ @param code The final response status code.
+ */
+- (void)recordUploadToURL:(NSURL*)url withStatusCode:(NSUInteger)code;
+
+@end
@@ -0,0 +1,174 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPExpectationTracker.h"
+
+#import <pthread.h>
+
+
+
+#pragma mark - Constants
+
+// Consecutive misses after which a host is no longer asked for a 100-Continue
+#define kBBHTTPExpectationTrackerMaxMisses 2
+// Hosts remembered at any given time; past it, an arbitrary host is forgotten to make room
+#define kBBHTTPExpectationTrackerMaxHosts  256
+
+
+
+#pragma mark - Private classes
+
+@interface BBHTTPHostExpectation : NSObject
+
+@property(assign, nonatomic) BOOL acceptsUploads;
+@property(assign, nonatomic) NSUInteger misses;
+@property(assign, nonatomic) NSUInteger latency; // Moving average, in ms; 0 if unknown
+
+@end
+
+@implementation BBHTTPHostExpectation
+@end
+
+
+
+#pragma mark -
+
+@implementation BBHTTPExpectationTracker
+{
+    pthread_mutex_t _lock;
+    NSMutableDictionary* _hosts;
+}
+
+
+#pragma mark Creation
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self != nil) {
+        pthread_mutex_init(&_lock, NULL);
+        _hosts = [NSMutableDictionary dictionary];
+    }
+
+    return self;
+}
+
+
+#pragma mark Destruction
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_lock);
+}
+
+
+#pragma mark Querying hosts
+
+- (BOOL)shouldSkip100ContinueForURL:(NSURL*)url
+{
+    pthread_mutex_lock(&_lock);
+    BBHTTPHostExpectation* host = _hosts[[self keyForURL:url]];
+    BOOL skip = host.acceptsUploads || (host.misses >= kBBHTTPExpectationTrackerMaxMisses);
+    pthread_mutex_unlock(&_lock);
+
+    return skip;
+}
+
+- (NSUInteger)wait100ContinueForURL:(NSURL*)url withTimeout:(NSUInteger)timeout
+{
+    if (timeout == 0) return 0;
+
+    pthread_mutex_lock(&_lock);
+    NSUInteger latency = ((BBHTTPHostExpectation*)_hosts[[self keyForURL:url]]).latency;
+    pthread_mutex_unlock(&_lock);
+
+    return MAX(timeout, latency * 2);
+}
+
+
+#pragma mark Recording outcomes
+
+- (void)record100ContinueForURL:(NSURL*)url latency:(NSUInteger)latency
+{
+    latency = MAX(latency, (NSUInteger)1); // 0 stands for unknown
+
+    pthread_mutex_lock(&_lock);
+    BBHTTPHostExpectation* host = [self hostForURL:url];
+    host.misses = 0;
+    host.latency = (host.latency == 0) ? latency : ((host.latency * 3) + latency) / 4;
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void)recordMissing100ContinueForURL:(NSURL*)url
+{
+    pthread_mutex_lock(&_lock);
+    BBHTTPHostExpectation* host = [self hostForURL:url];
+    host.misses++;
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void)recordUploadToURL:(NSURL*)url withStatusCode:(NSUInteger)code
+{
+    if ((code < 200) || ((code >= 300) && (code < 400))) return; // Says nothing about the upload itself
+
+    pthread_mutex_lock(&_lock);
+    [self hostForURL:url].acceptsUploads = (code < 300);
+    pthread_mutex_unlock(&_lock);
+}
+
+
+#pragma mark Private helpers
+
+- (NSString*)keyForURL:(NSURL*)url
+{
+    return [NSString stringWithFormat:@"%@://%@:%@",
+                                      [[url scheme] lowercaseString], [[url host] lowercaseString], [url port]];
+}
+
+- (BBHTTPHostExpectation*)hostForURL:(NSURL*)url
+{
+    NSString* key = [self keyForURL:url];
+    BBHTTPHostExpectation* host = _hosts[key];
+    if (host == nil) {
+        if ([_hosts count] >= kBBHTTPExpectationTrackerMaxHosts) {
+            [_hosts removeObjectForKey:[[_hosts keyEnumerator] nextObject]];
+        }
+
+        host = [[BBHTTPHostExpectation alloc] init];
+        _hosts[key] = host;
+    }
+
+    return host;
+}
+
+
+#pragma mark Debug
+
+- (NSString*)description
+{
+    pthread_mutex_lock(&_lock);
+    NSUInteger count = [_hosts count];
+    pthread_mutex_unlock(&_lock);
+
+    return [NSString stringWithFormat:@"%@{%lu hosts}", NSStringFromClass([self class]), (unsigned long)count];
+}
+
+@end
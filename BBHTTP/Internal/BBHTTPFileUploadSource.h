@@ -0,0 +1,97 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#pragma mark -
+
+/**
+ Reads the contents of a file (or a range of it) for upload, straight into the buffers libcurl hands out.
+
+ The file is read with plain `pread()`s, with kernel read-ahead enabled on the descriptor, which avoids the object
+ overhead of going through `NSInputStream` for every chunk. A file that shrinks during the upload fails it.
+
+ When `<memoryMapped>` is set, the file is instead mapped in sliding windows (so that even multi-gigabyte files fit in
+ the address space of a 32-bit process) with sequential access hints, saving a syscall per chunk; should mapping fail,
+ it falls back to reads. A mapped file must not be truncated while the upload is in progress: a file that shrinks is
+ detected when the next window is mapped and fails the upload, but a truncation within the current window raises
+ `SIGBUS`.
+ */
+@interface BBHTTPFileUploadSource : NSObject
+
+
+#pragma mark Creating a source
+
+///------------------------
+/// @name Creating a source
+///------------------------
+
+/**
+ Opens a file for upload.
+
+ @param path Path to the file.
+ @param error On failure, the cause.
+
+ @return An initialized `BBHTTPFileUploadSource`, `nil` if the file can't be opened.
+ */
+- (instancetype)initWithPath:(NSString*)path error:(NSError**)error;
+
+/**
+ Opens a range of a file for upload.
+
+ @param path Path to the file.
+ @param offset Offset of the first byte of the range.
+ @param length Length of the range; `ULLONG_MAX` reads up to the end of the file.
+ @param error On failure, the cause.
+
+ @return An initialized `BBHTTPFileUploadSource`, `nil` if the file can't be opened or doesn't cover the range.
+ */
+- (instancetype)initWithPath:(NSString*)path offset:(unsigned long long)offset length:(unsigned long long)length
+                       error:(NSError**)error;
+
+
+#pragma mark Reading the file
+
+///-----------------------
+/// @name Reading the file
+///-----------------------
+
+/** Whether to memory-map the file rather than read it; set before the first read. Defaults to `NO`. */
+@property(assign, nonatomic, getter = isMemoryMapped) BOOL memoryMapped;
+/** Size of the range to read; the size of the file when it was opened, unless a range was given. */
+@property(assign, nonatomic, readonly) unsigned long long size;
+/** Number of bytes of the range read so far. */
+@property(assign, nonatomic, readonly) unsigned long long offset;
+/** The cause of the last failed read, if any. */
+@property(strong, nonatomic, readonly) NSError* error;
+
+/**
+ Copies the next chunk of the file into a buffer.
+
+ @param buffer Buffer to copy into.
+ @param length Capacity of *buffer*.
+
+ @return Number of bytes copied, `0` at the end of the file or `-1` on error (see `<error>`).
+ */
+- (NSInteger)read:(uint8_t*)buffer maxLength:(NSUInteger)length;
+
+/** Unmaps and closes the file; further reads return `-1`. */
+- (void)close;
+
+@end
@@ -0,0 +1,216 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPFileUploadSource.h"
+
+#import <fcntl.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark - Constants
+
+// Size of each mapped window of the file; small enough to always find room in a 32-bit address space
+#define kBBHTTPFileUploadSourceWindowSize (16 * 1024 * 1024)
+
+
+
+#pragma mark -
+
+@implementation BBHTTPFileUploadSource
+{
+    int _fd;
+    unsigned long long _start;
+    uint8_t* _window;
+    size_t _windowLength;
+    unsigned long long _windowOffset;
+    BOOL _mappingFailed;
+}
+
+
+#pragma mark Creating a source
+
+- (instancetype)init
+{
+    NSAssert(NO, @"please use initWithPath:error: instead");
+    return nil;
+}
+
+- (instancetype)initWithPath:(NSString*)path error:(NSError**)error
+{
+    return [self initWithPath:path offset:0 length:ULLONG_MAX error:error];
+}
+
+- (instancetype)initWithPath:(NSString*)path offset:(unsigned long long)offset length:(unsigned long long)length
+                       error:(NSError**)error
+{
+    self = [super init];
+    if (self != nil) {
+        _fd = open([path fileSystemRepresentation], O_RDONLY);
+        struct stat info;
+        if ((_fd < 0) || (fstat(_fd, &info) != 0)) {
+            if (error != NULL) *error = [self errorForErrno:errno];
+            if (_fd >= 0) close(_fd);
+            _fd = -1;
+            return nil;
+        }
+
+        unsigned long long fileSize = (unsigned long long)info.st_size;
+        if (length == ULLONG_MAX) length = (offset < fileSize) ? (fileSize - offset) : 0;
+        if ((offset > fileSize) || (length > (fileSize - offset))) {
+            if (error != NULL) {
+                *error = BBHTTPErrorWithFormat(BBHTTPErrorCodeUploadFileStreamError,
+                                               @"Range %llu-%llu is past the end of the file (%llu bytes).",
+                                               offset, offset + length, fileSize);
+            }
+            close(_fd);
+            _fd = -1;
+            return nil;
+        }
+
+        _start = offset;
+        _size = length;
+        _mappingFailed = NO;
+
+        // Read-ahead hints for reads; mapped windows get their own (see below)
+#if defined(F_RDAHEAD)
+        fcntl(_fd, F_RDAHEAD, 1);
+#elif defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise(_fd, (off_t)_start, (off_t)_size, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    return self;
+}
+
+
+#pragma mark Destruction
+
+- (void)dealloc
+{
+    [self close];
+}
+
+
+#pragma mark Reading the file
+
+- (NSInteger)read:(uint8_t*)buffer maxLength:(NSUInteger)length
+{
+    if (_fd < 0) return -1;
+    if (_offset >= _size) return 0;
+
+    unsigned long long remaining = _size - _offset;
+    if (length > remaining) length = (NSUInteger)remaining;
+
+    unsigned long long position = _start + _offset;
+    if (_memoryMapped && !_mappingFailed && [self mapWindowForOffset:position]) {
+        size_t available = (size_t)(_windowOffset + _windowLength - position);
+        if (length > available) length = available;
+
+        memcpy(buffer, _window + (position - _windowOffset), length);
+        _offset += length;
+        return (NSInteger)length;
+    }
+
+    if (_error != nil) return -1;
+
+    ssize_t transferred = pread(_fd, buffer, length, (off_t)position);
+    if (transferred < 0) {
+        _error = [self errorForErrno:errno];
+        return -1;
+    } else if (transferred == 0) {
+        // Hit the end before the expected size
+        _error = BBHTTPErrorWithReason(BBHTTPErrorCodeUploadFileStreamError, @"Couldn't upload file",
+                                       @"File was truncated during upload.");
+        return -1;
+    }
+
+    _offset += transferred;
+    return transferred;
+}
+
+- (void)close
+{
+    [self unmapWindow];
+    if (_fd >= 0) close(_fd);
+    _fd = -1;
+}
+
+
+#pragma mark Private helpers
+
+- (BOOL)mapWindowForOffset:(unsigned long long)offset
+{
+    if ((_window != NULL) && (offset < (_windowOffset + _windowLength))) return YES;
+
+    [self unmapWindow];
+
+    // Touching a mapped page past the end of a truncated file raises SIGBUS; check before mapping more of it
+    unsigned long long end = _start + _size;
+    struct stat info;
+    if ((fstat(_fd, &info) != 0) || ((unsigned long long)info.st_size < end)) {
+        _error = BBHTTPErrorWithReason(BBHTTPErrorCodeUploadFileStreamError, @"Couldn't upload file",
+                                       @"File was truncated during upload.");
+        return NO;
+    }
+
+    unsigned long long pageSize = (unsigned long long)getpagesize();
+    unsigned long long windowOffset = offset - (offset % pageSize);
+    unsigned long long windowLength = MIN(end - windowOffset, (unsigned long long)kBBHTTPFileUploadSourceWindowSize);
+
+    void* window = mmap(NULL, (size_t)windowLength, PROT_READ, MAP_PRIVATE, _fd, (off_t)windowOffset);
+    if (window == MAP_FAILED) {
+        BBHTTPLogDebug(@"%@ | Couldn't map file (%s), falling back to reads.", self, strerror(errno));
+        _mappingFailed = YES;
+        return NO;
+    }
+
+    // The window is read exactly once, front to back
+    madvise(window, (size_t)windowLength, MADV_SEQUENTIAL);
+    madvise(window, (size_t)windowLength, MADV_WILLNEED);
+
+    _window = window;
+    _windowOffset = windowOffset;
+    _windowLength = (size_t)windowLength;
+
+    return YES;
+}
+
+- (void)unmapWindow
+{
+    if (_window == NULL) return;
+
+    munmap(_window, _windowLength);
+    _window = NULL;
+    _windowLength = 0;
+}
+
+- (NSError*)errorForErrno:(int)code
+{
+    return BBHTTPErrorWithReason(BBHTTPErrorCodeUploadFileStreamError, @"Couldn't upload file",
+                                 [NSString stringWithUTF8String:strerror(code)]);
+}
+
+@end
@@ -0,0 +1,83 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#pragma mark -
+
+/**
+ Thread-safe byte budget shared by all the requests of an executor, used to bound the amount of response data held in
+ memory.
+
+ Requests reserve bytes before receiving them and release their whole reservation when they finish. When a reservation
+ doesn't fit, the first request to be turned down is allowed to go over budget &mdash; until it releases its
+ reservation &mdash; so that requests waiting on each other's reservations can't stall forever; any other request
+ is turned down until enough bytes are released.
+ */
+@interface BBHTTPMemoryBudget : NSObject
+
+
+#pragma mark Reserving and releasing bytes
+
+///------------------------------------
+/// @name Reserving and releasing bytes
+///------------------------------------
+
+/**
+ Reserves a number of bytes.
+
+ @param bytes Number of bytes to reserve.
+ @param owner The object on behalf of which the bytes are reserved.
+
+ @return `YES` if the bytes were reserved, `NO` if the budget can't accommodate them.
+ */
+- (BOOL)reserve:(unsigned long long)bytes forOwner:(id)owner;
+
+/**
+ Reserves a number of bytes, regardless of whether the budget can accommodate them.
+
+ @param bytes Number of bytes to reserve.
+ */
+- (void)forceReserve:(unsigned long long)bytes;
+
+/**
+ Releases previously reserved bytes.
+
+ @param bytes Number of bytes to release.
+ @param owner The object on behalf of which the bytes were reserved.
+ */
+- (void)releaseBytes:(unsigned long long)bytes forOwner:(id)owner;
+
+
+#pragma mark Querying the budget
+
+///--------------------------
+/// @name Querying the budget
+///--------------------------
+
+/** Maximum number of bytes that can be reserved; `0` means unlimited (usage is still tracked). */
+@property(assign, atomic) unsigned long long limit;
+
+/** Number of bytes currently reserved. */
+@property(assign, nonatomic, readonly) unsigned long long used;
+
+/** Whether the budget is limited and fully reserved. */
+- (BOOL)isExhausted;
+
+@end
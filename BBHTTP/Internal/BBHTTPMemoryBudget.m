@@ -0,0 +1,117 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPMemoryBudget.h"
+
+#import <pthread.h>
+
+
+
+#pragma mark -
+
+@implementation BBHTTPMemoryBudget
+{
+    pthread_mutex_t _lock;
+    unsigned long long _used;
+    __weak id _overdraftOwner; // The one allowed to go over budget
+}
+
+
+#pragma mark Creation
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self != nil) pthread_mutex_init(&_lock, NULL);
+
+    return self;
+}
+
+
+#pragma mark Destruction
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_lock);
+}
+
+
+#pragma mark Reserving and releasing bytes
+
+- (BOOL)reserve:(unsigned long long)bytes forOwner:(id)owner
+{
+    unsigned long long limit = self.limit;
+
+    pthread_mutex_lock(&_lock);
+    BOOL granted = (limit == 0) || ((_used + bytes) <= limit) || (_overdraftOwner == owner);
+    if (!granted && (_overdraftOwner == nil)) {
+        _overdraftOwner = owner;
+        granted = YES;
+    }
+    if (granted) _used += bytes;
+    pthread_mutex_unlock(&_lock);
+
+    return granted;
+}
+
+- (void)forceReserve:(unsigned long long)bytes
+{
+    pthread_mutex_lock(&_lock);
+    _used += bytes;
+    pthread_mutex_unlock(&_lock);
+}
+
+- (void)releaseBytes:(unsigned long long)bytes forOwner:(id)owner
+{
+    pthread_mutex_lock(&_lock);
+    _used -= MIN(bytes, _used);
+    if (_overdraftOwner == owner) _overdraftOwner = nil;
+    pthread_mutex_unlock(&_lock);
+}
+
+
+#pragma mark Querying the budget
+
+- (unsigned long long)used
+{
+    pthread_mutex_lock(&_lock);
+    unsigned long long used = _used;
+    pthread_mutex_unlock(&_lock);
+
+    return used;
+}
+
+- (BOOL)isExhausted
+{
+    unsigned long long limit = self.limit;
+
+    return (limit > 0) && ([self used] >= limit);
+}
+
+
+#pragma mark Debug
+
+- (NSString*)description
+{
+    return [NSString stringWithFormat:@"%@{%llu/%llub}", NSStringFromClass([self class]), [self used], self.limit];
+}
+
+@end
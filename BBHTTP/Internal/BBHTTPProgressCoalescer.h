@@ -0,0 +1,84 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#pragma mark -
+
+/**
+ Coalesces the progress events of one direction (upload or download) of a request, so that they're delivered at a
+ bounded rate no matter how many chunks the transfer is made of.
+
+ Only the latest value is ever kept: at most one delivery is in flight at any time and, when it runs, it picks up
+ whatever value was reported last. Between deliveries, events are throttled by time and/or by bytes transferred; final
+ events are never throttled.
+ */
+@interface BBHTTPProgressCoalescer : NSObject
+
+
+#pragma mark Creating a coalescer
+
+///---------------------------
+/// @name Creating a coalescer
+///---------------------------
+
+/**
+ Creates a new coalescer.
+
+ @param interval Minimum time between deliveries, in seconds; `0` disables time-based throttling.
+ @param byteStep Minimum progress between deliveries, in bytes; `0` disables byte-based throttling.
+
+ @return An initialized `BBHTTPProgressCoalescer`.
+ */
+- (instancetype)initWithInterval:(NSTimeInterval)interval byteStep:(NSUInteger)byteStep;
+
+
+#pragma mark Reporting and delivering progress
+
+///----------------------------------------
+/// @name Reporting and delivering progress
+///----------------------------------------
+
+/**
+ Records the latest progress.
+
+ @param current Bytes transferred so far.
+ @param total Total bytes to transfer, `0` if unknown.
+
+ @return `YES` if the caller must schedule a delivery, `NO` if there's one in flight already or if the event was
+ throttled (in which case it's kept around for `<flush>`).
+ */
+- (BOOL)reportCurrent:(NSUInteger)current ofTotal:(NSUInteger)total;
+
+/**
+ Takes the latest progress, from within a delivery; once taken, a new delivery can be scheduled.
+
+ @param current On output, bytes transferred so far.
+ @param total On output, total bytes to transfer.
+ */
+- (void)takeCurrent:(NSUInteger*)current ofTotal:(NSUInteger*)total;
+
+/**
+ Requests delivery of the latest progress, if it hasn't been delivered yet; meant to be called when the transfer ends.
+
+ @return `YES` if the caller must schedule a delivery.
+ */
+- (BOOL)flush;
+
+@end
@@ -0,0 +1,119 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPProgressCoalescer.h"
+
+#import <pthread.h>
+
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark -
+
+@implementation BBHTTPProgressCoalescer
+{
+    pthread_mutex_t _lock;
+    long long _interval; // millis
+    NSUInteger _byteStep;
+
+    NSUInteger _current;
+    NSUInteger _total;
+    NSUInteger _deliveredCurrent;
+    long long _lastDelivery;
+    BOOL _deliveryInFlight;
+    BOOL _undelivered;
+}
+
+
+#pragma mark Creating a coalescer
+
+- (instancetype)initWithInterval:(NSTimeInterval)interval byteStep:(NSUInteger)byteStep
+{
+    self = [super init];
+    if (self != nil) {
+        pthread_mutex_init(&_lock, NULL);
+        _interval = (long long)(interval * 1000);
+        _byteStep = byteStep;
+        _lastDelivery = -1;
+    }
+
+    return self;
+}
+
+
+#pragma mark Destruction
+
+- (void)dealloc
+{
+    pthread_mutex_destroy(&_lock);
+}
+
+
+#pragma mark Reporting and delivering progress
+
+- (BOOL)reportCurrent:(NSUInteger)current ofTotal:(NSUInteger)total
+{
+    pthread_mutex_lock(&_lock);
+    _current = current;
+    _total = total;
+    _undelivered = YES;
+
+    BOOL schedule = NO;
+    if (!_deliveryInFlight) {
+        long long now = BBHTTPCurrentTimeMillis();
+        BOOL final = (total > 0) && (current >= total);
+        BOOL intervalElapsed = (_lastDelivery < 0) || ((now - _lastDelivery) >= _interval);
+        BOOL stepReached = ((current - MIN(current, _deliveredCurrent)) >= _byteStep);
+
+        schedule = final || (intervalElapsed && stepReached);
+        if (schedule) {
+            _deliveryInFlight = YES;
+            _lastDelivery = now;
+        }
+    }
+    pthread_mutex_unlock(&_lock);
+
+    return schedule;
+}
+
+- (void)takeCurrent:(NSUInteger*)current ofTotal:(NSUInteger*)total
+{
+    pthread_mutex_lock(&_lock);
+    *current = _current;
+    *total = _total;
+    _deliveredCurrent = _current;
+    _deliveryInFlight = NO;
+    _undelivered = NO;
+    pthread_mutex_unlock(&_lock);
+}
+
+- (BOOL)flush
+{
+    pthread_mutex_lock(&_lock);
+    BOOL schedule = _undelivered && !_deliveryInFlight;
+    if (schedule) _deliveryInFlight = YES;
+    pthread_mutex_unlock(&_lock);
+
+    return schedule;
+}
+
+@end
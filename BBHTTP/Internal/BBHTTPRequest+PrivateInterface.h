@@ -20,6 +20,7 @@
 //
 
 #import "BBHTTPRequest.h"
+#import "BBHTTPUploadSpool.h"
 
 
 
@@ -33,6 +34,17 @@
 - (BOOL)executionStarted;
 - (BOOL)executionFailedWithFinalResponse:(BBHTTPResponse*)response error:(NSError*)error;
 - (BOOL)uploadProgressedToCurrent:(NSUInteger)current ofTotal:(NSUInteger)total;
-- (BOOL)downloadProgressedToCurrent:(NSUInteger)current ofTotal:(NSUInteger)total;
+- (BOOL)downloadProgressedToCurrent:(NSUInteger)current decoded:(NSUInteger)decoded ofTotal:(NSUInteger)total;
+
+
+#pragma mark Delivering callbacks
+
+- (void)dispatchCallback:(dispatch_block_t)block;
+
+
+#pragma mark Replaying the upload
+
+- (BBHTTPUploadSpool*)uploadSpool;
+- (void)discardUploadSpool;
 
 @end
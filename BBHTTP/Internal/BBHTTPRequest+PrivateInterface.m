@@ -21,10 +21,19 @@
 
 #import "BBHTTPRequest+PrivateInterface.h"
 
+#import "BBHTTPCallbackBatcher.h"
+#import "BBHTTPProgressCoalescer.h"
 #import "BBHTTPUtils.h"
 
 
 
+#pragma mark - Constants
+
+// Spooled upload bodies move on to disk past this size
+#define kBBHTTPUploadSpoolMemoryLimit (1024 * 1024)
+
+
+
 #pragma mark -
 
 @implementation BBHTTPRequest (PrivateInterface)
@@ -38,11 +47,11 @@
 
     _startTimestamp = BBHTTPCurrentTimeMillis();
     if (self.startBlock != nil) {
-        dispatch_async(self.callbackQueue, ^{
+        [self dispatchCallback:^{
             self.startBlock();
 
             self.startBlock = nil;
-        });
+        }];
     }
 
     return YES;
@@ -56,14 +65,18 @@
     _error = error;
     _response = response;
 
+    // Throttled progress goes out before the finish block
+    if ([_uploadProgressCoalescer flush]) [self deliverUploadProgress];
+    if ([_downloadProgressCoalescer flush]) [self deliverDownloadProgress];
+
     if (self.finishBlock != nil) {
-        dispatch_async(self.callbackQueue, ^{
+        [self dispatchCallback:^{
             self.finishBlock(self);
 
             self.uploadProgressBlock = nil;
             self.downloadProgressBlock = nil;
             self.finishBlock = nil;
-        });
+        }];
     }
     
     return YES;
@@ -76,27 +89,98 @@
     _sentBytes = current;
 
     if (self.uploadProgressBlock != nil) {
-        dispatch_async(self.callbackQueue, ^{
-            self.uploadProgressBlock(current, total);
-        });
+        if (_uploadProgressCoalescer == nil) _uploadProgressCoalescer = [self createProgressCoalescer];
+        if ([_uploadProgressCoalescer reportCurrent:current ofTotal:total]) [self deliverUploadProgress];
     }
 
     return YES;
 }
 
-- (BOOL)downloadProgressedToCurrent:(NSUInteger)current ofTotal:(NSUInteger)total
+- (BOOL)downloadProgressedToCurrent:(NSUInteger)current decoded:(NSUInteger)decoded ofTotal:(NSUInteger)total
 {
     if ([self hasFinished]) return NO;
 
     _receivedBytes = current;
+    _decodedBytes = decoded;
 
     if (self.downloadProgressBlock != nil) {
-        dispatch_async(self.callbackQueue, ^{
-            self.downloadProgressBlock(current, total);
-        });
+        if (_downloadProgressCoalescer == nil) _downloadProgressCoalescer = [self createProgressCoalescer];
+        if ([_downloadProgressCoalescer reportCurrent:current ofTotal:total]) [self deliverDownloadProgress];
     }
 
     return YES;
 }
 
+
+#pragma mark Delivering callbacks
+
+- (void)dispatchCallback:(dispatch_block_t)block
+{
+    switch (self.callbackDelivery) {
+        case BBHTTPCallbackDeliveryInline:
+            block();
+            break;
+
+        case BBHTTPCallbackDeliveryBatched:
+            [[BBHTTPCallbackBatcher batcherForQueue:self.callbackQueue] addCallback:block];
+            break;
+
+        default:
+            dispatch_async(self.callbackQueue, block);
+            break;
+    }
+}
+
+
+#pragma mark Replaying the upload
+
+- (BBHTTPUploadSpool*)uploadSpool
+{
+    if ((_uploadSpool == nil) && (self.uploadStream != nil)) {
+        unsigned long long maxLength = self.uploadReplayLimit;
+        NSUInteger memoryLimit = (NSUInteger)MIN(maxLength, (unsigned long long)kBBHTTPUploadSpoolMemoryLimit);
+        _uploadSpool = [[BBHTTPUploadSpool alloc] initWithStream:self.uploadStream memoryLimit:memoryLimit
+                                                       maxLength:maxLength];
+    }
+
+    return _uploadSpool;
+}
+
+- (void)discardUploadSpool
+{
+    _uploadSpool = nil;
+}
+
+
+#pragma mark Private helpers
+
+- (BBHTTPProgressCoalescer*)createProgressCoalescer
+{
+    return [[BBHTTPProgressCoalescer alloc] initWithInterval:self.progressInterval byteStep:self.progressByteStep];
+}
+
+- (void)deliverUploadProgress
+{
+    BBHTTPProgressCoalescer* coalescer = _uploadProgressCoalescer;
+    [self dispatchCallback:^{
+        // Whatever the latest progress is by the time this runs
+        NSUInteger current, total;
+        [coalescer takeCurrent:&current ofTotal:&total];
+
+        if (self.uploadProgressBlock != nil) self.uploadProgressBlock(current, total);
+    }];
+}
+
+- (void)deliverDownloadProgress
+{
+    BBHTTPProgressCoalescer* coalescer = _downloadProgressCoalescer;
+    [self dispatchCallback:^{
+        // Whatever the latest progress is by the time this runs
+        NSUInteger current, total;
+        [coalescer takeCurrent:&current ofTotal:&total];
+
+        if (self.downloadProgressBlock != nil) self.downloadProgressBlock(current, total);
+    }];
+}
+
 @end
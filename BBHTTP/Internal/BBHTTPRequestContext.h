@@ -20,6 +20,7 @@
 //
 
 #import "BBHTTPRequest.h"
+#import "BBHTTPMemoryBudget.h"
 #import "curl.h"
 
 
@@ -83,12 +84,22 @@ typedef NS_ENUM(NSUInteger, BBHTTPResponseState) {
 @property(assign, nonatomic, readonly) NSUInteger uploadedBytes;
 @property(assign, nonatomic, readonly) NSUInteger downloadSize;
 @property(assign, nonatomic, readonly) NSUInteger downloadedBytes;
+@property(assign, nonatomic, readonly) NSUInteger decodedBytes;
+/** Time, in milliseconds, to wait for a `100-Continue` before sending the body anyway; `0` means indefinitely. */
+@property(assign, nonatomic) NSUInteger expect100ContinueTimeout;
+/** Time, in milliseconds, the `100-Continue` took to arrive; `NSNotFound` if it didn't. */
+@property(assign, nonatomic, readonly) NSUInteger expect100ContinueLatency;
+/** Whether the body was sent without having received the `100-Continue` it waited for. */
+@property(assign, nonatomic, readonly, getter = hasExpect100ContinueTimedOut) BOOL expect100ContinueTimedOut;
 
 - (void)waitFor100ContinueBeforeUploading;
+- (void)sendUploadDataWithRequest;
+- (BOOL)stopWaitingFor100ContinueIfExpired;
 - (void)pauseUpload;
 - (void)unpauseUpload;
 - (BOOL)is100ContinueRequired;
 - (NSInteger)transferInputToBuffer:(uint8_t*)buffer limit:(NSUInteger)limit;
+- (BOOL)rewindUpload;
 
 
 #pragma mark Reading data from the server
@@ -97,10 +108,21 @@ typedef NS_ENUM(NSUInteger, BBHTTPResponseState) {
 /// @name Reading data from the server
 /// ----------------------------------
 
+/** Maximum size of a response body (wire and decoded); `0` means unlimited. */
+@property(assign, nonatomic) unsigned long long maxResponseBodySize;
+/** Budget against which response bodies held in memory are reserved; `nil` means no accounting. */
+@property(strong, nonatomic) BBHTTPMemoryBudget* memoryBudget;
+
 - (BOOL)beginResponseWithLine:(NSString*)line;
 - (BOOL)addHeaderToCurrentResponse:(NSString*)headerLine;
 - (BOOL)appendDataToCurrentResponse:(uint8_t*)bytes withLength:(NSUInteger)length;
 
+@property(assign, nonatomic, readonly, getter = isDownloadPaused) BOOL downloadPaused;
+
+- (BOOL)supportsDownloadBackpressure;
+- (BOOL)shouldPauseDownloadForBytes:(NSUInteger)length;
+- (BOOL)resumeDownloadIfReady;
+
 
 #pragma mark Querying context information
 
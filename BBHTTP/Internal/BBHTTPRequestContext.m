@@ -22,20 +22,42 @@
 #import "BBHTTPRequestContext.h"
 
 #import "BBHTTPRequest+PrivateInterface.h"
+#import "BBHTTPContentDecoder.h"
+#import "BBHTTPContentEncoder.h"
+#import "BBHTTPFileUploadSource.h"
+#import "BBHTTPUploadBody.h"
+#import "BBHTTPUploadSpool.h"
 #import "BBHTTPUtils.h"
 
 
 
+#pragma mark - Constants
+
+// Bodies of unknown size reserve memory budget in increments of this size
+#define kBBHTTPRequestContextBudgetIncrement 65536
+
+
+
 #pragma mark -
 
 @implementation BBHTTPRequestContext
 {
     NSMutableArray* _receivedResponses;
     NSInputStream* _uploadStream;
+    BBHTTPFileUploadSource* _uploadFileSource;
+    BBHTTPUploadSpool* _uploadSpool;
+    unsigned long long _uploadOffset;
+    BOOL _uploadStarted;
+    BOOL _uploadSentWithRequest;
+    BBHTTPContentEncoder* _contentEncoder;
+    BBHTTPContentDecoder* _contentDecoder;
     BOOL _discardBodyForCurrentResponse;
     BOOL _uploadAccepted;
     BOOL _uploadPaused;
     BOOL _uploadAborted;
+    BOOL _downloadPaused;
+    NSUInteger _pausedLength;
+    unsigned long long _reservedBytes;
 }
 
 
@@ -57,6 +79,7 @@
         _uploadAborted = NO;
         _uploadAccepted = YES;
         _uploadPaused = NO;
+        _expect100ContinueLatency = NSNotFound;
         _receivedResponses = [NSMutableArray array];
     }
 
@@ -78,11 +101,18 @@
         nextState = BBHTTPResponseStateReadingStatusLine; // ... unless it's a 100-Continue; if so, go back to the start
         // TODO I'm assuming 100-Continue's never have data...
         _uploadAccepted = YES;
+        // Even if it came too late, it tells how long to wait next time
+        long long waited = [self millisecondsWaitedFor100Continue];
+        if (waited >= 0) _expect100ContinueLatency = (NSUInteger)waited;
+        _expect100ContinueTimedOut = NO;
     } else if (!_discardBodyForCurrentResponse) {
         NSError* error = nil;
-        parsedContent = [_request.responseContentHandler parseContent:&error];
+        if ((_contentDecoder == nil) || [_contentDecoder finish:&error]) {
+            parsedContent = [_request.responseContentHandler parseContent:&error];
+        }
 
-        if (error != nil) _error = error;
+        // Don't mask the original cause (e.g. cancellation) if the request was already failing
+        if ((error != nil) && (_error == nil)) _error = error;
     }
 
     [self switchToState:nextState];
@@ -105,15 +135,33 @@
 
 - (BOOL)prepareToReceiveData
 {
+    // Reject oversized bodies before any of it is read; failing here drops the connection instead of draining it.
+    // Responses to HEAD, 204 and 304 never have a body, whatever their Content-Length says.
+    NSUInteger code = _currentResponse.code;
+    BOOL hasBody = ![_request.verb isEqualToString:@"HEAD"] && (code != 204) && (code != 304);
+    if (hasBody && ![self isResponseBodySizeAllowed:_downloadSize]) {
+        _discardBodyForCurrentResponse = YES;
+        return NO;
+    }
+
     if (_request.responseContentHandler == nil) {
         _discardBodyForCurrentResponse = YES;
         BBHTTPLogDebug(@"%@ | Response %lu %@ accepted but content will be discarded (no content handler).",
                        self, (unsigned long)_currentResponse.code, _currentResponse.message);
     } else {
+        NSDictionary* headers = _currentResponse.headers;
+        _contentDecoder = [self createContentDecoderForCurrentResponse];
+        if (_contentDecoder != nil) {
+            // The handler will be fed decoded content, to which the Content-Length on the wire does not apply
+            NSMutableDictionary* decodedHeaders = [headers mutableCopy];
+            [decodedHeaders removeObjectForKey:H(ContentLength)];
+            headers = decodedHeaders;
+        }
+
         NSError* error = nil;
         BOOL parserAcceptsResponse = [_request.responseContentHandler
                                       prepareForResponse:_currentResponse.code message:_currentResponse.message
-                                      headers:_currentResponse.headers error:&error];
+                                      headers:headers error:&error];
 
         if (!parserAcceptsResponse) {
             _discardBodyForCurrentResponse = YES;
@@ -141,7 +189,11 @@
     [self finishCurrentResponse];
     [self cleanup];
 
-    [_request executionFailedWithFinalResponse:[self lastResponse] error:_error];
+    // Once the body made it, there's nothing left to replay it for
+    BBHTTPResponse* response = [self lastResponse];
+    if ((_error == nil) && (response.code >= 200) && (response.code < 300)) [_request discardUploadSpool];
+
+    [_request executionFailedWithFinalResponse:response error:_error];
 }
 
 - (void)requestFinishedWithError:(NSError*)error
@@ -154,6 +206,12 @@
 - (void)cleanup
 {
     if (_uploadStream != nil) [_uploadStream close];
+    if (_uploadFileSource != nil) [_uploadFileSource close];
+    [self releaseMemoryBudget];
+
+    if ((_error != nil) && [_request.responseContentHandler respondsToSelector:@selector(requestFailedWithError:)]) {
+        [_request.responseContentHandler requestFailedWithError:_error];
+    }
 
     if ((_request.responseContentHandler != nil) &&
         [_request.responseContentHandler respondsToSelector:@selector(cleanup)]) {
@@ -169,6 +227,25 @@
     _uploadAccepted = NO;
 }
 
+- (void)sendUploadDataWithRequest
+{
+    _uploadSentWithRequest = YES;
+}
+
+- (BOOL)stopWaitingFor100ContinueIfExpired
+{
+    if (_uploadAccepted || (_expect100ContinueTimeout == 0)) return NO;
+
+    long long waited = [self millisecondsWaitedFor100Continue];
+    if (waited < (long long)_expect100ContinueTimeout) return NO;
+
+    BBHTTPLogDebug(@"%@ | No 100-Continue after %lldms, sending upload anyway.", self, waited);
+    _uploadAccepted = YES;
+    _expect100ContinueTimedOut = YES;
+
+    return YES;
+}
+
 - (BOOL)hasUploadBeenAccepted
 {
     return _uploadAccepted;
@@ -203,11 +280,39 @@
 {
     if (![_request isUpload]) return -1;
 
-    if (_uploadStream == nil) {
+    if (!_uploadStarted) {
+        _uploadStarted = YES;
         [self switchToState:BBHTTPResponseStateSendingData];
-        if (_request.uploadStream != nil) {
+        if ([_request.uploadBody isReplayable]) {
+            // Read from a new stream every time, so the body can be rewound without spooling it
+            _uploadStream = [_request.uploadBody bodyStream];
+            BBHTTPLogTrace(@"%@ | Created input stream from upload body.", self);
+
+        } else if ((_request.uploadStream != nil) && (_request.uploadReplayLimit > 0) &&
+                   ![_request isUploadCompressed]) {
+            // Spooled as it's read, so that it can be rewound or replayed
+            _uploadSpool = [_request uploadSpool];
+            _uploadOffset = 0;
+            BBHTTPLogTrace(@"%@ | Spooling upload stream (up to %llub).", self, _request.uploadReplayLimit);
+
+            return [self transferSpooledInputToBuffer:buffer limit:limit];
+
+        } else if (_request.uploadStream != nil) {
             _uploadStream = _request.uploadStream;
 
+        } else if ((_request.uploadFile != nil) && ![_request isUploadCompressed]) {
+            // Plain file uploads skip NSInputStream and copy straight from the (mapped) file into curl's buffer
+            NSError* error = nil;
+            _uploadFileSource = [[BBHTTPFileUploadSource alloc] initWithPath:_request.uploadFile error:&error];
+            if (_uploadFileSource == nil) {
+                _error = error;
+                return -1;
+            }
+            _uploadFileSource.memoryMapped = _request.mapUploadFile;
+            BBHTTPLogTrace(@"%@ | Opened file '%@' for upload.", self, _request.uploadFile);
+
+            return [self transferFileInputToBuffer:buffer limit:limit];
+
         } else if (_request.uploadFile != nil) {
             _uploadStream = [NSInputStream inputStreamWithFileAtPath:_request.uploadFile];
             if (_uploadStream == nil) {
@@ -229,11 +334,22 @@
             BBHTTPLogTrace(@"%@ | Created input stream from in-memory NSData for upload.", self);
         }
 
+        if ([_request isUploadCompressed]) {
+            _contentEncoder = [[BBHTTPContentEncoder alloc] initWithCompressionLevel:_request.uploadCompressionLevel];
+            BBHTTPLogTrace(@"%@ | Compressing upload with level %lu.",
+                           self, (unsigned long)_request.uploadCompressionLevel);
+        }
+
         [_uploadStream open];
     }
 
+    if (_uploadSpool != nil) return [self transferSpooledInputToBuffer:buffer limit:limit];
+    if (_uploadFileSource != nil) return [self transferFileInputToBuffer:buffer limit:limit];
+    if (_contentEncoder != nil) return [self transferEncodedInputToBuffer:buffer limit:limit];
+
     NSInteger read = [_uploadStream read:buffer maxLength:limit];
     if (read <= 0) {
+        if (read < 0) _error = [_uploadStream streamError];
         BBHTTPLogTrace(@"%@ | Upload stream read %@, closing stream...", self, read == 0 ? @"finished" : @"error");
         [_uploadStream close];
         _uploadStream = nil;
@@ -250,6 +366,35 @@
     return read;
 }
 
+- (BOOL)rewindUpload
+{
+    if (!_uploadStarted) return YES;
+
+    // Streams are only read once, unless spooled; data, file and stream-free upload bodies can simply be read again
+    BOOL replayable = (_request.uploadData != nil) || (_request.uploadFile != nil) ||
+                      [_request.uploadBody isReplayable] ||
+                      ((_uploadSpool != nil) && [_uploadSpool canReadFromOffset:0]);
+    if (!replayable) {
+        BBHTTPLogWarn(@"%@ | Upload can't be rewound, the stream body isn't spooled (see uploadReplayLimit).", self);
+        return NO;
+    }
+
+    BBHTTPLogDebug(@"%@ | Rewinding upload.", self);
+    if (_uploadSpool == nil) [_uploadStream close]; // Created by the context itself, from the data, file or body
+    _uploadStream = nil;
+    [_uploadFileSource close];
+    _uploadFileSource = nil;
+    _uploadSpool = nil;
+    _contentEncoder = nil;
+    _uploadOffset = 0;
+    _uploadedBytes = 0;
+    _uploadStarted = NO;
+
+    [self switchToState:BBHTTPResponseStateReady];
+
+    return YES;
+}
+
 
 #pragma mark Reading data from the server
 
@@ -257,9 +402,16 @@
 {
     if (_currentResponse != nil) [self finishCurrentResponse];
 
+    // Curl sent the whole body along with the request, without going through transferInputToBuffer:limit:
+    if (_uploadSentWithRequest && (_state == BBHTTPResponseStateReady)) {
+        [_request uploadProgressedToCurrent:_request.uploadSize ofTotal:_request.uploadSize];
+    }
+
     _uploadedBytes = 0;
     _downloadSize = 0;
     _downloadedBytes = 0;
+    _decodedBytes = 0;
+    _contentDecoder = nil;
     _discardBodyForCurrentResponse = NO;
     _currentResponse = [BBHTTPResponse responseWithStatusLine:line];
     if (_currentResponse == nil) return NO; // May happen if line is not a valid status response line
@@ -284,17 +436,71 @@
 - (BOOL)appendDataToCurrentResponse:(uint8_t*)bytes withLength:(NSUInteger)length
 {
     if (_currentResponse == nil) return NO;
-    if (_discardBodyForCurrentResponse) return YES;
 
-    if ([self transferBytes:bytes withLength:length toHandler:_request.responseContentHandler]) {
+    // Bodies of unknown size (or lying about it) are cut short as soon as they cross the limit, even when discarded
+    if (![self isResponseBodySizeAllowed:(_downloadedBytes + length)]) return NO;
+    if (_discardBodyForCurrentResponse) {
+        _downloadedBytes += length;
+        return YES;
+    }
+
+    BOOL transferred;
+    if (_contentDecoder != nil) {
+        transferred = [self decodeBytes:bytes withLength:length toHandler:_request.responseContentHandler];
+    } else {
+        transferred = [self transferBytes:bytes withLength:length toHandler:_request.responseContentHandler];
+    }
+
+    if (transferred) {
         _downloadedBytes += length;
-        [_request downloadProgressedToCurrent:_downloadedBytes ofTotal:_downloadSize];
+
+        // Decoded content takes more memory than what was reserved for it on the wire
+        if ((_memoryBudget != nil) && (_decodedBytes > _reservedBytes) && [self isResponseHeldInMemory]) {
+            [_memoryBudget forceReserve:(_decodedBytes - _reservedBytes)];
+            _reservedBytes = _decodedBytes;
+        }
+        [_request downloadProgressedToCurrent:_downloadedBytes decoded:_decodedBytes ofTotal:_downloadSize];
         return YES;
     }
 
     return NO;
 }
 
+- (BOOL)supportsDownloadBackpressure
+{
+    return [_request.responseContentHandler respondsToSelector:@selector(isReadyForResponseBytes)] ||
+           ((_memoryBudget != nil) && [self isResponseHeldInMemory]);
+}
+
+- (BOOL)shouldPauseDownloadForBytes:(NSUInteger)length
+{
+    if ((_currentResponse == nil) || _discardBodyForCurrentResponse) return NO;
+
+    if (![self isHandlerReadyForResponseBytes]) {
+        if (!_downloadPaused) BBHTTPLogTrace(@"%@ | Response content handler can't keep up, pausing download.", self);
+    } else if (![self reserveMemoryBudgetForBytes:length]) {
+        if (!_downloadPaused) BBHTTPLogTrace(@"%@ | Memory budget exhausted, pausing download.", self);
+    } else {
+        return NO;
+    }
+
+    _downloadPaused = YES;
+    _pausedLength = length;
+
+    return YES;
+}
+
+- (BOOL)resumeDownloadIfReady
+{
+    if (!_downloadPaused) return NO;
+    if (![self isHandlerReadyForResponseBytes] || ![self reserveMemoryBudgetForBytes:_pausedLength]) return NO;
+
+    BBHTTPLogTrace(@"%@ | Ready for more response data, resuming download.", self);
+    _downloadPaused = NO;
+
+    return YES;
+}
+
 
 #pragma mark Querying context information
 
@@ -318,6 +524,86 @@
     [self switchToState:BBHTTPResponseStateReadingStatusLine];
 }
 
+- (long long)millisecondsWaitedFor100Continue
+{
+    // Counted from when the request went out, i.e. after connecting; pre-transfer time is 0 until then
+    double pretransfer = 0;
+    if ((curl_easy_getinfo(_handle, CURLINFO_PRETRANSFER_TIME, &pretransfer) != CURLE_OK) || (pretransfer <= 0)) {
+        return -1;
+    }
+
+    return BBHTTPCurrentTimeMillis() - _request.startTimestamp - (long long)(pretransfer * 1000);
+}
+
+- (NSInteger)transferSpooledInputToBuffer:(uint8_t*)buffer limit:(NSUInteger)limit
+{
+    NSInteger read = [_uploadSpool readAtOffset:_uploadOffset intoBuffer:buffer maxLength:limit];
+    if (read <= 0) {
+        if (read < 0) _error = _uploadSpool.error;
+        BBHTTPLogTrace(@"%@ | Spooled upload read %@.", self, read == 0 ? @"finished" : @"error");
+        return read;
+    }
+
+    _uploadOffset += read;
+    _uploadedBytes += read;
+    [_request uploadProgressedToCurrent:_uploadedBytes ofTotal:_request.uploadSize];
+    BBHTTPLogTrace(@"%@ | Transferred %ldb to server.", self, (long)read);
+    if (read < limit) {
+        BBHTTPLogTrace(@"%@ | Upload finished.", self);
+        [self uploadFinished];
+    }
+
+    return read;
+}
+
+- (NSInteger)transferFileInputToBuffer:(uint8_t*)buffer limit:(NSUInteger)limit
+{
+    NSInteger read = [_uploadFileSource read:buffer maxLength:limit];
+    if (read <= 0) {
+        if (_uploadFileSource.error != nil) _error = _uploadFileSource.error;
+        BBHTTPLogTrace(@"%@ | Upload file read %@, closing file...", self, read == 0 ? @"finished" : @"error");
+        [_uploadFileSource close];
+        _uploadFileSource = nil;
+        return read;
+    }
+
+    _uploadedBytes += read;
+    [_request uploadProgressedToCurrent:_uploadedBytes ofTotal:_request.uploadSize];
+    BBHTTPLogTrace(@"%@ | Transferred %ldb to server.", self, (long)read);
+    if (_uploadFileSource.offset >= _uploadFileSource.size) {
+        BBHTTPLogTrace(@"%@ | Upload finished.", self);
+        [self uploadFinished];
+    }
+
+    return read;
+}
+
+- (NSInteger)transferEncodedInputToBuffer:(uint8_t*)buffer limit:(NSUInteger)limit
+{
+    NSError* error = nil;
+    NSInteger encoded = [_contentEncoder readFromStream:_uploadStream intoBuffer:buffer limit:limit error:&error];
+    if (encoded <= 0) {
+        if (error != nil) _error = error;
+        BBHTTPLogTrace(@"%@ | Compressed upload %@, closing stream...", self, encoded == 0 ? @"finished" : @"error");
+        [_uploadStream close];
+        _uploadStream = nil;
+        _contentEncoder = nil;
+        return encoded;
+    }
+
+    // Progress is reported in raw bytes, to keep it comparable with the request's upload size
+    _uploadedBytes = _contentEncoder.consumedBytes;
+    [_request uploadProgressedToCurrent:_uploadedBytes ofTotal:_request.uploadSize];
+    BBHTTPLogTrace(@"%@ | Transferred %ldb (compressed) to server.", self, (long)encoded);
+    if ([_contentEncoder isFinished]) {
+        BBHTTPLogTrace(@"%@ | Upload finished (%lub compressed to %lub).", self,
+                       (unsigned long)_contentEncoder.consumedBytes, (unsigned long)_contentEncoder.encodedBytes);
+        [self uploadFinished];
+    }
+
+    return encoded;
+}
+
 - (BOOL)parseHeaderLine:(NSString*)headerLine andAddToResponse:(BBHTTPResponse*)response
 {
     if (headerLine == nil) return NO;
@@ -337,16 +623,82 @@
     return YES;
 }
 
+- (BBHTTPContentDecoder*)createContentDecoderForCurrentResponse
+{
+    if (_request.dontAcceptCompressedContent) return nil;
+
+    NSString* contentEncoding = [_currentResponse headerWithName:H(ContentEncoding)];
+    if (contentEncoding == nil) return nil;
+
+    if (![BBHTTPContentDecoder supportsEncoding:contentEncoding]) {
+        BBHTTPLogDebug(@"%@ | Unsupported content encoding '%@'; content will be handed to handler as received.",
+                       self, contentEncoding);
+        return nil;
+    }
+
+    BBHTTPLogTrace(@"%@ | Response content is '%@' encoded; decoding before handing to handler.", self, contentEncoding);
+    return [[BBHTTPContentDecoder alloc] initWithEncoding:contentEncoding];
+}
+
+- (BOOL)decodeBytes:(uint8_t*)bytes withLength:(NSUInteger)length toHandler:(id<BBHTTPContentHandler>)handler
+{
+    NSError* error = nil;
+    BOOL decoded;
+    if ([handler respondsToSelector:@selector(appendResponseData:error:)]) {
+        decoded = [_contentDecoder decodeBytes:bytes withLength:length toDataBlock:^BOOL(NSData* decodedData) {
+            return [self transferData:decodedData toHandler:handler];
+        } error:&error];
+    } else {
+        decoded = [_contentDecoder decodeBytes:bytes withLength:length toBlock:^BOOL(uint8_t* decodedBytes,
+                                                                                      NSUInteger decodedLength) {
+            return [self transferBytes:decodedBytes withLength:decodedLength toHandler:handler];
+        } error:&error];
+    }
+
+    if (error != nil) {
+        _error = error;
+        BBHTTPLogError(@"%@ | Error raised while decoding %lub of response content: %@",
+                       self, (unsigned long)length, [error localizedDescription]);
+    }
+
+    return decoded;
+}
+
 - (BOOL)transferBytes:(uint8_t*)bytes withLength:(NSUInteger)length toHandler:(id<BBHTTPContentHandler>)handler
 {
+    // The handler wants to keep the data; copy it out of curl's buffer, once
+    if ([handler respondsToSelector:@selector(appendResponseData:error:)]) {
+        return [self transferData:[NSData dataWithBytes:bytes length:length] toHandler:handler];
+    }
+
+    // Small compressed bodies can decode to huge ones
+    if (![self isResponseBodySizeAllowed:(_decodedBytes + length)]) return NO;
+
     NSError* error = nil;
     NSInteger written = [handler appendResponseBytes:bytes withLength:length error:&error];
+
+    return [self handlerTransferred:written ofLength:length error:error];
+}
+
+- (BOOL)transferData:(NSData*)data toHandler:(id<BBHTTPContentHandler>)handler
+{
+    NSUInteger length = [data length];
+    if (![self isResponseBodySizeAllowed:(_decodedBytes + length)]) return NO;
+
+    NSError* error = nil;
+    BOOL handled = [handler appendResponseData:data error:&error];
+
+    return [self handlerTransferred:(handled ? (NSInteger)length : -1) ofLength:length error:error];
+}
+
+- (BOOL)handlerTransferred:(NSInteger)written ofLength:(NSUInteger)length error:(NSError*)error
+{
     if (error != nil) {
         _error = error;
         BBHTTPLogError(@"%@ | Error raised while attempting to transfer %lub to response content handler: %@",
                        self, (unsigned long)length, [error localizedDescription]);
         return NO;
-    } else if (written < length) {
+    } else if (written < (NSInteger)length) {
         _error = BBHTTPErrorWithReason(BBHTTPErrorCodeDownloadCannotWriteToHandler,
                                        @"Error handling response content",
                                        @"Response handler capacity reached before content was fully read.");
@@ -355,10 +707,73 @@
         return NO;
     }
 
+    _decodedBytes += length;
     BBHTTPLogTrace(@"%@ | Transferred %lub to response content handler.", self, (unsigned long)length);
     return YES;
 }
 
+- (BOOL)isHandlerReadyForResponseBytes
+{
+    id<BBHTTPContentHandler> handler = _request.responseContentHandler;
+
+    return ![handler respondsToSelector:@selector(isReadyForResponseBytes)] || [handler isReadyForResponseBytes];
+}
+
+- (BOOL)isResponseHeldInMemory
+{
+    id<BBHTTPContentHandler> handler = _request.responseContentHandler;
+
+    return [handler respondsToSelector:@selector(buffersResponseInMemory)] && [handler buffersResponseInMemory];
+}
+
+- (BOOL)reserveMemoryBudgetForBytes:(NSUInteger)length
+{
+    if (_memoryBudget == nil) return YES;
+
+    // Handler moved the body out of memory (e.g. spilled it to disk)
+    if (![self isResponseHeldInMemory]) {
+        [self releaseMemoryBudget];
+        return YES;
+    }
+
+    // Reserve the whole body at once when its size is known, grow the reservation in increments otherwise
+    unsigned long long needed = _downloadedBytes + length;
+    if ((_contentDecoder == nil) && (_downloadSize > needed)) {
+        needed = _downloadSize;
+    } else {
+        needed = ((needed + kBBHTTPRequestContextBudgetIncrement - 1) / kBBHTTPRequestContextBudgetIncrement) *
+                 kBBHTTPRequestContextBudgetIncrement;
+    }
+
+    if (needed <= _reservedBytes) return YES;
+    if (![_memoryBudget reserve:(needed - _reservedBytes) forOwner:self]) return NO;
+
+    _reservedBytes = needed;
+    return YES;
+}
+
+- (void)releaseMemoryBudget
+{
+    if (_reservedBytes == 0) return;
+
+    [_memoryBudget releaseBytes:_reservedBytes forOwner:self];
+    _reservedBytes = 0;
+}
+
+- (BOOL)isResponseBodySizeAllowed:(unsigned long long)size
+{
+    if ((_maxResponseBodySize == 0) || (size <= _maxResponseBodySize)) return YES;
+
+    if (_error == nil) {
+        _error = BBHTTPErrorWithFormat(BBHTTPErrorCodeResponseTooLarge,
+                                       @"Response body exceeds the maximum allowed size (%llub)", _maxResponseBodySize);
+    }
+    BBHTTPLogError(@"%@ | Response body size (at least %llub) exceeds the maximum allowed (%llub), aborting.",
+                   self, size, _maxResponseBodySize);
+
+    return NO;
+}
+
 - (void)switchToState:(BBHTTPResponseState)state
 {
     BBHTTPResponseState oldState = _state;
@@ -0,0 +1,88 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#pragma mark -
+
+/**
+ Wraps a stream upload body, keeping a copy of everything read from the stream so that the body can be read again from
+ the start &mdash; e.g. when libcurl needs to rewind the upload or when it's replayed on another request.
+
+ The first `<memoryLimit>` bytes are kept in memory, the rest in an anonymous (already unlinked) temporary file. Bodies
+ that grow past `<maxLength>` stop being spooled and can no longer be replayed.
+ */
+@interface BBHTTPUploadSpool : NSObject
+
+
+#pragma mark Creating a spool
+
+///-----------------------
+/// @name Creating a spool
+///-----------------------
+
+/**
+ Creates a new spool.
+
+ @param stream The stream with the upload body; it's opened on the first read and closed when the spool is released.
+ @param memoryLimit Number of bytes to keep in memory before moving on to disk.
+ @param maxLength Maximum number of bytes to spool.
+
+ @return An initialized `BBHTTPUploadSpool`.
+ */
+- (instancetype)initWithStream:(NSInputStream*)stream memoryLimit:(NSUInteger)memoryLimit
+                     maxLength:(unsigned long long)maxLength;
+
+
+#pragma mark Reading the body
+
+///-----------------------
+/// @name Reading the body
+///-----------------------
+
+@property(assign, nonatomic, readonly) NSUInteger memoryLimit;
+@property(assign, nonatomic, readonly) unsigned long long maxLength;
+/** Number of bytes read from the stream so far. */
+@property(assign, nonatomic, readonly) unsigned long long streamOffset;
+/** `YES` once the body outgrew `<maxLength>` (or couldn't be written to disk) and was dropped. */
+@property(assign, nonatomic, readonly, getter = hasOverflowed) BOOL overflowed;
+/** The cause of the last failed read, if any. */
+@property(strong, nonatomic, readonly) NSError* error;
+
+/**
+ Whether the body can be read from the given offset: either it was spooled up to there, or it's where the stream is.
+
+ @param offset Offset into the body.
+ */
+- (BOOL)canReadFromOffset:(unsigned long long)offset;
+
+/**
+ Reads the body at an offset, from the spool first and then from the stream, spooling whatever comes out of it.
+
+ Reads only come up short if the stream does.
+
+ @param offset Offset into the body.
+ @param buffer Buffer to copy into.
+ @param length Capacity of *buffer*.
+
+ @return Number of bytes copied, `0` at the end of the stream or `-1` on error (see `<error>`).
+ */
+- (NSInteger)readAtOffset:(unsigned long long)offset intoBuffer:(uint8_t*)buffer maxLength:(NSUInteger)length;
+
+@end
@@ -0,0 +1,203 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import "BBHTTPUploadSpool.h"
+
+#import <unistd.h>
+
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark -
+
+@implementation BBHTTPUploadSpool
+{
+    NSInputStream* _stream;
+    BOOL _streamOpen;
+    NSMutableData* _memory;
+    int _fd;
+}
+
+
+#pragma mark Creating a spool
+
+- (instancetype)init
+{
+    NSAssert(NO, @"please use initWithStream:memoryLimit:maxLength: instead");
+    return nil;
+}
+
+- (instancetype)initWithStream:(NSInputStream*)stream memoryLimit:(NSUInteger)memoryLimit
+                     maxLength:(unsigned long long)maxLength
+{
+    BBHTTPEnsureNotNil(stream);
+
+    self = [super init];
+    if (self != nil) {
+        _stream = stream;
+        _memoryLimit = memoryLimit;
+        _maxLength = maxLength;
+        _memory = [NSMutableData data];
+        _fd = -1;
+    }
+
+    return self;
+}
+
+
+#pragma mark Destruction
+
+- (void)dealloc
+{
+    if (_streamOpen) [_stream close];
+    [self drop];
+}
+
+
+#pragma mark Reading the body
+
+- (BOOL)canReadFromOffset:(unsigned long long)offset
+{
+    return (offset == _streamOffset) || (!_overflowed && (offset < _streamOffset));
+}
+
+- (NSInteger)readAtOffset:(unsigned long long)offset intoBuffer:(uint8_t*)buffer maxLength:(NSUInteger)length
+{
+    if (![self canReadFromOffset:offset]) return -1;
+
+    NSUInteger total = 0;
+    if (offset < _streamOffset) {
+        total = (NSUInteger)MIN((unsigned long long)length, _streamOffset - offset);
+        if (![self copySpooledBytesAtOffset:offset intoBuffer:buffer length:total]) return -1;
+        if (total == length) return total;
+    }
+
+    if (!_streamOpen) {
+        [_stream open];
+        _streamOpen = YES;
+    }
+
+    NSInteger read = [_stream read:(buffer + total) maxLength:(length - total)];
+    if (read < 0) {
+        _error = [_stream streamError];
+        // Hand over what came from the spool; the error surfaces on the next read
+        return (total > 0) ? total : -1;
+    }
+
+    [self spoolBytes:(buffer + total) length:(NSUInteger)read];
+    _streamOffset += read;
+
+    return total + read;
+}
+
+
+#pragma mark Private helpers
+
+- (void)spoolBytes:(const uint8_t*)bytes length:(NSUInteger)length
+{
+    if (_overflowed || (length == 0)) return;
+
+    if ((_streamOffset + length) > _maxLength) {
+        BBHTTPLogDebug(@"[%@] Body is larger than %llub, it won't be replayable.", self, _maxLength);
+        [self drop];
+        return;
+    }
+
+    NSUInteger inMemory = 0;
+    if ([_memory length] < _memoryLimit) {
+        inMemory = MIN(length, _memoryLimit - [_memory length]);
+        [_memory appendBytes:bytes length:inMemory];
+    }
+
+    if (inMemory == length) return;
+
+    if ((_fd < 0) && ![self createFile]) {
+        [self drop];
+        return;
+    }
+
+    const uint8_t* remaining = bytes + inMemory;
+    NSUInteger left = length - inMemory;
+    while (left > 0) {
+        ssize_t written = write(_fd, remaining, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+
+            BBHTTPLogWarn(@"[%@] Couldn't spool body to disk (%s), it won't be replayable.", self, strerror(errno));
+            [self drop];
+            return;
+        }
+
+        remaining += written;
+        left -= (NSUInteger)written;
+    }
+}
+
+- (BOOL)copySpooledBytesAtOffset:(unsigned long long)offset intoBuffer:(uint8_t*)buffer length:(NSUInteger)length
+{
+    NSUInteger copied = 0;
+    if (offset < [_memory length]) {
+        copied = (NSUInteger)MIN((unsigned long long)length, [_memory length] - offset);
+        [_memory getBytes:buffer range:NSMakeRange((NSUInteger)offset, copied)];
+    }
+
+    while (copied < length) {
+        off_t fileOffset = (off_t)(offset + copied - [_memory length]);
+        ssize_t read = pread(_fd, buffer + copied, length - copied, fileOffset);
+        if (read <= 0) {
+            if ((read < 0) && (errno == EINTR)) continue;
+
+            _error = BBHTTPErrorWithReason(BBHTTPErrorCodeUploadDataStreamError, @"Couldn't replay upload",
+                                           @"Spooled body could not be read back.");
+            return NO;
+        }
+
+        copied += (NSUInteger)read;
+    }
+
+    return YES;
+}
+
+- (BOOL)createFile
+{
+    NSString* template = [NSTemporaryDirectory() stringByAppendingPathComponent:@"BBHTTPUploadSpool.XXXXXX"];
+    char* path = strdup([template fileSystemRepresentation]);
+    _fd = mkstemp(path);
+    // The descriptor keeps the file alive; unlinking right away means it's gone as soon as it's closed (or we crash)
+    if (_fd >= 0) unlink(path);
+    free(path);
+
+    if (_fd < 0) BBHTTPLogWarn(@"[%@] Couldn't create spool file (%s).", self, strerror(errno));
+
+    return _fd >= 0;
+}
+
+- (void)drop
+{
+    _overflowed = YES;
+    _memory = nil;
+
+    if (_fd >= 0) close(_fd);
+    _fd = -1;
+}
+
+@end
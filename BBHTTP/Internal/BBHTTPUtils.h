@@ -33,6 +33,11 @@
 #define BBHTTPErrorCodeDownloadCannotWriteToHandler  1003
 #define BBHTTPErrorCodeUnnacceptableContentType      1004
 #define BBHTTPErrorCodeImageDecodingFailed           1005
+#define BBHTTPErrorCodeContentDecodingFailed         1006
+#define BBHTTPErrorCodeDownloadIntegrityCheckFailed  1007
+#define BBHTTPErrorCodeSegmentedDownloadFailed       1008
+#define BBHTTPErrorCodeResponseTooLarge              1009
+#define BBHTTPErrorCodeChunkedUploadFailed           1010
 
 
 
@@ -113,10 +118,24 @@ BBHTTPDefineHeaderName(ContentType,       @"Content-Type")
 BBHTTPDefineHeaderName(ContentLength,     @"Content-Length")
 BBHTTPDefineHeaderName(Accept,            @"Accept")
 BBHTTPDefineHeaderName(AcceptLanguage,    @"Accept-Language")
+BBHTTPDefineHeaderName(AcceptEncoding,    @"Accept-Encoding")
+BBHTTPDefineHeaderName(ContentEncoding,   @"Content-Encoding")
 BBHTTPDefineHeaderName(Expect,            @"Expect")
 BBHTTPDefineHeaderName(TransferEncoding,  @"Transfer-Encoding")
 BBHTTPDefineHeaderName(Date,              @"Date")
 BBHTTPDefineHeaderName(Authorization,     @"Authorization")
+BBHTTPDefineHeaderName(Range,             @"Range")
+BBHTTPDefineHeaderName(IfRange,           @"If-Range")
+BBHTTPDefineHeaderName(ContentRange,      @"Content-Range")
+BBHTTPDefineHeaderName(ETag,              @"ETag")
+BBHTTPDefineHeaderName(LastModified,      @"Last-Modified")
+BBHTTPDefineHeaderName(Digest,            @"Digest")
+BBHTTPDefineHeaderName(ContentMD5,        @"Content-MD5")
+BBHTTPDefineHeaderName(Location,          @"Location")
+BBHTTPDefineHeaderName(TusResumable,      @"Tus-Resumable")
+BBHTTPDefineHeaderName(UploadLength,      @"Upload-Length")
+BBHTTPDefineHeaderName(UploadOffset,      @"Upload-Offset")
+BBHTTPDefineHeaderName(UploadConcat,      @"Upload-Concat")
 
 
 
@@ -124,6 +143,7 @@ BBHTTPDefineHeaderName(Authorization,     @"Authorization")
 
 BBHTTPDefineHeaderValue(100Continue,   @"100-Continue") // Will create BBHTTPHeaderValue_100Continue
 BBHTTPDefineHeaderValue(Chunked,       @"chunked")
+BBHTTPDefineHeaderValue(Gzip,          @"gzip")
 
 
 
@@ -132,3 +152,6 @@ BBHTTPDefineHeaderValue(Chunked,       @"chunked")
 extern NSString* BBHTTPMimeType(NSString* file);
 extern long long BBHTTPCurrentTimeMillis(void);
 extern NSString* BBHTTPURLEncode(NSString* string, NSStringEncoding encoding);
+extern BOOL BBHTTPParseContentRange(NSString* contentRange, unsigned long long* first, unsigned long long* last,
+                                    unsigned long long* total);
+extern int BBHTTPPreallocateFile(int fd, unsigned long long offset, unsigned long long length);
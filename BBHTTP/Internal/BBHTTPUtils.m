@@ -22,6 +22,7 @@
 #include "BBHTTPUtils.h"
 
 #import <sys/time.h>
+#import <fcntl.h>
 
 #if defined(__IPHONE_OS_VERSION_MIN_REQUIRED)
     #import <MobileCoreServices/MobileCoreServices.h>
@@ -84,3 +85,48 @@ NSString* BBHTTPURLEncode(NSString* string, NSStringEncoding encoding)
                                                     (CFStringRef)@"!*'\"();:@&=+$,/?%#[]% ",
                                                     CFStringConvertNSStringEncodingToEncoding(encoding));
 }
+
+BOOL BBHTTPParseContentRange(NSString* contentRange, unsigned long long* first, unsigned long long* last,
+                             unsigned long long* total)
+{
+    // Format is 'bytes <first>-<last>/<total>', where total may be '*' if unknown
+    if (contentRange == nil) return NO;
+
+    NSScanner* scanner = [NSScanner scannerWithString:contentRange];
+    long long rangeFirst;
+    long long rangeLast;
+    long long rangeTotal = 0;
+
+    if (![scanner scanString:@"bytes" intoString:NULL] ||
+        ![scanner scanLongLong:&rangeFirst] ||
+        ![scanner scanString:@"-" intoString:NULL] ||
+        ![scanner scanLongLong:&rangeLast] ||
+        ![scanner scanString:@"/" intoString:NULL]) return NO;
+
+    if (![scanner scanString:@"*" intoString:NULL] && ![scanner scanLongLong:&rangeTotal]) return NO;
+    if ((rangeFirst < 0) || (rangeLast < rangeFirst) || (rangeTotal < 0)) return NO;
+
+    if (first != NULL) *first = (unsigned long long)rangeFirst;
+    if (last != NULL) *last = (unsigned long long)rangeLast;
+    if (total != NULL) *total = (unsigned long long)rangeTotal;
+
+    return YES;
+}
+
+int BBHTTPPreallocateFile(int fd, unsigned long long offset, unsigned long long length)
+{
+#if defined(F_PREALLOCATE)
+    // Try to get contiguous space first, then settle for any space that fits; F_PEOFPOSMODE allocates from the end
+    // of the file, so callers are expected to pass the current end of file as offset.
+    fstore_t store = {.fst_flags = F_ALLOCATECONTIG, .fst_posmode = F_PEOFPOSMODE,
+                      .fst_offset = 0, .fst_length = (off_t)length};
+    if (fcntl(fd, F_PREALLOCATE, &store) == -1) {
+        store.fst_flags = F_ALLOCATEALL;
+        if (fcntl(fd, F_PREALLOCATE, &store) == -1) return errno;
+    }
+
+    return 0;
+#else
+    return posix_fallocate(fd, (off_t)offset, (off_t)length);
+#endif
+}
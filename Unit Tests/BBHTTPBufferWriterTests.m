@@ -0,0 +1,104 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import <SenTestingKit/SenTestingKit.h>
+#import <malloc/malloc.h>
+
+#import "BBHTTPBufferWriter.h"
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark -
+
+@interface BBHTTPBufferWriterTests : SenTestCase
+@end
+
+@implementation BBHTTPBufferWriterTests
+
+static size_t BBHTTPBlocksInUse()
+{
+    malloc_statistics_t stats;
+    malloc_zone_statistics(NULL, &stats);
+
+    return stats.blocks_in_use;
+}
+
+- (void)testReceiveDoesNotAllocate
+{
+    BBHTTPBufferPool* pool = [[BBHTTPBufferPool alloc] initWithBufferSize:1024 count:1];
+    BBHTTPBufferWriter* writer = [[BBHTTPBufferWriter alloc] initWithBufferPool:pool];
+    NSDictionary* headers = @{@"Content-Length": @"512"};
+    uint8_t body[512];
+    memset(body, 'x', sizeof(body));
+
+    for (NSUInteger i = 0; i < 100; i++) {
+        STAssertTrue([writer prepareForResponse:200 message:@"OK" headers:headers error:nil],
+                     @"writer rejected a response that fits its buffer");
+
+        size_t blocksBefore = BBHTTPBlocksInUse();
+        [writer appendResponseBytes:body withLength:256 error:nil];
+        [writer appendResponseBytes:(body + 256) withLength:256 error:nil];
+        [writer parseContent:nil];
+        size_t blocksAfter = BBHTTPBlocksInUse();
+
+        STAssertEquals(blocksAfter, blocksBefore, @"receive path allocated memory");
+        STAssertEquals(writer.length, (NSUInteger)512, @"writer length doesn't match body length");
+        STAssertTrue(memcmp([writer.buffer bytes], body, 512) == 0, @"buffer contents don't match body");
+    }
+
+    [writer returnBufferToPool];
+    STAssertEquals(pool.availableBuffers, (NSUInteger)1, @"buffer wasn't returned to the pool");
+}
+
+- (void)testOverflowFails
+{
+    BBHTTPBufferWriter* writer = [[BBHTTPBufferWriter alloc] initWithBuffer:[NSMutableData dataWithLength:16]];
+    NSError* error = nil;
+
+    STAssertFalse([writer prepareForResponse:200 message:@"OK" headers:@{@"Content-Length": @"17"} error:&error],
+                  @"writer accepted a response announced to be larger than its buffer");
+    STAssertEquals([error code], (NSInteger)BBHTTPErrorCodeResponseTooLarge, @"unexpected error code");
+
+    uint8_t body[17] = {0};
+    error = nil;
+    STAssertTrue([writer prepareForResponse:200 message:@"OK" headers:@{} error:&error], @"writer rejected response");
+    STAssertTrue([writer appendResponseBytes:body withLength:17 error:&error] < 0, @"writer accepted too much data");
+    STAssertEquals([error code], (NSInteger)BBHTTPErrorCodeResponseTooLarge, @"unexpected error code");
+}
+
+- (void)testOverflowSpills
+{
+    BBHTTPBufferWriter* writer = [[BBHTTPBufferWriter alloc] initWithBuffer:[NSMutableData dataWithLength:16]];
+    writer.spillsOverflow = YES;
+
+    uint8_t body[20];
+    for (NSUInteger i = 0; i < sizeof(body); i++) body[i] = (uint8_t)i;
+
+    STAssertTrue([writer prepareForResponse:200 message:@"OK" headers:@{@"Content-Length": @"20"} error:nil],
+                 @"writer rejected a response it can spill");
+    STAssertEquals([writer appendResponseBytes:body withLength:20 error:nil], (NSInteger)20, @"writer rejected data");
+    STAssertEquals(writer.length, (NSUInteger)16, @"buffer wasn't filled up");
+    STAssertEquals([writer.overflow length], (NSUInteger)4, @"excess wasn't spilled");
+    STAssertTrue(memcmp([writer.overflow bytes], body + 16, 4) == 0, @"spilled contents don't match body");
+}
+
+@end
@@ -0,0 +1,272 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import <SenTestingKit/SenTestingKit.h>
+
+#import "BBHTTPChunkedUpload.h"
+#import "BBHTTPRequest+PrivateInterface.h"
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark - Private interfaces
+
+@interface BBHTTPUploadChunk : NSObject
+
+@property(assign, nonatomic, readonly) unsigned long long start;
+@property(assign, nonatomic, readonly) unsigned long long end;
+@property(copy, nonatomic) NSURL* url;
+@property(assign, nonatomic) unsigned long long confirmed;
+@property(assign, nonatomic) BOOL needsOffsetCheck;
+
+- (instancetype)initWithStart:(unsigned long long)start end:(unsigned long long)end;
+
+@end
+
+@interface BBHTTPChunkedUpload (Testing)
+
+- (NSError*)prepareChunks;
+- (void)saveState;
+- (NSError*)chunk:(BBHTTPUploadChunk*)chunk acceptResponseForRequest:(BBHTTPRequest*)request;
+
+@end
+
+
+
+#pragma mark -
+
+@interface BBHTTPChunkedUploadTests : SenTestCase
+@end
+
+@implementation BBHTTPChunkedUploadTests
+{
+    NSString* _directory;
+    NSString* _pathToFile;
+    NSString* _pathToStateFile;
+    NSURL* _endpoint;
+}
+
+- (void)setUp
+{
+    _directory = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    [[NSFileManager defaultManager] createDirectoryAtPath:_directory withIntermediateDirectories:YES attributes:nil
+                                                    error:nil];
+
+    _pathToFile = [self createFileNamed:@"file"];
+    _pathToStateFile = [_directory stringByAppendingPathComponent:@"state.plist"];
+    _endpoint = [NSURL URLWithString:@"http://biasedbit.com/files/"];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:_directory error:nil];
+}
+
+// 200KB, i.e. three full 64KB chunks and a partial one
+- (NSString*)createFileNamed:(NSString*)name
+{
+    NSString* path = [_directory stringByAppendingPathComponent:name];
+    [[NSMutableData dataWithLength:(200 * 1024)] writeToFile:path atomically:YES];
+
+    return path;
+}
+
+- (BBHTTPChunkedUpload*)uploadForFile:(NSString*)path endpoint:(NSURL*)endpoint
+{
+    BBHTTPChunkedUpload* upload = [[BBHTTPChunkedUpload alloc] initWithFile:path endpoint:endpoint
+                                                                  stateFile:_pathToStateFile];
+    upload.chunkSize = 64 * 1024;
+
+    return upload;
+}
+
+// Prepares an upload with the first chunk done and the second halfway through, then saves its state
+- (void)saveStateOfUploadInProgress
+{
+    BBHTTPChunkedUpload* upload = [self uploadForFile:_pathToFile endpoint:_endpoint];
+    STAssertNil([upload prepareChunks], @"couldn't prepare chunks");
+
+    NSArray* chunks = [upload valueForKey:@"chunks"];
+    [chunks[0] setUrl:[NSURL URLWithString:@"http://biasedbit.com/files/0"]];
+    [chunks[0] setConfirmed:(64 * 1024)];
+    [chunks[1] setUrl:[NSURL URLWithString:@"http://biasedbit.com/files/1"]];
+    [chunks[1] setConfirmed:(32 * 1024)];
+    [upload saveState];
+}
+
+static BBHTTPRequest* BBHTTPFinishedRequest(NSString* verb, NSString* statusLine, NSString* uploadOffset)
+{
+    BBHTTPRequest* request = [[BBHTTPRequest alloc] initWithURL:[NSURL URLWithString:@"http://biasedbit.com/files/0"]
+                                                        andVerb:verb];
+    BBHTTPResponse* response = [BBHTTPResponse responseWithStatusLine:statusLine];
+    if (uploadOffset != nil) [response setValue:uploadOffset forHeader:H(UploadOffset)];
+    [request executionFailedWithFinalResponse:response error:nil];
+
+    return request;
+}
+
+
+#pragma mark Saving and restoring state
+
+- (void)testSavedStateIsRestored
+{
+    [self saveStateOfUploadInProgress];
+
+    BBHTTPChunkedUpload* upload = [self uploadForFile:_pathToFile endpoint:_endpoint];
+    STAssertNil([upload prepareChunks], @"couldn't prepare chunks");
+    STAssertTrue([upload wasResumed], @"upload should have been resumed");
+    STAssertEquals([upload uploadedBytes], (unsigned long long)(96 * 1024), @"wrong number of uploaded bytes");
+
+    NSArray* chunks = [upload valueForKey:@"chunks"];
+    STAssertEquals([chunks count], (NSUInteger)4, @"wrong number of chunks");
+    STAssertEquals([[chunks lastObject] end], (unsigned long long)(200 * 1024), @"last chunk should end with the file");
+
+    BBHTTPUploadChunk* second = chunks[1];
+    STAssertEqualObjects([second.url absoluteString], @"http://biasedbit.com/files/1", @"wrong chunk URL");
+    STAssertEquals(second.confirmed, (unsigned long long)(32 * 1024), @"wrong confirmed bytes");
+    STAssertTrue(second.needsOffsetCheck, @"incomplete chunk should have its offset checked");
+    STAssertFalse([chunks[0] needsOffsetCheck], @"complete chunk shouldn't have its offset checked");
+    STAssertNil([chunks[2] url], @"chunk without an upload shouldn't have a URL");
+
+    NSArray* pending = [upload valueForKey:@"pendingChunks"];
+    STAssertEquals([pending count], (NSUInteger)3, @"complete chunk shouldn't be pending");
+}
+
+- (void)testStateOfAnotherFileIsIgnored
+{
+    [self saveStateOfUploadInProgress];
+
+    BBHTTPChunkedUpload* upload = [self uploadForFile:[self createFileNamed:@"other"] endpoint:_endpoint];
+    STAssertNil([upload prepareChunks], @"couldn't prepare chunks");
+    STAssertFalse([upload wasResumed], @"upload of another file shouldn't be resumed");
+    STAssertEquals([upload uploadedBytes], 0ULL, @"nothing should be uploaded");
+}
+
+- (void)testStateOfAnotherEndpointIsIgnored
+{
+    [self saveStateOfUploadInProgress];
+
+    BBHTTPChunkedUpload* upload = [self uploadForFile:_pathToFile
+                                             endpoint:[NSURL URLWithString:@"http://biasedbit.com/other/"]];
+    STAssertNil([upload prepareChunks], @"couldn't prepare chunks");
+    STAssertFalse([upload wasResumed], @"upload to another endpoint shouldn't be resumed");
+}
+
+- (void)testStateOfModifiedFileIsIgnored
+{
+    [self saveStateOfUploadInProgress];
+
+    NSDate* modificationDate = [NSDate dateWithTimeIntervalSinceNow:-3600];
+    [[NSFileManager defaultManager] setAttributes:@{NSFileModificationDate: modificationDate}
+                                     ofItemAtPath:_pathToFile error:nil];
+
+    BBHTTPChunkedUpload* upload = [self uploadForFile:_pathToFile endpoint:_endpoint];
+    STAssertNil([upload prepareChunks], @"couldn't prepare chunks");
+    STAssertFalse([upload wasResumed], @"upload of a modified file shouldn't be resumed");
+}
+
+- (void)testStateWithGapBetweenChunksIsIgnored
+{
+    [self saveStateOfUploadInProgress];
+
+    NSMutableDictionary* state = [NSMutableDictionary dictionaryWithContentsOfFile:_pathToStateFile];
+    NSMutableArray* chunks = [state[@"chunks"] mutableCopy];
+    [chunks removeObjectAtIndex:2];
+    state[@"chunks"] = chunks;
+    [state writeToFile:_pathToStateFile atomically:YES];
+
+    BBHTTPChunkedUpload* upload = [self uploadForFile:_pathToFile endpoint:_endpoint];
+    STAssertNil([upload prepareChunks], @"couldn't prepare chunks");
+    STAssertFalse([upload wasResumed], @"corrupt state shouldn't be resumed");
+    STAssertEquals([[upload valueForKey:@"chunks"] count], (NSUInteger)4, @"chunks should be laid out from scratch");
+    STAssertEquals([upload uploadedBytes], 0ULL, @"nothing should be uploaded");
+}
+
+
+#pragma mark Accepting responses
+
+- (void)testInvalidUploadOffsetFailsChunk
+{
+    BBHTTPChunkedUpload* upload = [self uploadForFile:_pathToFile endpoint:_endpoint];
+    NSArray* offsets = @[@"-1", [NSString stringWithFormat:@"%d", (64 * 1024) + 1]];
+
+    for (NSString* offset in offsets) {
+        BBHTTPUploadChunk* chunk = [[BBHTTPUploadChunk alloc] initWithStart:0 end:(64 * 1024)];
+        chunk.url = [NSURL URLWithString:@"http://biasedbit.com/files/0"];
+
+        NSError* error = [upload chunk:chunk acceptResponseForRequest:BBHTTPFinishedRequest(@"PATCH",
+                                                                                            @"HTTP/1.1 204 No Content",
+                                                                                            offset)];
+        STAssertEquals([error code], (NSInteger)BBHTTPErrorCodeChunkedUploadFailed, @"accepted offset %@", offset);
+        STAssertEquals(chunk.confirmed, 0ULL, @"offset %@ changed the confirmed bytes", offset);
+    }
+
+    BBHTTPUploadChunk* chunk = [[BBHTTPUploadChunk alloc] initWithStart:0 end:(64 * 1024)];
+    chunk.url = [NSURL URLWithString:@"http://biasedbit.com/files/0"];
+    NSError* error = [upload chunk:chunk acceptResponseForRequest:BBHTTPFinishedRequest(@"PATCH",
+                                                                                        @"HTTP/1.1 204 No Content",
+                                                                                        nil)];
+    STAssertEquals([error code], (NSInteger)BBHTTPErrorCodeChunkedUploadFailed, @"accepted a missing offset");
+}
+
+- (void)testPatchWithoutProgressFailsChunk
+{
+    BBHTTPChunkedUpload* upload = [self uploadForFile:_pathToFile endpoint:_endpoint];
+    BBHTTPUploadChunk* chunk = [[BBHTTPUploadChunk alloc] initWithStart:0 end:(64 * 1024)];
+    chunk.url = [NSURL URLWithString:@"http://biasedbit.com/files/0"];
+    chunk.confirmed = 1024;
+
+    NSError* error = [upload chunk:chunk acceptResponseForRequest:BBHTTPFinishedRequest(@"PATCH",
+                                                                                        @"HTTP/1.1 204 No Content",
+                                                                                        @"1024")];
+    STAssertEquals([error code], (NSInteger)BBHTTPErrorCodeChunkedUploadFailed, @"PATCH without progress accepted");
+
+    // Offset checks, on the other hand, may well find nothing new
+    chunk.needsOffsetCheck = YES;
+    error = [upload chunk:chunk acceptResponseForRequest:BBHTTPFinishedRequest(@"HEAD", @"HTTP/1.1 200 OK", @"1024")];
+    STAssertNil(error, @"offset check rejected");
+    STAssertFalse(chunk.needsOffsetCheck, @"offset should have been checked");
+
+    error = [upload chunk:chunk acceptResponseForRequest:BBHTTPFinishedRequest(@"PATCH", @"HTTP/1.1 204 No Content",
+                                                                               @"4096")];
+    STAssertNil(error, @"PATCH with progress rejected");
+    STAssertEquals(chunk.confirmed, 4096ULL, @"wrong confirmed bytes");
+}
+
+- (void)testGoneUploadResetsChunk
+{
+    BBHTTPChunkedUpload* upload = [self uploadForFile:_pathToFile endpoint:_endpoint];
+
+    for (NSString* statusLine in @[@"HTTP/1.1 404 Not Found", @"HTTP/1.1 410 Gone"]) {
+        BBHTTPUploadChunk* chunk = [[BBHTTPUploadChunk alloc] initWithStart:0 end:(64 * 1024)];
+        chunk.url = [NSURL URLWithString:@"http://biasedbit.com/files/0"];
+        chunk.confirmed = 1024;
+        chunk.needsOffsetCheck = YES;
+
+        NSError* error = [upload chunk:chunk acceptResponseForRequest:BBHTTPFinishedRequest(@"HEAD", statusLine, nil)];
+        STAssertNotNil(error, @"%@ should fail the chunk", statusLine);
+        STAssertNil(chunk.url, @"%@ should reset the chunk's upload", statusLine);
+        STAssertEquals(chunk.confirmed, 0ULL, @"%@ should reset the confirmed bytes", statusLine);
+        STAssertFalse(chunk.needsOffsetCheck, @"%@ leaves no offset to check", statusLine);
+    }
+}
+
+@end
@@ -0,0 +1,148 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import <SenTestingKit/SenTestingKit.h>
+#import <zlib.h>
+
+#import "BBHTTPContentDecoder.h"
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark -
+
+@interface BBHTTPContentDecoderTests : SenTestCase
+@end
+
+@implementation BBHTTPContentDecoderTests
+
+static NSData* BBHTTPTestPayload()
+{
+    // Spans several of the decoder's output chunks
+    NSMutableData* payload = [NSMutableData data];
+    for (NSUInteger i = 0; i < 4000; i++) {
+        [payload appendData:[[NSString stringWithFormat:@"line %lu of the payload\n", (unsigned long)i]
+                             dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+
+    return payload;
+}
+
+// 31 wraps the stream in gzip, 15 in zlib and -15 leaves it raw
+static NSData* BBHTTPTestCompress(NSData* data, int windowBits)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(z_stream));
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) return nil;
+
+    NSMutableData* compressed = [NSMutableData dataWithLength:deflateBound(&stream, [data length])];
+    stream.next_in = (Bytef*)[data bytes];
+    stream.avail_in = (uInt)[data length];
+    stream.next_out = [compressed mutableBytes];
+    stream.avail_out = (uInt)[compressed length];
+    int result = deflate(&stream, Z_FINISH);
+    [compressed setLength:stream.total_out];
+    deflateEnd(&stream);
+
+    return (result == Z_STREAM_END) ? compressed : nil;
+}
+
+static NSData* BBHTTPTestDecode(NSString* encoding, NSData* data, BOOL ownedChunks, NSError** error)
+{
+    BBHTTPContentDecoder* decoder = [[BBHTTPContentDecoder alloc] initWithEncoding:encoding];
+    NSMutableData* decoded = [NSMutableData data];
+
+    for (NSUInteger i = 0; i < [data length]; i++) {
+        uint8_t byte = ((uint8_t*)[data bytes])[i];
+        BOOL decodedChunk = ownedChunks ?
+                            [decoder decodeBytes:&byte withLength:1 toDataBlock:^BOOL(NSData* chunk) {
+                                [decoded appendData:chunk];
+                                return YES;
+                            } error:error] :
+                            [decoder decodeBytes:&byte withLength:1 toBlock:^BOOL(uint8_t* chunk, NSUInteger length) {
+                                [decoded appendBytes:chunk length:length];
+                                return YES;
+                            } error:error];
+        if (!decodedChunk) return nil;
+    }
+
+    return [decoder finish:error] ? decoded : nil;
+}
+
+- (void)testDecodeGzipInSingleByteChunks
+{
+    NSData* payload = BBHTTPTestPayload();
+    NSData* compressed = BBHTTPTestCompress(payload, MAX_WBITS + 16);
+
+    STAssertEqualObjects(BBHTTPTestDecode(@"gzip", compressed, NO, nil), payload, @"gzip content decoded incorrectly");
+    STAssertEqualObjects(BBHTTPTestDecode(@"gzip", compressed, YES, nil), payload,
+                         @"gzip content decoded incorrectly into owned chunks");
+}
+
+- (void)testDecodeZlibWrappedDeflateInSingleByteChunks
+{
+    NSData* payload = BBHTTPTestPayload();
+    NSData* compressed = BBHTTPTestCompress(payload, MAX_WBITS);
+
+    STAssertEqualObjects(BBHTTPTestDecode(@"deflate", compressed, NO, nil), payload,
+                         @"zlib-wrapped deflate content decoded incorrectly");
+    STAssertEqualObjects(BBHTTPTestDecode(@"deflate", compressed, YES, nil), payload,
+                         @"zlib-wrapped deflate content decoded incorrectly into owned chunks");
+}
+
+- (void)testDecodeRawDeflateInSingleByteChunks
+{
+    NSData* payload = BBHTTPTestPayload();
+    NSData* compressed = BBHTTPTestCompress(payload, -MAX_WBITS);
+
+    STAssertEqualObjects(BBHTTPTestDecode(@"deflate", compressed, NO, nil), payload,
+                         @"raw deflate content decoded incorrectly");
+    STAssertEqualObjects(BBHTTPTestDecode(@"deflate", compressed, YES, nil), payload,
+                         @"raw deflate content decoded incorrectly into owned chunks");
+}
+
+- (void)testCorruptContentFailsDecoding
+{
+    NSMutableData* compressed = [BBHTTPTestCompress(BBHTTPTestPayload(), MAX_WBITS + 16) mutableCopy];
+    memset((uint8_t*)[compressed mutableBytes] + 10, 0xff, 32);
+
+    NSError* error = nil;
+    STAssertNil(BBHTTPTestDecode(@"gzip", compressed, NO, &error), @"corrupt content was decoded");
+    STAssertEquals([error code], (NSInteger)BBHTTPErrorCodeContentDecodingFailed, @"wrong error for corrupt content");
+
+    error = nil;
+    STAssertNil(BBHTTPTestDecode(@"gzip", compressed, YES, &error), @"corrupt content was decoded into owned chunks");
+    STAssertEquals([error code], (NSInteger)BBHTTPErrorCodeContentDecodingFailed,
+                   @"wrong error for corrupt content decoded into owned chunks");
+}
+
+- (void)testTruncatedContentFailsDecoding
+{
+    NSData* compressed = BBHTTPTestCompress(BBHTTPTestPayload(), MAX_WBITS);
+    compressed = [compressed subdataWithRange:NSMakeRange(0, [compressed length] / 2)];
+
+    NSError* error = nil;
+    STAssertNil(BBHTTPTestDecode(@"deflate", compressed, NO, &error), @"truncated content was decoded");
+    STAssertEquals([error code], (NSInteger)BBHTTPErrorCodeContentDecodingFailed,
+                   @"wrong error for truncated content");
+}
+
+@end
@@ -0,0 +1,108 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import <SenTestingKit/SenTestingKit.h>
+
+#import "BBHTTPMultipartFormData.h"
+
+
+
+#pragma mark -
+
+@interface BBHTTPMultipartFormDataTests : SenTestCase
+@end
+
+@implementation BBHTTPMultipartFormDataTests
+
+static NSData* BBHTTPReadWholeStream(NSInputStream* stream, NSUInteger chunkSize)
+{
+    NSMutableData* body = [NSMutableData data];
+    uint8_t buffer[chunkSize];
+
+    [stream open];
+    NSInteger read;
+    while ((read = [stream read:buffer maxLength:chunkSize]) > 0) [body appendBytes:buffer length:(NSUInteger)read];
+    [stream close];
+
+    return read < 0 ? nil : body;
+}
+
+- (void)testBodyMatchesEncodingAndContentLength
+{
+    NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"BBHTTPMultipartFormDataTests.txt"];
+    [@"file contents" writeToFile:path atomically:YES encoding:NSUTF8StringEncoding error:nil];
+
+    BBHTTPMultipartFormData* form = [[BBHTTPMultipartFormData alloc] init];
+    [form addValue:@"value" forField:@"fi\"eld"];
+    STAssertTrue([form addFile:path forField:@"file" fileName:@"a.txt" contentType:@"text/plain" error:nil],
+                 @"couldn't add file part");
+
+    NSString* expected = [NSString stringWithFormat:
+                          @"--%1$@\r\nContent-Disposition: form-data; name=\"fi%%22eld\"\r\n\r\nvalue\r\n"
+                          "--%1$@\r\nContent-Disposition: form-data; name=\"file\"; filename=\"a.txt\"\r\n"
+                          "Content-Type: text/plain\r\n\r\nfile contents\r\n--%1$@--\r\n", form.boundary];
+
+    // Small chunks force reads to cross segment boundaries
+    NSData* body = BBHTTPReadWholeStream([form bodyStream], 7);
+    STAssertEqualObjects([[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding], expected,
+                         @"unexpected body");
+    STAssertEquals(form.contentLength, (unsigned long long)[body length], @"content length doesn't match body");
+
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+}
+
+- (void)testUnreadableFileLeavesFormUntouched
+{
+    BBHTTPMultipartFormData* form = [[BBHTTPMultipartFormData alloc] init];
+    [form addValue:@"value" forField:@"field"];
+    NSData* before = BBHTTPReadWholeStream([form bodyStream], 4096);
+
+    NSError* error = nil;
+    NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"BBHTTPMultipartFormDataTests.missing"];
+    STAssertFalse([form addFile:path forField:@"file" error:&error], @"added a file that doesn't exist");
+    STAssertNotNil(error, @"no error for a file that doesn't exist");
+
+    STAssertEqualObjects(BBHTTPReadWholeStream([form bodyStream], 4096), before, @"failed part left data in the body");
+    STAssertEquals(form.contentLength, (unsigned long long)[before length], @"failed part changed the content length");
+}
+
+- (void)testStreamPartOfUnknownSize
+{
+    BBHTTPMultipartFormData* form = [[BBHTTPMultipartFormData alloc] init];
+    NSData* content = [@"streamed" dataUsingEncoding:NSUTF8StringEncoding];
+    [form addStream:[NSInputStream inputStreamWithData:content] ofSize:0 forField:@"s" fileName:nil contentType:nil];
+
+    STAssertEquals(form.contentLength, 0ULL, @"content length should be unknown");
+    STAssertNotNil(BBHTTPReadWholeStream([form bodyStream], 4096), @"body stream failed");
+}
+
+- (void)testStreamPartShorterThanDeclaredFails
+{
+    BBHTTPMultipartFormData* form = [[BBHTTPMultipartFormData alloc] init];
+    NSData* content = [@"short" dataUsingEncoding:NSUTF8StringEncoding];
+    [form addStream:[NSInputStream inputStreamWithData:content] ofSize:10 forField:@"s" fileName:nil contentType:nil];
+
+    NSInputStream* stream = [form bodyStream];
+    STAssertNil(BBHTTPReadWholeStream(stream, 4096), @"body stream should fail");
+    STAssertNotNil([stream streamError], @"body stream should report an error");
+}
+
+@end
@@ -0,0 +1,81 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import <SenTestingKit/SenTestingKit.h>
+
+#import "BBHTTPRequestContext.h"
+#import "BBHTTPUploadBody.h"
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark -
+
+@interface BBHTTPRequestContextTests : SenTestCase
+@end
+
+@implementation BBHTTPRequestContextTests
+
+- (void)testDiscardedBodyOfUnknownSizeIsCutOffAtMaxResponseBodySize
+{
+    // Without a content handler, the body is discarded
+    BBHTTPRequest* request = [[BBHTTPRequest alloc] initWithURL:[NSURL URLWithString:@"http://biasedbit.com"]
+                                                        andVerb:@"GET"];
+    BBHTTPRequestContext* context = [[BBHTTPRequestContext alloc] initWithRequest:request andCurlHandle:NULL];
+    context.maxResponseBodySize = 250;
+
+    STAssertTrue([context beginResponseWithLine:@"HTTP/1.1 200 OK"], @"status line rejected");
+    STAssertTrue([context addHeaderToCurrentResponse:@"Transfer-Encoding: chunked"], @"header rejected");
+    STAssertTrue([context prepareToReceiveData], @"response rejected before its body was received");
+
+    uint8_t chunk[100];
+    memset(chunk, 'x', sizeof(chunk));
+    STAssertTrue([context appendDataToCurrentResponse:chunk withLength:sizeof(chunk)], @"first chunk rejected");
+    STAssertTrue([context appendDataToCurrentResponse:chunk withLength:sizeof(chunk)], @"second chunk rejected");
+    STAssertFalse([context appendDataToCurrentResponse:chunk withLength:sizeof(chunk)],
+                  @"body was not cut off once it crossed the limit");
+    STAssertEquals([context.error code], (NSInteger)BBHTTPErrorCodeResponseTooLarge, @"wrong error");
+}
+
+- (void)testUploadBodyWithoutStreamsCanBeRewound
+{
+    BBHTTPUploadBody* body = [[BBHTTPUploadBody alloc] init];
+    [body addData:[@"upload " dataUsingEncoding:NSUTF8StringEncoding]];
+    [body addData:[@"body" dataUsingEncoding:NSUTF8StringEncoding]];
+
+    BBHTTPRequest* request = [[BBHTTPRequest alloc] initWithURL:[NSURL URLWithString:@"http://biasedbit.com"]
+                                                        andVerb:@"PATCH"];
+    STAssertTrue([request setUploadBody:body withContentType:@"application/octet-stream"], @"body rejected");
+    BBHTTPRequestContext* context = [[BBHTTPRequestContext alloc] initWithRequest:request andCurlHandle:NULL];
+
+    uint8_t buffer[64];
+    NSInteger read = [context transferInputToBuffer:buffer limit:sizeof(buffer)];
+    STAssertEquals(read, (NSInteger)11, @"wrong number of bytes read");
+
+    STAssertTrue([context rewindUpload], @"upload body couldn't be rewound");
+    memset(buffer, 0, sizeof(buffer));
+    read = [context transferInputToBuffer:buffer limit:sizeof(buffer)];
+    STAssertEquals(read, (NSInteger)11, @"wrong number of bytes read after rewinding");
+    STAssertEqualObjects([[NSString alloc] initWithBytes:buffer length:11 encoding:NSUTF8StringEncoding],
+                         @"upload body", @"wrong body after rewinding");
+}
+
+@end
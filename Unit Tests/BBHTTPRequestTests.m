@@ -22,6 +22,8 @@
 #import <SenTestingKit/SenTestingKit.h>
 
 #import "BBHTTPRequest.h"
+#import "BBHTTPMultipartFormData.h"
+#import "BBHTTPUploadBody.h"
 
 
 
@@ -55,4 +57,60 @@
                  @"request upload data doesn't match expected value");
 }
 
+- (void)testCompressedUpload
+{
+    BBHTTPRequest* post = [[BBHTTPRequest alloc] initWithTarget:@"http://biasedbit.com" andVerb:@"POST"];
+    NSData* data = [@"foo=bar" dataUsingEncoding:NSASCIIStringEncoding];
+    STAssertTrue([post setUploadData:data withContentType:@"application/x-www-form-urlencoded"],
+                 @"setUploadData:withContentType: returned NO");
+
+    STAssertFalse([post isUploadCompressed],
+                  @"upload should not be compressed by default");
+    STAssertTrue([post isUploadSizeKnown],
+                 @"upload size should be known for in-memory uploads");
+
+    post.compressUpload = YES;
+    STAssertTrue([post isUploadCompressed],
+                 @"upload should be compressed");
+    STAssertFalse([post isUploadSizeKnown],
+                  @"upload size should be unknown for compressed uploads");
+
+    BBHTTPRequest* legacyPost = [[BBHTTPRequest alloc] initWithURL:[NSURL URLWithString:@"http://biasedbit.com"]
+                                                              verb:@"POST"
+                                                andProtocolVersion:BBHTTPProtocolVersion_1_0];
+    [legacyPost setUploadData:data withContentType:@"application/x-www-form-urlencoded"];
+    legacyPost.compressUpload = YES;
+    STAssertFalse([legacyPost isUploadCompressed],
+                  @"HTTP/1.0 uploads cannot be compressed");
+}
+
+- (void)testUploadBodyIsKeptForReplay
+{
+    BBHTTPMultipartFormData* form = [[BBHTTPMultipartFormData alloc] init];
+    [form addValue:@"value" forField:@"field"];
+
+    BBHTTPRequest* post = [[BBHTTPRequest alloc] initWithTarget:@"http://biasedbit.com" andVerb:@"POST"];
+    STAssertTrue([post setUploadMultipartFormData:form],
+                 @"setUploadMultipartFormData: returned NO");
+    STAssertNotNil(post.uploadBody,
+                   @"upload body should be kept");
+    STAssertTrue([post.uploadBody isReplayable],
+                 @"form without stream parts should be replayable");
+    STAssertEquals((unsigned long long)post.uploadSize, form.contentLength,
+                   @"upload size doesn't match the form");
+
+    BBHTTPRequest* redirected = [[BBHTTPRequest alloc] initWithTarget:@"http://biasedbit.com" andVerb:@"POST"];
+    STAssertTrue([redirected setUploadReplayedFromRequest:post],
+                 @"upload body could not be replayed");
+    STAssertNotNil(redirected.uploadBody,
+                   @"replayed upload body should be kept");
+    STAssertEqualObjects(redirected[@"Content-Type"], form.contentType,
+                         @"Content-Type header wasn't carried over");
+
+    STAssertTrue([post setUploadData:[@"foo" dataUsingEncoding:NSASCIIStringEncoding] withContentType:@"text/plain"],
+                 @"setUploadData:withContentType: returned NO");
+    STAssertNil(post.uploadBody,
+                @"upload body should be cleared by other upload setters");
+}
+
 @end
@@ -0,0 +1,237 @@
+//
+// Copyright 2013 BiasedBit
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+//
+//  Created by Bruno de Carvalho - @biasedbit / http://biasedbit.com
+//  Copyright (c) 2013 BiasedBit. All rights reserved.
+//
+
+#import <SenTestingKit/SenTestingKit.h>
+#import <unistd.h>
+
+#import "BBHTTPSegmentedDownload.h"
+#import "BBHTTPExecutor.h"
+#import "BBHTTPRequest.h"
+#import "BBHTTPUtils.h"
+
+
+
+#pragma mark - Private interfaces
+
+@interface BBHTTPDownloadSegment : NSObject
+
+@property(assign, nonatomic, readonly) unsigned long long start;
+@property(assign, nonatomic) unsigned long long end;
+@property(assign, nonatomic) unsigned long long claimed;
+@property(assign, nonatomic) unsigned long long written;
+@property(strong, nonatomic) BBHTTPRequest* request;
+
+- (unsigned long long)unclaimedBytes;
+
+@end
+
+@interface BBHTTPSegmentedDownload (Testing)
+
+- (int)segment:(BBHTTPDownloadSegment*)segment acceptResponse:(NSUInteger)statusCode message:(NSString*)message
+       headers:(NSDictionary*)headers error:(NSError**)error;
+- (BBHTTPDownloadSegment*)stealFromLargestSegment;
+
+@end
+
+
+
+#pragma mark - Executor stub
+
+// Takes every request without ever executing it
+@interface BBHTTPSegmentedDownloadTestExecutor : NSObject
+
+@property(strong, nonatomic, readonly) NSMutableArray* requests;
+
+- (BOOL)executeRequest:(BBHTTPRequest*)request;
+
+@end
+
+@implementation BBHTTPSegmentedDownloadTestExecutor
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self != nil) _requests = [NSMutableArray array];
+
+    return self;
+}
+
+- (BOOL)executeRequest:(BBHTTPRequest*)request
+{
+    [_requests addObject:request];
+    return YES;
+}
+
+@end
+
+
+
+#pragma mark -
+
+@interface BBHTTPSegmentedDownloadTests : SenTestCase
+@end
+
+@implementation BBHTTPSegmentedDownloadTests
+{
+    NSString* _pathToFile;
+    BBHTTPSegmentedDownloadTestExecutor* _executor;
+}
+
+- (void)setUp
+{
+    _pathToFile = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    _executor = [[BBHTTPSegmentedDownloadTestExecutor alloc] init];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtPath:_pathToFile error:nil];
+}
+
+- (BBHTTPSegmentedDownload*)downloadWithMinSegmentSize:(unsigned long long)minSegmentSize
+                                           maxSegments:(NSUInteger)maxSegments
+{
+    BBHTTPSegmentedDownload* download = [[BBHTTPSegmentedDownload alloc]
+                                         initWithURL:[NSURL URLWithString:@"http://biasedbit.com/file"]
+                                         targetFile:_pathToFile];
+    download.executor = (BBHTTPExecutor*)_executor;
+    download.minSegmentSize = minSegmentSize;
+    download.maxSegments = maxSegments;
+
+    return download;
+}
+
+// Starts the download and has its probe accept a 206 for a resource of *size* bytes
+- (BBHTTPDownloadSegment*)startDownload:(BBHTTPSegmentedDownload*)download withSize:(unsigned long long)size
+{
+    STAssertTrue([download start], @"download did not start");
+    BBHTTPDownloadSegment* probe = [download valueForKey:@"activeSegments"][0];
+
+    NSDictionary* headers = @{H(ContentRange): [NSString stringWithFormat:@"bytes 0-%llu/%llu", size - 1, size],
+                              H(ETag): @"\"v1\""};
+    NSError* error = nil;
+    int fd = [download segment:probe acceptResponse:206 message:@"Partial Content" headers:headers error:&error];
+    STAssertTrue(fd >= 0, @"probe response was rejected: %@", error);
+    if (fd >= 0) close(fd);
+
+    return probe;
+}
+
+- (void)testProbeIsSplitIntoSegmentsCoveringTheWholeFile
+{
+    BBHTTPSegmentedDownload* download = [self downloadWithMinSegmentSize:100 maxSegments:4];
+    BBHTTPDownloadSegment* probe = [self startDownload:download withSize:1003];
+
+    STAssertTrue([download isSegmented], @"download should be segmented");
+    STAssertEquals([download fileSize], 1003ULL, @"wrong file size");
+    STAssertEquals(probe.end, 250ULL, @"probe should keep the first segment only");
+
+    NSArray* expectedRanges = @[@"bytes=0-", @"bytes=250-499", @"bytes=500-749", @"bytes=750-1002"];
+    STAssertEquals([_executor.requests count], [expectedRanges count], @"wrong number of segment requests");
+    for (NSUInteger i = 0; i < MIN([_executor.requests count], [expectedRanges count]); i++) {
+        BBHTTPRequest* request = _executor.requests[i];
+        STAssertEqualObjects(request.headers[H(Range)], expectedRanges[i], @"wrong range for segment %lu",
+                             (unsigned long)i);
+    }
+}
+
+- (void)testSegmentsAreNeverSmallerThanMinSegmentSize
+{
+    BBHTTPSegmentedDownload* download = [self downloadWithMinSegmentSize:400 maxSegments:4];
+    [self startDownload:download withSize:1003];
+
+    // 1003 bytes only fit two segments of at least 400 bytes
+    STAssertEquals([_executor.requests count], (NSUInteger)2, @"wrong number of segment requests");
+    STAssertEqualObjects([_executor.requests[1] headers][H(Range)], @"bytes=501-1002", @"wrong range for last segment");
+}
+
+- (void)testStealingNeverLeavesLessThanMinSegmentSize
+{
+    BBHTTPSegmentedDownload* download = [self downloadWithMinSegmentSize:100 maxSegments:2];
+    BBHTTPDownloadSegment* probe = [self startDownload:download withSize:1000];
+    probe.claimed = 130; // 370 bytes left to receive
+
+    NSUInteger steals = 0;
+    BBHTTPDownloadSegment* stolen = nil;
+    while ((stolen = [download stealFromLargestSegment]) != nil) {
+        steals++;
+        STAssertTrue([stolen unclaimedBytes] >= 100, @"stole a segment smaller than the minimum: %@", stolen);
+        for (BBHTTPDownloadSegment* segment in [download valueForKey:@"activeSegments"]) {
+            STAssertTrue([segment unclaimedBytes] >= 100, @"left a segment smaller than the minimum: %@", segment);
+        }
+    }
+
+    // 370 -> 185 (probe), 500 -> 250 -> 125 (second segment); nothing left with twice the minimum
+    STAssertEquals(steals, (NSUInteger)3, @"wrong number of steals");
+    for (BBHTTPDownloadSegment* segment in [download valueForKey:@"activeSegments"]) {
+        STAssertTrue([segment unclaimedBytes] < 200, @"segment could still have been split: %@", segment);
+    }
+}
+
+- (void)testMismatchedContentRangeFailsDownload
+{
+    NSArray* contentRanges = @[@"bytes 400-999/1000", @"bytes 500-999/2000", @"bytes */1000"];
+    for (NSString* contentRange in contentRanges) {
+        BBHTTPSegmentedDownload* download = [self downloadWithMinSegmentSize:100 maxSegments:2];
+        [self startDownload:download withSize:1000];
+        BBHTTPDownloadSegment* segment = [download valueForKey:@"activeSegments"][1];
+        STAssertEquals(segment.start, 500ULL, @"unexpected segment");
+
+        NSError* error = nil;
+        int fd = [download segment:segment acceptResponse:206 message:@"Partial Content"
+                           headers:@{H(ContentRange): contentRange} error:&error];
+        STAssertEquals(fd, -1, @"accepted Content-Range %@", contentRange);
+        STAssertTrue([download hasFinished], @"download did not fail for Content-Range %@", contentRange);
+        STAssertEquals([[download error] code], (NSInteger)BBHTTPErrorCodeDownloadIntegrityCheckFailed,
+                       @"wrong error for Content-Range %@", contentRange);
+    }
+}
+
+- (void)testMatchingContentRangeIsAccepted
+{
+    BBHTTPSegmentedDownload* download = [self downloadWithMinSegmentSize:100 maxSegments:2];
+    [self startDownload:download withSize:1000];
+    BBHTTPDownloadSegment* segment = [download valueForKey:@"activeSegments"][1];
+
+    int fd = [download segment:segment acceptResponse:206 message:@"Partial Content"
+                       headers:@{H(ContentRange): @"bytes 500-999/1000"} error:nil];
+    STAssertTrue(fd >= 0, @"rejected matching Content-Range");
+    if (fd >= 0) close(fd);
+    STAssertFalse([download hasFinished], @"download should still be running");
+}
+
+- (void)testFullResponseDuringSegmentFailsDownload
+{
+    BBHTTPSegmentedDownload* download = [self downloadWithMinSegmentSize:100 maxSegments:2];
+    [self startDownload:download withSize:1000];
+    BBHTTPDownloadSegment* segment = [download valueForKey:@"activeSegments"][1];
+
+    NSError* error = nil;
+    int fd = [download segment:segment acceptResponse:200 message:@"OK" headers:@{H(ContentLength): @"1000"}
+                         error:&error];
+    STAssertEquals(fd, -1, @"accepted a full response for a segment");
+    STAssertTrue([download hasFinished], @"download did not fail");
+    STAssertEquals([[download error] code], (NSInteger)BBHTTPErrorCodeDownloadIntegrityCheckFailed,
+                   @"wrong error for a full response");
+    STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:_pathToFile], @"partial file was not deleted");
+}
+
+@end